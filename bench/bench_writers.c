@@ -0,0 +1,111 @@
+/*
+    Microbenchmark: specialized vs. runtime-flag OBJ emit loops.
+    Writes the same synthetic model through both variants for all four
+    -flipUVs/-swapYZ combinations and reports the time per vertex.
+    Build: cc -O2 -o bench_writers bench/bench_writers.c -lm -pthread
+    Usage: bench_writers [verts_per_surface] [iterations]
+*/
+
+#define MD3TOOBJ_NO_MAIN
+#include "../main.c"
+
+#define BENCH_SURFACES 4
+
+/* Runtime-flag versions: the same loops with the flags left as variables */
+#if defined(__GNUC__)
+#define BENCH_NOINLINE __attribute__((noinline))
+#else
+#define BENCH_NOINLINE
+#endif
+
+BENCH_NOINLINE int generic_frame(FILE *out, md3SurfaceData *surfaces, int numSurfaces, int flipUVs, int swapYZ) {
+    return write_obj_positions_impl(out, surfaces, numSurfaces, 0, "bench", swapYZ) &&
+           write_obj_texcoords_impl(out, surfaces, numSurfaces, "bench", flipUVs) &&
+           write_obj_normals_impl(out, surfaces, numSurfaces, 0, "bench", swapYZ) &&
+           write_obj_faces_impl(out, surfaces, numSurfaces, 0, "bench", swapYZ);
+}
+
+BENCH_NOINLINE int specialized_frame(FILE *out, md3SurfaceData *surfaces, int numSurfaces, const objEmitters_t *emit) {
+    return emit->positions(out, surfaces, numSurfaces, 0, "bench") &&
+           emit->texcoords(out, surfaces, numSurfaces, "bench") &&
+           emit->normals(out, surfaces, numSurfaces, 0, "bench") &&
+           emit->faces(out, surfaces, numSurfaces, 0, "bench");
+}
+
+double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char *argv[]) {
+    int numVerts = argc > 1 ? atoi(argv[1]) : 2000;
+    int iterations = argc > 2 ? atoi(argv[2]) : 20;
+    if (numVerts < 3 || iterations < 1) {
+        fprintf(stderr, "Usage: %s [verts_per_surface] [iterations]\n", argv[0]);
+        return 1;
+    }
+    md3SurfaceData surfaces[BENCH_SURFACES];
+    int baseIndex = 1;
+    srand(1);
+    for (int s = 0; s < BENCH_SURFACES; s++) {
+        md3SurfaceData *surf = &surfaces[s];
+        memset(surf, 0, sizeof(*surf));
+        snprintf(surf->header.name, sizeof(surf->header.name), "surface%d", s);
+        surf->header.numFrames = 1;
+        surf->header.numVerts = numVerts;
+        surf->header.numTriangles = numVerts * 2;
+        surf->vertices = (md3Vertex_t*) malloc(numVerts * sizeof(md3Vertex_t));
+        surf->texCoords = (md3TexCoord_t*) malloc(numVerts * sizeof(md3TexCoord_t));
+        surf->triangles = (md3Triangle_t*) malloc(surf->header.numTriangles * sizeof(md3Triangle_t));
+        if (!surf->vertices || !surf->texCoords || !surf->triangles) {
+            fprintf(stderr, "Memory allocation failed.\n");
+            return 1;
+        }
+        for (int v = 0; v < numVerts; v++) {
+            for (int k = 0; k < 3; k++) surf->vertices[v].xyz[k] = (short)(rand() % 8192 - 4096);
+            surf->vertices[v].normal = (short)rand();
+            surf->texCoords[v].st[0] = rand() / (float)RAND_MAX;
+            surf->texCoords[v].st[1] = rand() / (float)RAND_MAX;
+        }
+        for (int t = 0; t < surf->header.numTriangles; t++) {
+            for (int k = 0; k < 3; k++) surf->triangles[t].indexes[k] = rand() % numVerts;
+        }
+        surf->baseIndex = baseIndex;
+        baseIndex += numVerts;
+    }
+    FILE *sink = fopen("/dev/null", "w");
+    if (!sink) {
+        perror("Error opening /dev/null");
+        return 1;
+    }
+    double totalVerts = (double)numVerts * BENCH_SURFACES * iterations;
+    printf("%-8s %-8s %14s %14s %8s\n", "flipUVs", "swapYZ", "generic ns/v", "special ns/v", "speedup");
+    for (int flip = 0; flip < 2; flip++) {
+        for (int swap = 0; swap < 2; swap++) {
+            const objEmitters_t *emit = select_obj_emitters(flip, swap);
+            /* Warm up both paths once before timing */
+            generic_frame(sink, surfaces, BENCH_SURFACES, flip, swap);
+            specialized_frame(sink, surfaces, BENCH_SURFACES, emit);
+            double t0 = now_seconds();
+            for (int i = 0; i < iterations; i++) {
+                generic_frame(sink, surfaces, BENCH_SURFACES, flip, swap);
+            }
+            double t1 = now_seconds();
+            for (int i = 0; i < iterations; i++) {
+                specialized_frame(sink, surfaces, BENCH_SURFACES, emit);
+            }
+            double t2 = now_seconds();
+            double generic = (t1 - t0) * 1e9 / totalVerts;
+            double special = (t2 - t1) * 1e9 / totalVerts;
+            printf("%-8d %-8d %14.1f %14.1f %7.2fx\n", flip, swap, generic, special, generic / special);
+        }
+    }
+    fclose(sink);
+    for (int s = 0; s < BENCH_SURFACES; s++) {
+        free(surfaces[s].vertices);
+        free(surfaces[s].texCoords);
+        free(surfaces[s].triangles);
+    }
+    return 0;
+}
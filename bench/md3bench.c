@@ -0,0 +1,182 @@
+/*
+    MD3 conversion benchmark.
+    Generates a synthetic MD3 with the requested shape, then times each phase
+    of a conversion separately and reports throughput:
+      load   - load_md3_file(): header, tags and all surfaces      (MB/s of input)
+      decode - decode_positions()/decode_normals() for every frame (verts/s)
+      write  - write_obj_frame_to_stream() for every frame         (MB/s of OBJ text)
+    Build: cc -O2 -o md3bench bench/md3bench.c -lm -pthread
+    Usage: md3bench [-surfaces N] [-verts N] [-tris N] [-frames N] [-tags N]
+                    [-iterations N] [-seed N] [-keep file.md3]
+           md3bench -generate file.md3 [shape options]
+    -generate and -keep write MD2, MDC or MDR instead when the file name
+    ends in .md2, .mdc or .mdr, so their loaders can be timed too.
+*/
+
+#define MD3TOOBJ_NO_MAIN
+#include "../main.c"
+#include "md3synth.h"
+
+#include <unistd.h>
+
+typedef struct {
+    double load;
+    double decode;
+    double write;
+    long outputBytes;
+} benchTimes;
+
+double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Runs one load/decode/write pass over the model at path */
+int bench_once(const char *path, FILE *sink, benchTimes *out) {
+    md3FileData data;
+    memset(&data, 0, sizeof(data));
+    double t0 = bench_now();
+    if (!load_md3_file(path, &data)) {
+        free_md3_file(&data);
+        return 0;
+    }
+    double t1 = bench_now();
+
+    int maxVerts = 1;
+    int baseIndex = 1;
+    for (int s = 0; s < data.numSurfaces; s++) {
+        data.surfaces[s].baseIndex = baseIndex;
+        baseIndex += data.surfaces[s].header.numVerts;
+        if (data.surfaces[s].header.numVerts > maxVerts) maxVerts = data.surfaces[s].header.numVerts;
+    }
+    float *buf = (float*) malloc((size_t)maxVerts * 6 * sizeof(float));
+    if (!buf) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        free_md3_file(&data);
+        return 0;
+    }
+    for (int frame = 0; frame < data.header.numFrames; frame++) {
+        for (int s = 0; s < data.numSurfaces; s++) {
+            int numVerts = data.surfaces[s].header.numVerts;
+            const md3Vertex_t *verts = data.surfaces[s].vertices + (size_t)frame * numVerts;
+            decode_positions(verts, numVerts, g_swapYZ, buf, buf + maxVerts, buf + 2 * maxVerts);
+            decode_normals(verts, numVerts, buf + 3 * maxVerts, buf + 4 * maxVerts, buf + 5 * maxVerts);
+        }
+    }
+    free(buf);
+    double t2 = bench_now();
+
+    rewind(sink);
+    for (int frame = 0; frame < data.header.numFrames; frame++) {
+        if (!write_obj_frame_to_stream(sink, &data.header, data.surfaces, data.numSurfaces, frame, "benchmark output")) {
+            free_md3_file(&data);
+            return 0;
+        }
+    }
+    fflush(sink);
+    double t3 = bench_now();
+    out->outputBytes = ftell(sink);
+
+    out->load = t1 - t0;
+    out->decode = t2 - t1;
+    out->write = t3 - t2;
+    free_md3_file(&data);
+    return 1;
+}
+
+int main(int argc, char *argv[]) {
+    md3SynthParams params;
+    synth_default_params(&params);
+    int iterations = 5;
+    const char *keepPath = NULL;
+    const char *generatePath = NULL;
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) {
+            fprintf(stderr, "Missing value for %s\n", argv[i]);
+            return 1;
+        }
+        if (strcmp(argv[i], "-surfaces") == 0) {
+            params.numSurfaces = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-verts") == 0) {
+            params.numVerts = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-tris") == 0) {
+            params.numTriangles = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-frames") == 0) {
+            params.numFrames = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-tags") == 0) {
+            params.numTags = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-seed") == 0) {
+            params.seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-iterations") == 0) {
+            iterations = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-keep") == 0) {
+            keepPath = argv[++i];
+        } else if (strcmp(argv[i], "-generate") == 0) {
+            generatePath = argv[++i];
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (generatePath) {
+        long size = write_synthetic_model(generatePath, &params);
+        if (size < 0) return 1;
+        printf("Wrote %s (%ld bytes)\n", generatePath, size);
+        return 0;
+    }
+    if (iterations < 1) {
+        fprintf(stderr, "Iterations must be at least 1.\n");
+        return 1;
+    }
+
+    char tmpPath[] = "/tmp/md3benchXXXXXX";
+    const char *modelPath = keepPath;
+    if (!modelPath) {
+        int fd = mkstemp(tmpPath);
+        if (fd < 0) {
+            perror("mkstemp failed");
+            return 1;
+        }
+        close(fd);
+        modelPath = tmpPath;
+    }
+    long fileSize = write_synthetic_model(modelPath, &params);
+    if (fileSize < 0) return 1;
+
+    FILE *sink = tmpfile();
+    if (!sink) {
+        perror("tmpfile failed");
+        return 1;
+    }
+    /* One untimed pass to warm the page cache and allocator */
+    benchTimes best, run;
+    if (!bench_once(modelPath, sink, &best)) {
+        fclose(sink);
+        return 1;
+    }
+    best.load = best.decode = best.write = 1e30;
+    for (int i = 0; i < iterations; i++) {
+        if (!bench_once(modelPath, sink, &run)) {
+            fclose(sink);
+            return 1;
+        }
+        if (run.load < best.load) best.load = run.load;
+        if (run.decode < best.decode) best.decode = run.decode;
+        if (run.write < best.write) best.write = run.write;
+        best.outputBytes = run.outputBytes;
+    }
+    fclose(sink);
+    if (!keepPath) remove(modelPath);
+
+    double totalVerts = (double)params.numSurfaces * params.numVerts * params.numFrames;
+    double mb = 1024.0 * 1024.0;
+    printf("model: %d surfaces, %d verts, %d tris, %d frames, %d tags (%ld bytes)\n",
+           params.numSurfaces, params.numVerts, params.numTriangles, params.numFrames, params.numTags, fileSize);
+    printf("best of %d iterations\n", iterations);
+    printf("%-8s %10s %12s %14s\n", "phase", "ms", "MB/s", "verts/s");
+    printf("%-8s %10.2f %12.1f %14.0f\n", "load", best.load * 1e3, fileSize / mb / best.load, totalVerts / best.load);
+    printf("%-8s %10.2f %12s %14.0f\n", "decode", best.decode * 1e3, "-", totalVerts / best.decode);
+    printf("%-8s %10.2f %12.1f %14.0f\n", "write", best.write * 1e3, best.outputBytes / mb / best.write, totalVerts / best.write);
+    return 0;
+}
@@ -0,0 +1,637 @@
+/*
+    Synthetic MD3 generator used by the benchmark, tests and fuzz corpus,
+    with MD2, MDC and MDR variants of the same models for their loaders.
+    Each surface is an animated height-field grid, so the output has real
+    topology, smooth normals, per-frame bounds and moving tags. Generation is
+    deterministic (no libc rand), so the same parameters always produce the
+    same file for a given math library.
+    Include after main.c (it uses the md3 structures defined there).
+*/
+
+#ifndef MD3SYNTH_H
+#define MD3SYNTH_H
+
+typedef struct {
+    int numSurfaces;
+    int numVerts;      /* per surface */
+    int numTriangles;  /* per surface */
+    int numFrames;
+    int numTags;
+    unsigned int seed;
+} md3SynthParams;
+
+/* Default parameters: a mid-sized player model */
+static void synth_default_params(md3SynthParams *p) {
+    p->numSurfaces = 4;
+    p->numVerts = 1000;
+    p->numTriangles = 1800;
+    p->numFrames = 100;
+    p->numTags = 3;
+    p->seed = 1;
+}
+
+/* Grid columns used for a surface with numVerts vertices */
+static int synth_grid_cols(int numVerts) {
+    int cols = (int)sqrt((double)numVerts);
+    return cols < 2 ? 2 : cols;
+}
+
+/* Per-surface variation derived from the seed (xorshift, platform independent) */
+static float synth_surface_phase(const md3SynthParams *p, int s) {
+    unsigned int x = p->seed * 2654435761u + (unsigned int)s * 40503u + 1u;
+    x ^= x << 13; x ^= x >> 17; x ^= x << 5;
+    return (x % 6283u) / 1000.0f;
+}
+
+/* Position, normal and texcoord of vertex v of surface s in a given frame */
+static void synth_vertex(const md3SynthParams *p, int s, int v, int frame, md3Vertex_t *out, md3TexCoord_t *st) {
+    int cols = synth_grid_cols(p->numVerts);
+    int rows = (p->numVerts + cols - 1) / cols;
+    int c = v % cols, r = v / cols;
+    float spacing = 48.0f / cols;
+    float k = 0.15f, amp = 3.0f + s;
+    float phase = synth_surface_phase(p, s) + frame * 0.1f;
+    float x = (c - cols * 0.5f) * spacing + s * 4.0f;
+    float y = (r - rows * 0.5f) * spacing;
+    float z = amp * sinf(k * x + phase) * cosf(k * y) + s * 8.0f;
+    float coords[3] = { x, y, z };
+    for (int i = 0; i < 3; i++) {
+        float q = coords[i] / MD3_XYZ_SCALE;
+        out->xyz[i] = (short)(q < 0 ? q - 0.5f : q + 0.5f);
+    }
+    /* Analytic normal of the height field, encoded like decodeNormal() expects */
+    float dzdx = amp * k * cosf(k * x + phase) * cosf(k * y);
+    float dzdy = -amp * k * sinf(k * x + phase) * sinf(k * y);
+    float nx = -dzdx, ny = -dzdy, nz = 1.0f;
+    float len = sqrtf(nx * nx + ny * ny + nz * nz);
+    nx /= len; ny /= len; nz /= len;
+    int lat = (int)floorf(atan2f(ny, nx) * 128.0f / (float)M_PI + 0.5f) & 0xFF;
+    int lng = (int)floorf(acosf(nz) * 128.0f / (float)M_PI + 0.5f);
+    out->normal = (short)((lat << 8) | (lng & 0xFF));
+    if (st) {
+        st->st[0] = (float)c / (cols - 1);
+        st->st[1] = rows > 1 ? (float)r / (rows - 1) : 0.0f;
+    }
+}
+
+/* Triangle t of a surface: grid cells in row order, wrapping if more triangles
+   are requested than the grid provides */
+static void synth_triangle(const md3SynthParams *p, int t, md3Triangle_t *tri) {
+    int cols = synth_grid_cols(p->numVerts);
+    int rows = p->numVerts / cols;  /* complete rows only */
+    int cells = (cols - 1) * (rows - 1);
+    if (cells < 1) {
+        tri->indexes[0] = 0; tri->indexes[1] = 1 % p->numVerts; tri->indexes[2] = 2 % p->numVerts;
+        return;
+    }
+    int cell = (t / 2) % cells;
+    int c = cell % (cols - 1), r = cell / (cols - 1);
+    int i00 = r * cols + c, i01 = i00 + 1, i10 = i00 + cols, i11 = i10 + 1;
+    if (t % 2 == 0) {
+        tri->indexes[0] = i00; tri->indexes[1] = i10; tri->indexes[2] = i01;
+    } else {
+        tri->indexes[0] = i01; tri->indexes[1] = i10; tri->indexes[2] = i11;
+    }
+}
+
+/* Bounds and radius of every surface's vertices in a given frame */
+static void synth_frame(const md3SynthParams *p, int f, md3Frame_t *frame) {
+    memset(frame, 0, sizeof(*frame));
+    for (int i = 0; i < 3; i++) { frame->mins[i] = 1e30f; frame->maxs[i] = -1e30f; }
+    float radius2 = 0.0f;
+    for (int s = 0; s < p->numSurfaces; s++) {
+        for (int v = 0; v < p->numVerts; v++) {
+            md3Vertex_t vert;
+            synth_vertex(p, s, v, f, &vert, NULL);
+            float d2 = 0.0f;
+            for (int i = 0; i < 3; i++) {
+                float c = vert.xyz[i] * MD3_XYZ_SCALE;
+                if (c < frame->mins[i]) frame->mins[i] = c;
+                if (c > frame->maxs[i]) frame->maxs[i] = c;
+                d2 += c * c;
+            }
+            if (d2 > radius2) radius2 = d2;
+        }
+    }
+    frame->radius = sqrtf(radius2);
+    snprintf(frame->name, sizeof(frame->name), "frame%d", f);
+}
+
+/* Tag t in a given frame: spins around Z by the returned yaw (radians) */
+static float synth_tag(int t, int frame, md3Tag_t *tag) {
+    memset(tag, 0, sizeof(*tag));
+    snprintf(tag->name, sizeof(tag->name), "tag_synth%d", t);
+    float angle = frame * 0.05f + t;
+    tag->origin[0] = 8.0f * t;
+    tag->origin[1] = -4.0f * t;
+    tag->origin[2] = 16.0f + sinf(frame * 0.2f + t);
+    tag->axis[0][0] = cosf(angle); tag->axis[0][1] = sinf(angle);
+    tag->axis[1][0] = -sinf(angle); tag->axis[1][1] = cosf(angle);
+    tag->axis[2][2] = 1.0f;
+    return angle;
+}
+
+/* Writes a synthetic MD3 file; returns the file size or -1 on error */
+static long write_synthetic_md3(const char *path, const md3SynthParams *p) {
+    if (p->numSurfaces < 1 || p->numVerts < 3 || p->numTriangles < 1 || p->numFrames < 1 || p->numTags < 0) {
+        fprintf(stderr, "Invalid synthetic model parameters.\n");
+        return -1;
+    }
+    FILE *fp = fopen(path, "wb");
+    if (!fp) {
+        fprintf(stderr, "Error opening output file %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    const int shaderSize = 68;  /* char name[64]; int shaderIndex; */
+    md3Surface_t surf;
+    memset(&surf, 0, sizeof(surf));
+    memcpy(surf.id, "IDP3", 4);
+    surf.numFrames = p->numFrames;
+    surf.numShaders = 1;
+    surf.numVerts = p->numVerts;
+    surf.numTriangles = p->numTriangles;
+    surf.ofsTriangles = sizeof(md3Surface_t);
+    surf.ofsShaders = surf.ofsTriangles + p->numTriangles * (int)sizeof(md3Triangle_t);
+    surf.ofsST = surf.ofsShaders + shaderSize;
+    surf.ofsVerts = surf.ofsST + p->numVerts * (int)sizeof(md3TexCoord_t);
+    surf.ofsEnd = surf.ofsVerts + p->numVerts * p->numFrames * (int)sizeof(md3Vertex_t);
+
+    md3Header_t header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.id, "IDP3", 4);
+    header.version = MD3_VERSION;
+    snprintf(header.name, sizeof(header.name), "models/synthetic/s%dv%df%d.md3", p->numSurfaces, p->numVerts, p->numFrames);
+    header.numFrames = p->numFrames;
+    header.numTags = p->numTags;
+    header.numSurfaces = p->numSurfaces;
+    header.ofsFrames = sizeof(md3Header_t);
+    header.ofsTags = header.ofsFrames + p->numFrames * (int)sizeof(md3Frame_t);
+    header.ofsSurfaces = header.ofsTags + p->numFrames * p->numTags * (int)sizeof(md3Tag_t);
+    header.ofsEnd = header.ofsSurfaces + p->numSurfaces * surf.ofsEnd;
+    int ok = fwrite(&header, sizeof(header), 1, fp) == 1;
+
+    /* Frame bounds, computed from the same vertex function */
+    for (int f = 0; f < p->numFrames && ok; f++) {
+        md3Frame_t frame;
+        synth_frame(p, f, &frame);
+        ok = fwrite(&frame, sizeof(frame), 1, fp) == 1;
+    }
+    /* Tags: spin around Z and bob along it */
+    for (int f = 0; f < p->numFrames && ok; f++) {
+        for (int t = 0; t < p->numTags && ok; t++) {
+            md3Tag_t tag;
+            synth_tag(t, f, &tag);
+            ok = fwrite(&tag, sizeof(tag), 1, fp) == 1;
+        }
+    }
+    for (int s = 0; s < p->numSurfaces && ok; s++) {
+        snprintf(surf.name, sizeof(surf.name), "surface%d", s);
+        ok = fwrite(&surf, sizeof(surf), 1, fp) == 1;
+        for (int t = 0; t < p->numTriangles && ok; t++) {
+            md3Triangle_t tri;
+            synth_triangle(p, t, &tri);
+            ok = fwrite(&tri, sizeof(tri), 1, fp) == 1;
+        }
+        char shader[68];
+        memset(shader, 0, sizeof(shader));
+        snprintf(shader, 64, "models/synthetic/surface%d.tga", s);
+        ok = ok && fwrite(shader, sizeof(shader), 1, fp) == 1;
+        for (int v = 0; v < p->numVerts && ok; v++) {
+            md3Vertex_t vert;
+            md3TexCoord_t st;
+            synth_vertex(p, s, v, 0, &vert, &st);
+            ok = fwrite(&st, sizeof(st), 1, fp) == 1;
+        }
+        for (int f = 0; f < p->numFrames && ok; f++) {
+            for (int v = 0; v < p->numVerts && ok; v++) {
+                md3Vertex_t vert;
+                synth_vertex(p, s, v, f, &vert, NULL);
+                ok = fwrite(&vert, sizeof(vert), 1, fp) == 1;
+            }
+        }
+    }
+    if (fclose(fp) != 0) ok = 0;
+    if (!ok) {
+        fprintf(stderr, "Error writing synthetic model %s\n", path);
+        return -1;
+    }
+    return header.ofsEnd;
+}
+
+/* Rounds to the nearest integer, halves away from zero */
+static int synth_round(float x) {
+    return (int)(x < 0 ? x - 0.5f : x + 0.5f);
+}
+
+static int synth_check_params(const md3SynthParams *p) {
+    if (p->numSurfaces < 1 || p->numVerts < 3 || p->numTriangles < 1 || p->numFrames < 1 || p->numTags < 0) {
+        fprintf(stderr, "Invalid synthetic model parameters.\n");
+        return 0;
+    }
+    return 1;
+}
+
+/* Writes a synthetic MD2 (Quake II): surface 0 only and no tags. Positions
+   are stored as bytes scaled to each frame's bounds; normal indices pick
+   the closest g_md2Normals entry to the analytic normal. */
+static long write_synthetic_md2(const char *path, const md3SynthParams *p) {
+    if (!synth_check_params(p)) return -1;
+    if (p->numVerts > 32767) {
+        fprintf(stderr, "MD2 models are limited to 32767 vertices.\n");
+        return -1;
+    }
+    md2Header_t h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.id, "IDP2", 4);
+    h.version = MD2_VERSION;
+    h.skinWidth = h.skinHeight = 256;
+    h.frameSize = (int)sizeof(md2Frame_t) + p->numVerts * (int)sizeof(md2Vertex_t);
+    h.numSkins = 1;
+    h.numXyz = h.numSt = p->numVerts;
+    h.numTris = p->numTriangles;
+    h.numFrames = p->numFrames;
+    h.ofsSkins = sizeof(h);
+    h.ofsSt = h.ofsSkins + 64;
+    h.ofsTris = h.ofsSt + h.numSt * (int)sizeof(md2TexCoord_t);
+    h.ofsFrames = h.ofsTris + h.numTris * (int)sizeof(md2Triangle_t);
+    h.ofsGlCmds = h.ofsEnd = h.ofsFrames + h.numFrames * h.frameSize;
+    FILE *fp = fopen(path, "wb");
+    if (!fp) {
+        fprintf(stderr, "Error opening output file %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    char skin[64];
+    memset(skin, 0, sizeof(skin));
+    snprintf(skin, sizeof(skin), "models/synthetic/skin.pcx");
+    int ok = fwrite(&h, sizeof(h), 1, fp) == 1 && fwrite(skin, sizeof(skin), 1, fp) == 1;
+    for (int v = 0; v < p->numVerts && ok; v++) {
+        md3Vertex_t vert;
+        md3TexCoord_t st;
+        synth_vertex(p, 0, v, 0, &vert, &st);
+        md2TexCoord_t out = { (short)synth_round(st.st[0] * h.skinWidth), (short)synth_round(st.st[1] * h.skinHeight) };
+        ok = fwrite(&out, sizeof(out), 1, fp) == 1;
+    }
+    for (int t = 0; t < p->numTriangles && ok; t++) {
+        md3Triangle_t tri;
+        md2Triangle_t out;
+        synth_triangle(p, t, &tri);
+        for (int k = 0; k < 3; k++) out.indexXyz[k] = out.indexSt[k] = (short)tri.indexes[k];
+        ok = fwrite(&out, sizeof(out), 1, fp) == 1;
+    }
+    float *pos = (float*)malloc((size_t)p->numVerts * 3 * sizeof(float));
+    md2Vertex_t *verts = (md2Vertex_t*)malloc((size_t)p->numVerts * sizeof(md2Vertex_t));
+    if (!pos || !verts) ok = 0;
+    for (int f = 0; f < p->numFrames && ok; f++) {
+        md2Frame_t frame;
+        memset(&frame, 0, sizeof(frame));
+        float mins[3], maxs[3];
+        for (int v = 0; v < p->numVerts; v++) {
+            md3Vertex_t vert;
+            synth_vertex(p, 0, v, f, &vert, NULL);
+            float n[3], best = -2.0f;
+            decodeNormal(vert.normal, &n[0], &n[1], &n[2]);
+            for (int i = 0; i < MD2_NUM_NORMALS; i++) {
+                float d = n[0] * g_md2Normals[i][0] + n[1] * g_md2Normals[i][1] + n[2] * g_md2Normals[i][2];
+                if (d > best) {
+                    best = d;
+                    verts[v].normalIndex = (unsigned char) i;
+                }
+            }
+            for (int k = 0; k < 3; k++) {
+                pos[v * 3 + k] = vert.xyz[k] * MD3_XYZ_SCALE;
+                if (v == 0 || pos[v * 3 + k] < mins[k]) mins[k] = pos[v * 3 + k];
+                if (v == 0 || pos[v * 3 + k] > maxs[k]) maxs[k] = pos[v * 3 + k];
+            }
+        }
+        for (int k = 0; k < 3; k++) {
+            frame.scale[k] = maxs[k] > mins[k] ? (maxs[k] - mins[k]) / 255.0f : 1.0f;
+            frame.translate[k] = mins[k];
+        }
+        snprintf(frame.name, sizeof(frame.name), "frame%d", f);
+        for (int v = 0; v < p->numVerts; v++) {
+            for (int k = 0; k < 3; k++) {
+                int b = synth_round((pos[v * 3 + k] - frame.translate[k]) / frame.scale[k]);
+                verts[v].v[k] = (unsigned char)(b < 0 ? 0 : (b > 255 ? 255 : b));
+            }
+        }
+        ok = fwrite(&frame, sizeof(frame), 1, fp) == 1 &&
+             fwrite(verts, sizeof(md2Vertex_t), p->numVerts, fp) == (size_t)p->numVerts;
+    }
+    free(pos);
+    free(verts);
+    if (fclose(fp) != 0) ok = 0;
+    if (!ok) {
+        fprintf(stderr, "Error writing synthetic model %s\n", path);
+        return -1;
+    }
+    return h.ofsEnd;
+}
+
+/* Writes a synthetic MDC (RtCW). Every fourth frame is a base frame; the
+   others store 8-bit offsets from the latest base frame, or become base
+   frames themselves when an offset is out of range. Compressed normal
+   indices are 0 since the loader recomputes those frames' normals. */
+static long write_synthetic_mdc(const char *path, const md3SynthParams *p) {
+    if (!synth_check_params(p)) return -1;
+    int numFrames = p->numFrames, numVerts = p->numVerts;
+    /* Per surface: base/compressed index of each frame and the counts */
+    short *baseOf = (short*)malloc((size_t)p->numSurfaces * numFrames * sizeof(short));
+    short *compOf = (short*)malloc((size_t)p->numSurfaces * numFrames * sizeof(short));
+    int *numBase = (int*)calloc(p->numSurfaces, sizeof(int));
+    int *numComp = (int*)calloc(p->numSurfaces, sizeof(int));
+    md3Vertex_t *a = (md3Vertex_t*)malloc((size_t)numVerts * sizeof(md3Vertex_t));
+    if (!baseOf || !compOf || !numBase || !numComp || !a || numFrames > 32767) {
+        fprintf(stderr, "Cannot plan synthetic MDC frames.\n");
+        free(baseOf); free(compOf); free(numBase); free(numComp); free(a);
+        return -1;
+    }
+    for (int s = 0; s < p->numSurfaces; s++) {
+        int lastBase = 0;
+        for (int f = 0; f < numFrames; f++) {
+            int fits = f % 4 != 0;
+            for (int v = 0; v < numVerts && fits; v++) {
+                md3Vertex_t vb, vf;
+                synth_vertex(p, s, v, lastBase, &vb, NULL);
+                synth_vertex(p, s, v, f, &vf, NULL);
+                for (int k = 0; k < 3; k++) {
+                    int o = synth_round((vf.xyz[k] - vb.xyz[k]) * MD3_XYZ_SCALE / MDC_DIST_SCALE);
+                    if (o < -127 || o > 128) fits = 0;
+                }
+            }
+            if (fits) {
+                baseOf[s * numFrames + f] = (short)(numBase[s] - 1);
+                compOf[s * numFrames + f] = (short)numComp[s]++;
+            } else {
+                lastBase = f;
+                baseOf[s * numFrames + f] = (short)numBase[s]++;
+                compOf[s * numFrames + f] = -1;
+            }
+        }
+    }
+    const int shaderSize = sizeof(md3Shader_t);
+    mdcHeader_t h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.id, "IDPC", 4);
+    h.version = MDC_VERSION;
+    snprintf(h.name, sizeof(h.name), "models/synthetic/s%dv%df%d.mdc", p->numSurfaces, numVerts, numFrames);
+    h.numFrames = numFrames;
+    h.numTags = p->numTags;
+    h.numSurfaces = p->numSurfaces;
+    h.ofsFrames = sizeof(h);
+    h.ofsTagNames = h.ofsFrames + numFrames * (int)sizeof(md3Frame_t);
+    h.ofsTags = h.ofsTagNames + p->numTags * 64;
+    h.ofsSurfaces = h.ofsTags + numFrames * p->numTags * (int)sizeof(mdcTag_t);
+    mdcSurface_t *surfs = (mdcSurface_t*)calloc(p->numSurfaces, sizeof(mdcSurface_t));
+    int ok = surfs != NULL;
+    long end = h.ofsSurfaces;
+    for (int s = 0; s < p->numSurfaces && ok; s++) {
+        mdcSurface_t *sh = &surfs[s];
+        memcpy(sh->id, "IDPC", 4);
+        snprintf(sh->name, sizeof(sh->name), "surface%d", s);
+        sh->numCompFrames = numComp[s];
+        sh->numBaseFrames = numBase[s];
+        sh->numShaders = 1;
+        sh->numVerts = numVerts;
+        sh->numTriangles = p->numTriangles;
+        sh->ofsTriangles = sizeof(mdcSurface_t);
+        sh->ofsShaders = sh->ofsTriangles + p->numTriangles * (int)sizeof(md3Triangle_t);
+        sh->ofsSt = sh->ofsShaders + shaderSize;
+        sh->ofsXyzNormals = sh->ofsSt + numVerts * (int)sizeof(md3TexCoord_t);
+        sh->ofsXyzCompressed = sh->ofsXyzNormals + numBase[s] * numVerts * (int)sizeof(md3Vertex_t);
+        sh->ofsFrameBaseFrames = sh->ofsXyzCompressed + numComp[s] * numVerts * 4;
+        sh->ofsFrameCompFrames = sh->ofsFrameBaseFrames + numFrames * (int)sizeof(short);
+        sh->ofsEnd = (sh->ofsFrameCompFrames + numFrames * (int)sizeof(short) + 3) & ~3;
+        end += sh->ofsEnd;
+    }
+    h.ofsEnd = (int)end;
+    FILE *fp = ok ? fopen(path, "wb") : NULL;
+    if (!fp) {
+        fprintf(stderr, "Error opening output file %s: %s\n", path, strerror(errno));
+        ok = 0;
+    }
+    ok = ok && fwrite(&h, sizeof(h), 1, fp) == 1;
+    for (int f = 0; f < numFrames && ok; f++) {
+        md3Frame_t frame;
+        synth_frame(p, f, &frame);
+        ok = fwrite(&frame, sizeof(frame), 1, fp) == 1;
+    }
+    for (int t = 0; t < p->numTags && ok; t++) {
+        md3Tag_t tag;
+        synth_tag(t, 0, &tag);
+        ok = fwrite(tag.name, 64, 1, fp) == 1;
+    }
+    for (int f = 0; f < numFrames && ok; f++) {
+        for (int t = 0; t < p->numTags && ok; t++) {
+            md3Tag_t tag;
+            float yaw = synth_tag(t, f, &tag) * 180.0f / (float)M_PI;
+            yaw -= 360.0f * floorf((yaw + 180.0f) / 360.0f);
+            mdcTag_t out;
+            memset(&out, 0, sizeof(out));
+            for (int k = 0; k < 3; k++) out.xyz[k] = (short)synth_round(tag.origin[k] / MD3_XYZ_SCALE);
+            out.angles[1] = (short)synth_round(yaw / MDC_TAG_ANGLE_SCALE);
+            ok = fwrite(&out, sizeof(out), 1, fp) == 1;
+        }
+    }
+    for (int s = 0; s < p->numSurfaces && ok; s++) {
+        const mdcSurface_t *sh = &surfs[s];
+        ok = fwrite(sh, sizeof(*sh), 1, fp) == 1;
+        for (int t = 0; t < p->numTriangles && ok; t++) {
+            md3Triangle_t tri;
+            synth_triangle(p, t, &tri);
+            ok = fwrite(&tri, sizeof(tri), 1, fp) == 1;
+        }
+        md3Shader_t shader;
+        memset(&shader, 0, sizeof(shader));
+        snprintf(shader.name, sizeof(shader.name), "models/synthetic/surface%d.tga", s);
+        ok = ok && fwrite(&shader, sizeof(shader), 1, fp) == 1;
+        for (int v = 0; v < numVerts && ok; v++) {
+            md3Vertex_t vert;
+            md3TexCoord_t st;
+            synth_vertex(p, s, v, 0, &vert, &st);
+            ok = fwrite(&st, sizeof(st), 1, fp) == 1;
+        }
+        /* Base frames, then compressed frames, in frame order */
+        for (int pass = 0; pass < 2 && ok; pass++) {
+            int base = 0;
+            for (int f = 0; f < numFrames && ok; f++) {
+                int isBase = compOf[s * numFrames + f] < 0;
+                if (isBase) base = f;
+                if (isBase != (pass == 0)) continue;
+                for (int v = 0; v < numVerts; v++) synth_vertex(p, s, v, f, &a[v], NULL);
+                if (pass == 0) {
+                    ok = fwrite(a, sizeof(md3Vertex_t), numVerts, fp) == (size_t)numVerts;
+                    continue;
+                }
+                for (int v = 0; v < numVerts && ok; v++) {
+                    md3Vertex_t vb;
+                    synth_vertex(p, s, v, base, &vb, NULL);
+                    unsigned int packed = 0;
+                    for (int k = 0; k < 3; k++) {
+                        int o = synth_round((a[v].xyz[k] - vb.xyz[k]) * MD3_XYZ_SCALE / MDC_DIST_SCALE) + 127;
+                        packed |= (unsigned int)o << (8 * k);
+                    }
+                    ok = fwrite(&packed, sizeof(packed), 1, fp) == 1;
+                }
+            }
+        }
+        ok = ok && fwrite(&baseOf[s * numFrames], sizeof(short), numFrames, fp) == (size_t)numFrames &&
+             fwrite(&compOf[s * numFrames], sizeof(short), numFrames, fp) == (size_t)numFrames;
+        int pad = sh->ofsEnd - (sh->ofsFrameCompFrames + numFrames * (int)sizeof(short));
+        for (int i = 0; i < pad && ok; i++) ok = fputc(0, fp) != EOF;
+    }
+    if (fp && fclose(fp) != 0) ok = 0;
+    free(baseOf); free(compOf); free(numBase); free(numComp); free(a); free(surfs);
+    if (!ok) {
+        fprintf(stderr, "Error writing synthetic model %s\n", path);
+        return -1;
+    }
+    return h.ofsEnd;
+}
+
+/* Bone 1 of the synthetic MDR in a given frame: turns around Z and bobs */
+static void synth_mdr_bone(int bone, int frame, mdrBone_t *out) {
+    float angle = bone ? frame * 0.05f : 0.0f;
+    memset(out, 0, sizeof(*out));
+    out->matrix[0][0] = cosf(angle); out->matrix[0][1] = -sinf(angle);
+    out->matrix[1][0] = sinf(angle); out->matrix[1][1] = cosf(angle);
+    out->matrix[2][2] = 1.0f;
+    out->matrix[2][3] = bone ? sinf(frame * 0.2f) : 0.0f;
+}
+
+/* Writes a synthetic MDR (skeletal, uncompressed frames, one LOD). Bone 0
+   stays put and bone 1 turns around Z; each vertex blends the two by its
+   grid column. Weight offsets and normals are frame 0's, so frame 0 skins
+   to the MD3 generator's frame 0. Tag t follows bone t % 2. */
+static long write_synthetic_mdr(const char *path, const md3SynthParams *p) {
+    if (!synth_check_params(p)) return -1;
+    const int numBones = 2, numWeights = 2;
+    int numFrames = p->numFrames, numVerts = p->numVerts;
+    int cols = synth_grid_cols(numVerts);
+    int vertSize = (int)sizeof(mdrVertex_t) + numWeights * (int)sizeof(mdrWeight_t);
+    int frameSize = (int)sizeof(mdrFrame_t) + numBones * (int)sizeof(mdrBone_t);
+    mdrHeader_t h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.id, "RDM5", 4);
+    h.version = MDR_VERSION;
+    snprintf(h.name, sizeof(h.name), "models/synthetic/s%dv%df%d.mdr", p->numSurfaces, numVerts, numFrames);
+    h.numFrames = numFrames;
+    h.numBones = numBones;
+    h.ofsFrames = sizeof(h);
+    h.numLODs = 1;
+    h.ofsLODs = h.ofsFrames + numFrames * frameSize;
+    mdrSurface_t sh;
+    memset(&sh, 0, sizeof(sh));
+    memcpy(sh.id, "RDM5", 4);
+    sh.numVerts = numVerts;
+    sh.numTriangles = p->numTriangles;
+    sh.numBoneReferences = numBones;
+    sh.ofsBoneReferences = sizeof(sh);
+    sh.ofsTriangles = sh.ofsBoneReferences + numBones * (int)sizeof(int);
+    sh.ofsVerts = sh.ofsTriangles + p->numTriangles * (int)sizeof(md3Triangle_t);
+    sh.ofsEnd = sh.ofsVerts + numVerts * vertSize;
+    mdrLOD_t lod;
+    lod.numSurfaces = p->numSurfaces;
+    lod.ofsSurfaces = sizeof(lod);
+    lod.ofsEnd = lod.ofsSurfaces + p->numSurfaces * sh.ofsEnd;
+    h.numTags = p->numTags;
+    h.ofsTags = h.ofsLODs + lod.ofsEnd;
+    h.ofsEnd = h.ofsTags + p->numTags * (int)sizeof(mdrTag_t);
+
+    FILE *fp = fopen(path, "wb");
+    if (!fp) {
+        fprintf(stderr, "Error opening output file %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    int ok = fwrite(&h, sizeof(h), 1, fp) == 1;
+    for (int f = 0; f < numFrames && ok; f++) {
+        mdrFrame_t frame;
+        mdrBone_t bones[2];
+        memset(&frame, 0, sizeof(frame));
+        synth_mdr_bone(0, f, &bones[0]);
+        synth_mdr_bone(1, f, &bones[1]);
+        /* Bounds of the skinned vertices */
+        float radius2 = 0.0f;
+        for (int s = 0; s < p->numSurfaces; s++) {
+            for (int v = 0; v < numVerts; v++) {
+                md3Vertex_t vert;
+                synth_vertex(p, s, v, 0, &vert, NULL);
+                float w1 = (float)(v % cols) / (cols - 1), pos[3] = { 0.0f, 0.0f, 0.0f };
+                for (int b = 0; b < numBones; b++) {
+                    float w = b ? w1 : 1.0f - w1;
+                    for (int k = 0; k < 3; k++) {
+                        pos[k] += w * (bones[b].matrix[k][0] * vert.xyz[0] * MD3_XYZ_SCALE + bones[b].matrix[k][1] * vert.xyz[1] * MD3_XYZ_SCALE +
+                                       bones[b].matrix[k][2] * vert.xyz[2] * MD3_XYZ_SCALE + bones[b].matrix[k][3]);
+                    }
+                }
+                float d2 = 0.0f;
+                for (int k = 0; k < 3; k++) {
+                    if ((s == 0 && v == 0) || pos[k] < frame.mins[k]) frame.mins[k] = pos[k];
+                    if ((s == 0 && v == 0) || pos[k] > frame.maxs[k]) frame.maxs[k] = pos[k];
+                    d2 += pos[k] * pos[k];
+                }
+                if (d2 > radius2) radius2 = d2;
+            }
+        }
+        frame.radius = sqrtf(radius2);
+        snprintf(frame.name, sizeof(frame.name), "frame%d", f);
+        ok = fwrite(&frame, sizeof(frame), 1, fp) == 1 && fwrite(bones, sizeof(mdrBone_t), numBones, fp) == (size_t)numBones;
+    }
+    ok = ok && fwrite(&lod, sizeof(lod), 1, fp) == 1;
+    long surfaceStart = h.ofsLODs + lod.ofsSurfaces;
+    for (int s = 0; s < p->numSurfaces && ok; s++, surfaceStart += sh.ofsEnd) {
+        snprintf(sh.name, sizeof(sh.name), "surface%d", s);
+        snprintf(sh.shader, sizeof(sh.shader), "models/synthetic/surface%d.tga", s);
+        sh.ofsHeader = (int)-surfaceStart;
+        int boneRefs[2] = { 0, 1 };
+        ok = fwrite(&sh, sizeof(sh), 1, fp) == 1 && fwrite(boneRefs, sizeof(int), numBones, fp) == (size_t)numBones;
+        for (int t = 0; t < p->numTriangles && ok; t++) {
+            md3Triangle_t tri;
+            synth_triangle(p, t, &tri);
+            ok = fwrite(&tri, sizeof(tri), 1, fp) == 1;
+        }
+        for (int v = 0; v < numVerts && ok; v++) {
+            md3Vertex_t vert;
+            md3TexCoord_t st;
+            synth_vertex(p, s, v, 0, &vert, &st);
+            mdrVertex_t out;
+            decodeNormal(vert.normal, &out.normal[0], &out.normal[1], &out.normal[2]);
+            out.texCoords[0] = st.st[0];
+            out.texCoords[1] = st.st[1];
+            out.numWeights = numWeights;
+            ok = fwrite(&out, sizeof(out), 1, fp) == 1;
+            float w1 = (float)(v % cols) / (cols - 1);
+            for (int b = 0; b < numWeights && ok; b++) {
+                mdrWeight_t weight;
+                weight.boneIndex = b;
+                weight.boneWeight = b ? w1 : 1.0f - w1;
+                for (int k = 0; k < 3; k++) weight.offset[k] = vert.xyz[k] * MD3_XYZ_SCALE;
+                ok = fwrite(&weight, sizeof(weight), 1, fp) == 1;
+            }
+        }
+    }
+    for (int t = 0; t < p->numTags && ok; t++) {
+        mdrTag_t tag;
+        memset(&tag, 0, sizeof(tag));
+        tag.boneIndex = t % numBones;
+        snprintf(tag.name, sizeof(tag.name), "tag_synth%d", t);
+        ok = fwrite(&tag, sizeof(tag), 1, fp) == 1;
+    }
+    if (fclose(fp) != 0) ok = 0;
+    if (!ok) {
+        fprintf(stderr, "Error writing synthetic model %s\n", path);
+        return -1;
+    }
+    return h.ofsEnd;
+}
+
+/* Writes a synthetic model in the format named by the path's extension
+   (.md2, .mdc or .mdr; anything else is MD3) */
+static long write_synthetic_model(const char *path, const md3SynthParams *p) {
+    const char *dot = strrchr(path, '.');
+    if (dot && strcmp(dot, ".md2") == 0) return write_synthetic_md2(path, p);
+    if (dot && strcmp(dot, ".mdc") == 0) return write_synthetic_mdc(path, p);
+    if (dot && strcmp(dot, ".mdr") == 0) return write_synthetic_mdr(path, p);
+    return write_synthetic_md3(path, p);
+}
+
+#endif /* MD3SYNTH_H */
@@ -8,6 +8,31 @@
       -flipUVs or -noFlipUVs
       -swapYZ or -noSwapYZ
       -merge (merge multiple MD3 files into one OBJ)
+      -toMD3 output.md3 input.obj [input2.obj ...] (encode OBJ frames, or one -allFrames OBJ, as MD3)
+      -tagsFrom model.md3 (copy tags into the -toMD3 output)
+      -tar archive.tar (write every frame into a single tar archive)
+      -allFrames (write every frame into one OBJ as separate objects)
+      -stats report.json (write per-phase timing and size statistics as JSON, "-" for stdout, moving progress to stderr)
+      -lod N (also write N simplified levels of detail as name_lodN)
+      -lodRatio r (triangle ratio kept per LOD level, default 0.5)
+      -optimizeCache (reorder triangles and vertices for GPU vertex cache efficiency and less overdraw)
+      -meshlets file.bin (write meshlets with per-frame bounds and normal cones to a sidecar)
+      -bounds file.json (write header and recomputed per-frame bounds, flagging wrong ones)
+      -tags file.json|file.csv (write every tag's origin and axis for every frame)
+      -mtl (write name.mtl with a material per surface texture and usemtl in the faces)
+      -skin file.skin (take surface textures from a .skin, implies -mtl; default name_default.skin)
+      -threads N (worker threads for parallel passes, default one per CPU)
+      -verify (read each written OBJ frame back and check it against the model)
+      -rewrite output.md3 (write a packed, welded MD3 instead of OBJ frames)
+      -stripSurfaces a,b / -stripTags a,b (surfaces and tags to leave out of -rewrite)
+      -frames first-last (keep only this frame range)
+      -anim file.md3a (write delta-compressed vertex animation, see md3anim.h)
+      -animStep n (position quantization step for -anim in 1/64 units, default 1 = lossless)
+      -iqm file.iqm (write an IQM with all frames as vertex animation and tags as joints)
+      -keyframes tol (drop frames that interpolation reproduces within tol units; writes name_keyframes.json)
+      -fps n (source frame rate for keyframe timing and -resample, default 20)
+      -resample fps (interpolate the animation to a new frame rate)
+      -resampleFrames N (interpolate the animation to N frames)
       
 Created by: Christopher M. with the help of AI, and Github | Creatisoft https://www.creatisoft.com
 */
@@ -17,7 +42,22 @@ Created by: Christopher M. with the help of AI, and Github | Creatisoft https://
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <ctype.h>
 #include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "md3anim.h"
+
+/* SSE2/AVX2 kernels are compiled with per-function target attributes and
+   selected at runtime, so no special compiler flags are needed. */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define MD3_SIMD_X86 1
+#include <immintrin.h>
+#endif
 
 /* MD3 file definitions (packed to match file layout) */
 #pragma pack(push, 1)
@@ -59,6 +99,11 @@ typedef struct {
     int ofsEnd;
 } md3Surface_t;
 
+typedef struct {
+    char name[64];
+    int shaderIndex;
+} md3Shader_t;
+
 typedef struct {
     int indexes[3];
 } md3Triangle_t;
@@ -89,6 +134,8 @@ typedef struct {
     md3Triangle_t *triangles;
     md3TexCoord_t *texCoords;
     md3Vertex_t *vertices;  // Array of size: header.numVerts * header.numFrames
+    md3Shader_t *shaders;   // header.numShaders entries, NULL if none
+    char material[64];      // usemtl name with -mtl, empty if none
     int baseIndex;          // Global starting index for this surface’s vertices in OBJ output
 } md3SurfaceData;
 
@@ -98,12 +145,284 @@ typedef struct {
     md3SurfaceData *surfaces;
     int numSurfaces;
     /* New: store the full tag data if available */
-    md3Tag_t *tags;
+    md3Tag_t *tags;         // header.numTags per frame, all frames
+    md3Frame_t *frames;     // header.numFrames entries, NULL if unreadable
 } md3FileData;
 
 /* Global options (default: both enabled) */
 int g_flipUVs = 1;
 int g_swapYZ = 1;
+int g_numThreads = 0;   // 0 = one per online CPU
+int g_verify = 0;       // re-read each written OBJ frame and compare
+const char *g_mtlLib = NULL;  // mtllib referenced by every OBJ written (-mtl)
+
+/* --- Conversion Statistics (-stats) --- */
+
+/* Wall and CPU time are accumulated per phase, per input file and per output
+   frame, and written as JSON at the end of the run. "format" covers the emit
+   loops including buffered stdio output; "write" covers opening, flushing and
+   closing output files. All hooks are no-ops unless -stats was given. */
+enum {
+    STAT_HEADER,
+    STAT_SURFACES,
+    STAT_DECODE,
+    STAT_FORMAT,
+    STAT_WRITE,
+    STAT_NUM_PHASES
+};
+
+static const char *g_statPhaseNames[STAT_NUM_PHASES] = { "header", "surfaces", "decode", "format", "write" };
+
+typedef struct {
+    double wall;
+    double cpu;
+} md3Clock;
+
+typedef struct {
+    char path[256];
+    long bytesRead;
+    int numFrames;
+    int numSurfaces;
+    long vertices;   /* per frame, all surfaces */
+    long triangles;
+    md3Clock phases[STAT_NUM_PHASES];
+} md3FileStats;
+
+typedef struct {
+    int frame;
+    char output[256];
+    long bytesWritten;
+    md3Clock phases[STAT_NUM_PHASES];
+} md3FrameStats;
+
+typedef struct {
+    int enabled;
+    md3Clock start;
+    md3Clock phases[STAT_NUM_PHASES];
+    long bytesRead;
+    long bytesWritten;
+    long verticesWritten;
+    long trianglesWritten;
+    md3FileStats *files;
+    int numFiles;
+    md3FrameStats *frames;
+    int numFrames;
+    int capFrames;
+    md3FileStats *currentFile;
+    md3FrameStats *currentFrame;
+    FILE *out;       /* the original stdout when stats go to "-" */
+} md3Stats;
+
+md3Stats g_stats;
+
+void stats_now(md3Clock *c) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    c->wall = ts.tv_sec + ts.tv_nsec * 1e-9;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    c->cpu = ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+void stats_enable(void) {
+    memset(&g_stats, 0, sizeof(g_stats));
+    g_stats.enabled = 1;
+    stats_now(&g_stats.start);
+}
+
+/* With "-stats -", stdout carries only the JSON: it is kept aside and
+   progress output is sent to stderr for the rest of the run */
+int stats_claim_stdout(void) {
+    fflush(stdout);
+    int fd = dup(STDOUT_FILENO);
+    if (fd < 0 || dup2(STDERR_FILENO, STDOUT_FILENO) < 0 || !(g_stats.out = fdopen(fd, "w"))) {
+        fprintf(stderr, "Error redirecting output for -stats -: %s\n", strerror(errno));
+        if (fd >= 0) close(fd);
+        return 0;
+    }
+    return 1;
+}
+
+/* Marks the start of a timed region */
+void stats_begin(md3Clock *start) {
+    if (g_stats.enabled) stats_now(start);
+}
+
+/* Adds the time since start to a phase (and to the current file/frame) */
+void stats_end(int phase, const md3Clock *start) {
+    if (!g_stats.enabled) return;
+    md3Clock now;
+    stats_now(&now);
+    double wall = now.wall - start->wall, cpu = now.cpu - start->cpu;
+    g_stats.phases[phase].wall += wall;
+    g_stats.phases[phase].cpu += cpu;
+    if (g_stats.currentFile) {
+        g_stats.currentFile->phases[phase].wall += wall;
+        g_stats.currentFile->phases[phase].cpu += cpu;
+    }
+    if (g_stats.currentFrame) {
+        g_stats.currentFrame->phases[phase].wall += wall;
+        g_stats.currentFrame->phases[phase].cpu += cpu;
+    }
+}
+
+void stats_add_bytes_read(long bytes) {
+    if (!g_stats.enabled) return;
+    g_stats.bytesRead += bytes;
+    if (g_stats.currentFile) g_stats.currentFile->bytesRead += bytes;
+}
+
+void stats_add_bytes_written(long bytes) {
+    if (!g_stats.enabled) return;
+    g_stats.bytesWritten += bytes;
+    if (g_stats.currentFrame) g_stats.currentFrame->bytesWritten += bytes;
+}
+
+/* Starts a per-input-file record; subsequent reads are attributed to it */
+void stats_file_begin(const char *path) {
+    if (!g_stats.enabled) return;
+    md3FileStats *files = (md3FileStats*) realloc(g_stats.files, (g_stats.numFiles + 1) * sizeof(md3FileStats));
+    if (!files) return;
+    g_stats.files = files;
+    g_stats.currentFile = &files[g_stats.numFiles++];
+    memset(g_stats.currentFile, 0, sizeof(md3FileStats));
+    snprintf(g_stats.currentFile->path, sizeof(g_stats.currentFile->path), "%s", path);
+}
+
+void stats_file_end(const md3Header_t *header, const md3SurfaceData *surfaces, int numSurfaces) {
+    if (!g_stats.enabled || !g_stats.currentFile) return;
+    md3FileStats *fs = g_stats.currentFile;
+    fs->numFrames = header->numFrames;
+    fs->numSurfaces = numSurfaces;
+    for (int s = 0; s < numSurfaces; s++) {
+        fs->vertices += surfaces[s].header.numVerts;
+        fs->triangles += surfaces[s].header.numTriangles;
+    }
+    g_stats.currentFile = NULL;
+}
+
+/* Starts a per-output-frame record */
+void stats_frame_begin(int frame, const char *output) {
+    if (!g_stats.enabled) return;
+    if (g_stats.numFrames == g_stats.capFrames) {
+        int cap = g_stats.capFrames ? g_stats.capFrames * 2 : 64;
+        md3FrameStats *frames = (md3FrameStats*) realloc(g_stats.frames, cap * sizeof(md3FrameStats));
+        if (!frames) return;
+        g_stats.frames = frames;
+        g_stats.capFrames = cap;
+    }
+    g_stats.currentFrame = &g_stats.frames[g_stats.numFrames++];
+    memset(g_stats.currentFrame, 0, sizeof(md3FrameStats));
+    g_stats.currentFrame->frame = frame;
+    snprintf(g_stats.currentFrame->output, sizeof(g_stats.currentFrame->output), "%s", output);
+}
+
+void stats_frame_end(void) {
+    g_stats.currentFrame = NULL;
+}
+
+/* Counts geometry emitted for one frame of a set of surfaces */
+void stats_add_geometry(const md3SurfaceData *surfaces, int numSurfaces) {
+    if (!g_stats.enabled) return;
+    for (int s = 0; s < numSurfaces; s++) {
+        g_stats.verticesWritten += surfaces[s].header.numVerts;
+        g_stats.trianglesWritten += surfaces[s].header.numTriangles;
+    }
+}
+
+/* Peak resident set size in bytes (ru_maxrss is KiB on Linux, bytes on macOS) */
+long stats_peak_rss(void) {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return -1;
+#ifdef __APPLE__
+    return (long)usage.ru_maxrss;
+#else
+    return (long)usage.ru_maxrss * 1024L;
+#endif
+}
+
+/* Writes at most maxLen chars of str (fixed-size MD3 names need not be
+   terminated) as a quoted, escaped JSON string */
+void stats_json_stringn(FILE *fp, const char *str, size_t maxLen) {
+    fputc('"', fp);
+    for (const unsigned char *c = (const unsigned char*)str; (size_t)(c - (const unsigned char*)str) < maxLen && *c; c++) {
+        if (*c == '"' || *c == '\\') {
+            fprintf(fp, "\\%c", *c);
+        } else if (*c < 0x20) {
+            fprintf(fp, "\\u%04x", *c);
+        } else {
+            fputc(*c, fp);
+        }
+    }
+    fputc('"', fp);
+}
+
+void stats_json_string(FILE *fp, const char *str) {
+    stats_json_stringn(fp, str, SIZE_MAX);
+}
+
+void stats_json_phases(FILE *fp, const md3Clock *phases, int first, int last) {
+    fprintf(fp, "{");
+    for (int p = first; p <= last; p++) {
+        fprintf(fp, "%s\"%s\": {\"wall_ms\": %.3f, \"cpu_ms\": %.3f}", p > first ? ", " : "",
+                g_statPhaseNames[p], phases[p].wall * 1e3, phases[p].cpu * 1e3);
+    }
+    fprintf(fp, "}");
+}
+
+/* Writes the collected statistics as JSON to path ("-" for the stdout kept
+   by stats_claim_stdout) */
+int write_stats_json(const char *path, const char *mode) {
+    FILE *fp = strcmp(path, "-") == 0 ? g_stats.out : fopen(path, "w");
+    if (!fp) {
+        fprintf(stderr, "Error opening stats file %s: %s\n", path, strerror(errno));
+        return 0;
+    }
+    md3Clock now;
+    stats_now(&now);
+    fprintf(fp, "{\n  \"mode\": \"%s\",\n", mode);
+    fprintf(fp, "  \"wall_ms\": %.3f,\n  \"cpu_ms\": %.3f,\n",
+            (now.wall - g_stats.start.wall) * 1e3, (now.cpu - g_stats.start.cpu) * 1e3);
+    fprintf(fp, "  \"phases\": ");
+    stats_json_phases(fp, g_stats.phases, 0, STAT_NUM_PHASES - 1);
+    fprintf(fp, ",\n  \"bytes_read\": %ld,\n  \"bytes_written\": %ld,\n", g_stats.bytesRead, g_stats.bytesWritten);
+    fprintf(fp, "  \"vertices_written\": %ld,\n  \"triangles_written\": %ld,\n", g_stats.verticesWritten, g_stats.trianglesWritten);
+    fprintf(fp, "  \"peak_rss_bytes\": %ld,\n", stats_peak_rss());
+    fprintf(fp, "  \"files\": [");
+    for (int i = 0; i < g_stats.numFiles; i++) {
+        const md3FileStats *fs = &g_stats.files[i];
+        fprintf(fp, "%s\n    {\"path\": ", i ? "," : "");
+        stats_json_string(fp, fs->path);
+        fprintf(fp, ", \"bytes_read\": %ld, \"frames\": %d, \"surfaces\": %d, \"vertices\": %ld, \"triangles\": %ld, \"phases\": ",
+                fs->bytesRead, fs->numFrames, fs->numSurfaces, fs->vertices, fs->triangles);
+        stats_json_phases(fp, fs->phases, STAT_HEADER, STAT_SURFACES);
+        fprintf(fp, "}");
+    }
+    fprintf(fp, "\n  ],\n  \"frames\": [");
+    for (int i = 0; i < g_stats.numFrames; i++) {
+        const md3FrameStats *fr = &g_stats.frames[i];
+        fprintf(fp, "%s\n    {\"frame\": %d, \"output\": ", i ? "," : "", fr->frame);
+        stats_json_string(fp, fr->output);
+        fprintf(fp, ", \"bytes_written\": %ld, \"phases\": ", fr->bytesWritten);
+        stats_json_phases(fp, fr->phases, STAT_DECODE, STAT_WRITE);
+        fprintf(fp, "}");
+    }
+    fprintf(fp, "\n  ]\n}\n");
+    g_stats.out = NULL;
+    if (fclose(fp) != 0) {
+        fprintf(stderr, "Error writing stats file %s\n", path);
+        return 0;
+    }
+    return 1;
+}
+
+void stats_free(void) {
+    if (g_stats.out) fclose(g_stats.out);
+    free(g_stats.files);
+    free(g_stats.frames);
+    memset(&g_stats, 0, sizeof(g_stats));
+}
+
+/* --- End Conversion Statistics --- */
 
 /* Helper: get total file size (with error checking) */
 long getFileSize(FILE *fp) {
@@ -140,6 +459,299 @@ void decodeNormal(short encoded, float *nx, float *ny, float *nz) {
     *nz = cos(lngf);
 }
 
+/* Inverse of decodeNormal(): packs a unit vector into the lat/lng short,
+   rounding each angle to the nearest of the 256 steps. */
+short encodeNormal(float nx, float ny, float nz) {
+    float len = sqrtf(nx * nx + ny * ny + nz * nz);
+    if (len <= 0.0f) {
+        return 0;
+    }
+    nx /= len;
+    ny /= len;
+    nz /= len;
+    /* Poles: the azimuth is meaningless, so use 0 as Quake III does */
+    if (nx == 0.0f && ny == 0.0f) {
+        return nz > 0.0f ? 0 : (short)(128);
+    }
+    float lngf = acosf(nz > 1.0f ? 1.0f : (nz < -1.0f ? -1.0f : nz));
+    float latf = atan2f(ny, nx);
+    int lng = (int) lrintf(lngf * 128.0f / (float)M_PI);
+    int lat = (int) lrintf(latf * 128.0f / (float)M_PI);
+    return (short)(unsigned short)(((lat & 0xFF) << 8) | (lng & 0xFF));
+}
+
+/* Inverse of the MD3_XYZ_SCALE dequantization, clamped to the int16 range */
+short quantizePosition(float value) {
+    float q = value / MD3_XYZ_SCALE;
+    if (q > 32767.0f) q = 32767.0f;
+    if (q < -32768.0f) q = -32768.0f;
+    return (short) lrintf(q);
+}
+
+/* --- Vertex Dequantization Kernels --- */
+
+/* Converts an array of packed md3Vertex_t into float positions stored as
+   separate x/y/z arrays (structure-of-arrays), applying MD3_XYZ_SCALE.
+   The kernels only dequantize; Y/Z swapping is done by decode_positions()
+   exchanging the destination arrays, so there is no per-vertex branch. */
+typedef void (*decodePositionsFn)(const md3Vertex_t *src, int count, float *x, float *y, float *z);
+
+void decode_positions_scalar(const md3Vertex_t *src, int count, float *x, float *y, float *z) {
+    for (int i = 0; i < count; i++) {
+        x[i] = src[i].xyz[0] * MD3_XYZ_SCALE;
+        y[i] = src[i].xyz[1] * MD3_XYZ_SCALE;
+        z[i] = src[i].xyz[2] * MD3_XYZ_SCALE;
+    }
+}
+
+#ifdef MD3_SIMD_X86
+/* 4 vertices per iteration: a 4x4 transpose of int16 lanes, then sign-extend,
+   convert and scale. */
+__attribute__((target("sse2")))
+void decode_positions_sse2(const md3Vertex_t *src, int count, float *x, float *y, float *z) {
+    const __m128 scale = _mm_set1_ps(MD3_XYZ_SCALE);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(src + i));      /* x0 y0 z0 n0 x1 y1 z1 n1 */
+        __m128i b = _mm_loadu_si128((const __m128i*)(src + i + 2));  /* x2 y2 z2 n2 x3 y3 z3 n3 */
+        __m128i c = _mm_unpacklo_epi16(a, b);                        /* x0 x2 y0 y2 z0 z2 n0 n2 */
+        __m128i d = _mm_unpackhi_epi16(a, b);                        /* x1 x3 y1 y3 z1 z3 n1 n3 */
+        __m128i xy = _mm_unpacklo_epi16(c, d);                       /* x0 x1 x2 x3 y0 y1 y2 y3 */
+        __m128i zn = _mm_unpackhi_epi16(c, d);                       /* z0 z1 z2 z3 n0 n1 n2 n3 */
+        __m128i xi = _mm_srai_epi32(_mm_unpacklo_epi16(xy, xy), 16);
+        __m128i yi = _mm_srai_epi32(_mm_unpackhi_epi16(xy, xy), 16);
+        __m128i zi = _mm_srai_epi32(_mm_unpacklo_epi16(zn, zn), 16);
+        _mm_storeu_ps(x + i, _mm_mul_ps(_mm_cvtepi32_ps(xi), scale));
+        _mm_storeu_ps(y + i, _mm_mul_ps(_mm_cvtepi32_ps(yi), scale));
+        _mm_storeu_ps(z + i, _mm_mul_ps(_mm_cvtepi32_ps(zi), scale));
+    }
+    decode_positions_scalar(src + i, count - i, x + i, y + i, z + i);
+}
+
+/* 8 vertices per iteration: the same transpose within each 128-bit lane, after
+   regrouping the input so lane 0 holds vertices 0-3 and lane 1 vertices 4-7. */
+__attribute__((target("avx2")))
+void decode_positions_avx2(const md3Vertex_t *src, int count, float *x, float *y, float *z) {
+    const __m256 scale = _mm256_set1_ps(MD3_XYZ_SCALE);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(src + i));      /* v0 v1 | v2 v3 */
+        __m256i b = _mm256_loadu_si256((const __m256i*)(src + i + 4));  /* v4 v5 | v6 v7 */
+        __m256i lo = _mm256_permute2x128_si256(a, b, 0x20);             /* v0 v1 | v4 v5 */
+        __m256i hi = _mm256_permute2x128_si256(a, b, 0x31);             /* v2 v3 | v6 v7 */
+        __m256i c = _mm256_unpacklo_epi16(lo, hi);
+        __m256i d = _mm256_unpackhi_epi16(lo, hi);
+        __m256i xy = _mm256_unpacklo_epi16(c, d);
+        __m256i zn = _mm256_unpackhi_epi16(c, d);
+        __m256i xi = _mm256_srai_epi32(_mm256_unpacklo_epi16(xy, xy), 16);
+        __m256i yi = _mm256_srai_epi32(_mm256_unpackhi_epi16(xy, xy), 16);
+        __m256i zi = _mm256_srai_epi32(_mm256_unpacklo_epi16(zn, zn), 16);
+        _mm256_storeu_ps(x + i, _mm256_mul_ps(_mm256_cvtepi32_ps(xi), scale));
+        _mm256_storeu_ps(y + i, _mm256_mul_ps(_mm256_cvtepi32_ps(yi), scale));
+        _mm256_storeu_ps(z + i, _mm256_mul_ps(_mm256_cvtepi32_ps(zi), scale));
+    }
+    decode_positions_sse2(src + i, count - i, x + i, y + i, z + i);
+}
+#endif
+
+/* Picks the widest kernel the running CPU supports */
+decodePositionsFn select_decode_positions(void) {
+#ifdef MD3_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return decode_positions_avx2;
+    if (__builtin_cpu_supports("sse2")) return decode_positions_sse2;
+#endif
+    return decode_positions_scalar;
+}
+
+/* Chosen once; run_parallel workers call decode_positions concurrently */
+static pthread_once_t g_decodePositionsOnce = PTHREAD_ONCE_INIT;
+static decodePositionsFn g_decodePositions;
+
+void init_decode_positions(void) {
+    g_decodePositions = select_decode_positions();
+}
+
+/* Dequantizes count vertices into x/y/z arrays, swapping Y and Z if requested */
+void decode_positions(const md3Vertex_t *src, int count, int swapYZ, float *x, float *y, float *z) {
+    pthread_once(&g_decodePositionsOnce, init_decode_positions);
+    decodePositionsFn kernel = g_decodePositions;
+    if (swapYZ) {
+        kernel(src, count, x, z, y);
+    } else {
+        kernel(src, count, x, y, z);
+    }
+}
+
+/* Decodes the encoded normals of count vertices into nx/ny/nz arrays */
+void decode_normals(const md3Vertex_t *src, int count, float *nx, float *ny, float *nz) {
+    for (int i = 0; i < count; i++) {
+        decodeNormal(src[i].normal, &nx[i], &ny[i], &nz[i]);
+    }
+}
+
+/* --- End Vertex Dequantization Kernels --- */
+
+/* --- Tag Transform Kernels --- */
+
+/* Applies a tag's 3x3 axis (and optionally its origin) in place to points
+   stored as x/y/z arrays. The matrix is loaded into registers once and
+   4 (SSE2) or 8 (AVX) points are transformed per iteration. The evaluation
+   order follows the scalar code, so the kernels match the scalar path up to
+   rounding (the compiler may contract the scalar code into FMAs). */
+typedef void (*transformPointsFn)(float *x, float *y, float *z, int count, const md3Tag_t *tag, int translate);
+
+void transform_points_scalar(float *x, float *y, float *z, int count, const md3Tag_t *tag, int translate) {
+    const float (*m)[3] = tag->axis;
+    for (int i = 0; i < count; i++) {
+        float vx = x[i], vy = y[i], vz = z[i];
+        if (translate) {
+            x[i] = tag->origin[0] + m[0][0]*vx + m[0][1]*vy + m[0][2]*vz;
+            y[i] = tag->origin[1] + m[1][0]*vx + m[1][1]*vy + m[1][2]*vz;
+            z[i] = tag->origin[2] + m[2][0]*vx + m[2][1]*vy + m[2][2]*vz;
+        } else {
+            x[i] = m[0][0]*vx + m[0][1]*vy + m[0][2]*vz;
+            y[i] = m[1][0]*vx + m[1][1]*vy + m[1][2]*vz;
+            z[i] = m[2][0]*vx + m[2][1]*vy + m[2][2]*vz;
+        }
+    }
+}
+
+#ifdef MD3_SIMD_X86
+__attribute__((target("sse2")))
+void transform_points_sse2(float *x, float *y, float *z, int count, const md3Tag_t *tag, int translate) {
+    __m128 m[3][3], o[3];
+    for (int r = 0; r < 3; r++) {
+        o[r] = _mm_set1_ps(tag->origin[r]);
+        for (int c = 0; c < 3; c++) m[r][c] = _mm_set1_ps(tag->axis[r][c]);
+    }
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 vx = _mm_loadu_ps(x + i), vy = _mm_loadu_ps(y + i), vz = _mm_loadu_ps(z + i);
+        __m128 r[3];
+        for (int k = 0; k < 3; k++) {
+            __m128 acc = _mm_mul_ps(m[k][0], vx);
+            if (translate) acc = _mm_add_ps(o[k], acc);
+            acc = _mm_add_ps(acc, _mm_mul_ps(m[k][1], vy));
+            r[k] = _mm_add_ps(acc, _mm_mul_ps(m[k][2], vz));
+        }
+        _mm_storeu_ps(x + i, r[0]);
+        _mm_storeu_ps(y + i, r[1]);
+        _mm_storeu_ps(z + i, r[2]);
+    }
+    transform_points_scalar(x + i, y + i, z + i, count - i, tag, translate);
+}
+
+__attribute__((target("avx")))
+void transform_points_avx(float *x, float *y, float *z, int count, const md3Tag_t *tag, int translate) {
+    __m256 m[3][3], o[3];
+    for (int r = 0; r < 3; r++) {
+        o[r] = _mm256_set1_ps(tag->origin[r]);
+        for (int c = 0; c < 3; c++) m[r][c] = _mm256_set1_ps(tag->axis[r][c]);
+    }
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 vx = _mm256_loadu_ps(x + i), vy = _mm256_loadu_ps(y + i), vz = _mm256_loadu_ps(z + i);
+        __m256 r[3];
+        for (int k = 0; k < 3; k++) {
+            __m256 acc = _mm256_mul_ps(m[k][0], vx);
+            if (translate) acc = _mm256_add_ps(o[k], acc);
+            acc = _mm256_add_ps(acc, _mm256_mul_ps(m[k][1], vy));
+            r[k] = _mm256_add_ps(acc, _mm256_mul_ps(m[k][2], vz));
+        }
+        _mm256_storeu_ps(x + i, r[0]);
+        _mm256_storeu_ps(y + i, r[1]);
+        _mm256_storeu_ps(z + i, r[2]);
+    }
+    transform_points_sse2(x + i, y + i, z + i, count - i, tag, translate);
+}
+#endif
+
+/* Picks the widest kernel the running CPU supports */
+transformPointsFn select_transform_points(void) {
+#ifdef MD3_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx")) return transform_points_avx;
+    if (__builtin_cpu_supports("sse2")) return transform_points_sse2;
+#endif
+    return transform_points_scalar;
+}
+
+static pthread_once_t g_transformPointsOnce = PTHREAD_ONCE_INIT;
+static transformPointsFn g_transformPoints;
+
+void init_transform_points(void) {
+    g_transformPoints = select_transform_points();
+}
+
+/* Transforms count points (translate=1) or directions (translate=0) by a tag */
+void transform_points(float *x, float *y, float *z, int count, const md3Tag_t *tag, int translate) {
+    pthread_once(&g_transformPointsOnce, init_transform_points);
+    g_transformPoints(x, y, z, count, tag, translate);
+}
+
+/* --- End Tag Transform Kernels --- */
+
+/* --- Parallel Helpers --- */
+
+/* run_parallel() splits [0, count) into contiguous chunks, one per worker
+   thread, and calls fn on each chunk. Workers must only write to their own
+   range; the stats counters are not thread-safe, so callers time the whole
+   run from the calling thread. */
+typedef void (*parallelFn)(void *ctx, int begin, int end);
+
+typedef struct {
+    parallelFn fn;
+    void *ctx;
+    int begin, end;
+} parallelChunk;
+
+#define MAX_THREADS 64
+
+void *parallel_worker(void *arg) {
+    parallelChunk *chunk = (parallelChunk*) arg;
+    chunk->fn(chunk->ctx, chunk->begin, chunk->end);
+    return NULL;
+}
+
+int parallel_thread_count(int count) {
+    int threads = g_numThreads;
+    if (threads <= 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = cpus > 0 ? (int) cpus : 1;
+    }
+    if (threads > MAX_THREADS) threads = MAX_THREADS;
+    if (threads > count) threads = count;
+    return threads > 0 ? threads : 1;
+}
+
+void run_parallel(int count, parallelFn fn, void *ctx) {
+    int threads = parallel_thread_count(count);
+    if (threads <= 1) {
+        if (count > 0) fn(ctx, 0, count);
+        return;
+    }
+    pthread_t ids[MAX_THREADS];
+    parallelChunk chunks[MAX_THREADS];
+    int started[MAX_THREADS];
+    for (int t = 0; t < threads; t++) {
+        chunks[t].fn = fn;
+        chunks[t].ctx = ctx;
+        chunks[t].begin = (int)((long long) count * t / threads);
+        chunks[t].end = (int)((long long) count * (t + 1) / threads);
+        /* Chunk 0 runs on the calling thread; a failed create also runs inline */
+        started[t] = t > 0 && pthread_create(&ids[t], NULL, parallel_worker, &chunks[t]) == 0;
+    }
+    for (int t = 0; t < threads; t++) {
+        if (!started[t]) parallel_worker(&chunks[t]);
+    }
+    for (int t = 1; t < threads; t++) {
+        if (started[t]) pthread_join(ids[t], NULL);
+    }
+}
+
+/* --- End Parallel Helpers --- */
+
 /* Simple function to extract the basename (without path or extension) */
 void getBasename(const char *path, char *basename, size_t size) {
     const char *p = strrchr(path, '/');
@@ -157,6 +769,7 @@ void free_surfaces(md3SurfaceData *surfaces, int count) {
         free(surfaces[i].triangles);
         free(surfaces[i].texCoords);
         free(surfaces[i].vertices);
+        free(surfaces[i].shaders);
     }
     free(surfaces);
 }
@@ -175,6 +788,7 @@ int read_from_offset(FILE *fp, long offset, void *buffer, size_t size, long file
         fprintf(stderr, "fread error: %s\n", strerror(errno));
         return 0;
     }
+    stats_add_bytes_read((long)size);
     return 1;
 }
 
@@ -184,6 +798,7 @@ int read_md3_header(FILE *fp, md3Header_t *header, long fileSize) {
         fprintf(stderr, "Error reading MD3 header: %s\n", strerror(errno));
         return 0;
     }
+    stats_add_bytes_read(sizeof(md3Header_t));
     if (strncmp(header->id, "IDP3", 4) != 0 || header->version != MD3_VERSION) {
         fprintf(stderr, "Invalid MD3 file format or version.\n");
         return 0;
@@ -195,143 +810,115 @@ int read_md3_header(FILE *fp, md3Header_t *header, long fileSize) {
     return 1;
 }
 
-/* Reads all surfaces from the MD3 file */
-md3SurfaceData *read_md3_surfaces(FILE *fp, const md3Header_t *header, int *numSurfacesOut) {
-    int numSurfaces = header->numSurfaces;
-    long fileSize = getFileSize(fp);
-    if (fileSize < 0) return NULL;
-    md3SurfaceData *surfaces = (md3SurfaceData*) calloc(numSurfaces, sizeof(md3SurfaceData));
-    if (!surfaces) {
-        fprintf(stderr, "Memory allocation failed for surfaces.\n");
-        return NULL;
-    }
-    if (fseek(fp, header->ofsSurfaces, SEEK_SET) != 0) {
-        fprintf(stderr, "Error seeking to surfaces block.\n");
-        free(surfaces);
-        return NULL;
-    }
-    for (int s = 0; s < numSurfaces; s++) {
-        long surfaceStart = ftell(fp);
-        /* Read surface header */
-        if (!read_from_offset(fp, surfaceStart, &surfaces[s].header, sizeof(md3Surface_t), fileSize)) {
-            free_surfaces(surfaces, s);
-            return NULL;
-        }
-        if (strncmp(surfaces[s].header.id, "IDP3", 4) != 0) {
-            fprintf(stderr, "Invalid surface id at surface %d.\n", s);
-            free_surfaces(surfaces, s + 1);
-            return NULL;
-        }
-        /* Read triangles */
-        int triSize = surfaces[s].header.numTriangles * sizeof(md3Triangle_t);
-        surfaces[s].triangles = (md3Triangle_t*) malloc(triSize);
-        if (!surfaces[s].triangles ||
-            !read_from_offset(fp, surfaceStart + surfaces[s].header.ofsTriangles, surfaces[s].triangles, triSize, fileSize)) {
-            fprintf(stderr, "Error reading triangles for surface %s.\n", surfaces[s].header.name);
-            free_surfaces(surfaces, s + 1);
-            return NULL;
-        }
-        /* Read texture coordinates */
-        int tcSize = surfaces[s].header.numVerts * sizeof(md3TexCoord_t);
-        surfaces[s].texCoords = (md3TexCoord_t*) malloc(tcSize);
-        if (!surfaces[s].texCoords ||
-            !read_from_offset(fp, surfaceStart + surfaces[s].header.ofsST, surfaces[s].texCoords, tcSize, fileSize)) {
-            fprintf(stderr, "Error reading texture coordinates for surface %s.\n", surfaces[s].header.name);
-            free_surfaces(surfaces, s + 1);
-            return NULL;
-        }
-        /* Read vertices for all frames */
-        int totalVerts = surfaces[s].header.numVerts * surfaces[s].header.numFrames;
-        int vertSize = totalVerts * sizeof(md3Vertex_t);
-        surfaces[s].vertices = (md3Vertex_t*) malloc(vertSize);
-        if (!surfaces[s].vertices ||
-            !read_from_offset(fp, surfaceStart + surfaces[s].header.ofsVerts, surfaces[s].vertices, vertSize, fileSize)) {
-            fprintf(stderr, "Error reading vertices for surface %s.\n", surfaces[s].header.name);
-            free_surfaces(surfaces, s + 1);
-            return NULL;
-        }
-        /* Jump to the end of this surface block */
-        if (fseek(fp, surfaceStart + surfaces[s].header.ofsEnd, SEEK_SET) != 0) {
-            fprintf(stderr, "Error seeking to next surface.\n");
-            free_surfaces(surfaces, s + 1);
-            return NULL;
-        }
-    }
-    *numSurfacesOut = numSurfaces;
-    return surfaces;
-}
+/* --- OBJ Emitters --- */
 
-/* Writes a single OBJ file for a given animation frame (single-file mode) */
-int write_obj_frame(const md3Header_t *header, md3SurfaceData *surfaces, int numSurfaces, int frame, const char *outputName) {
-    FILE *outFile = fopen(outputName, "w");
-    if (!outFile) {
-        fprintf(stderr, "Error opening output file %s: %s\n", outputName, strerror(errno));
-        return 0;
+/* The emit loops below take flipUVs/swapYZ as parameters and are always
+   inlined into the specializations generated by DEFINE_OBJ_EMITTERS, so every
+   flag test is resolved at compile time. Writers pick the matching set once
+   with select_obj_emitters() instead of testing the globals per element. */
+#if defined(__GNUC__)
+#define MD3_FORCE_INLINE static inline __attribute__((always_inline))
+#else
+#define MD3_FORCE_INLINE static inline
+#endif
+
+/* Writes the vertex positions (v) of one frame for every surface */
+MD3_FORCE_INLINE int write_obj_positions_impl(FILE *outFile, md3SurfaceData *surfaces, int numSurfaces, int frame, const char *outputName, const int swapYZ) {
+    int maxVerts = 0;
+    for (int s = 0; s < numSurfaces; s++) {
+        if (surfaces[s].header.numVerts > maxVerts) maxVerts = surfaces[s].header.numVerts;
     }
-    /* Write object header */
-    if (fprintf(outFile, "o %s\n", header->name) < 0) {
-        fprintf(stderr, "Error writing to %s\n", outputName);
-        fclose(outFile);
+    float *xyz = (float*) malloc((size_t)(maxVerts > 0 ? maxVerts : 1) * 3 * sizeof(float));
+    if (!xyz) {
+        fprintf(stderr, "Memory allocation failed for vertex buffer.\n");
         return 0;
     }
-    /* Write vertex positions (v) */
+    float *x = xyz, *y = xyz + maxVerts, *z = xyz + 2 * maxVerts;
+    md3Clock clock;
     for (int s = 0; s < numSurfaces; s++) {
         int numVerts = surfaces[s].header.numVerts;
+        stats_begin(&clock);
+        decode_positions(surfaces[s].vertices + (size_t)frame * numVerts, numVerts, swapYZ, x, y, z);
+        stats_end(STAT_DECODE, &clock);
+        stats_begin(&clock);
         for (int v = 0; v < numVerts; v++) {
-            int idx = frame * numVerts + v;
-            md3Vertex_t vert = surfaces[s].vertices[idx];
-            float x = vert.xyz[0] * MD3_XYZ_SCALE;
-            float y = vert.xyz[1] * MD3_XYZ_SCALE;
-            float z = vert.xyz[2] * MD3_XYZ_SCALE;
-            if (g_swapYZ) {
-                float temp = y; y = z; z = temp;
-            }
-            if (fprintf(outFile, "v %f %f %f\n", x, y, z) < 0) {
+            if (fprintf(outFile, "v %f %f %f\n", x[v], y[v], z[v]) < 0) {
                 fprintf(stderr, "Error writing vertex to %s\n", outputName);
-                fclose(outFile);
+                free(xyz);
                 return 0;
             }
         }
+        stats_end(STAT_FORMAT, &clock);
     }
-    /* Write texture coordinates (vt) – these do not change per frame */
+    free(xyz);
+    return 1;
+}
+
+/* Writes the texture coordinates (vt) for every surface – these do not change per frame */
+MD3_FORCE_INLINE int write_obj_texcoords_impl(FILE *outFile, md3SurfaceData *surfaces, int numSurfaces, const char *outputName, const int flipUVs) {
+    md3Clock clock;
+    stats_begin(&clock);
     for (int s = 0; s < numSurfaces; s++) {
         int numVerts = surfaces[s].header.numVerts;
         for (int v = 0; v < numVerts; v++) {
             float u = surfaces[s].texCoords[v].st[0];
             float t = surfaces[s].texCoords[v].st[1];
-            if (g_flipUVs) {
+            if (flipUVs) {
                 t = 1.0f - t;
             }
             if (fprintf(outFile, "vt %f %f\n", u, t) < 0) {
                 fprintf(stderr, "Error writing texcoord to %s\n", outputName);
-                fclose(outFile);
                 return 0;
             }
         }
     }
-    /* Write vertex normals (vn) */
+    stats_end(STAT_FORMAT, &clock);
+    return 1;
+}
+
+/* Writes the vertex normals (vn) of one frame for every surface */
+MD3_FORCE_INLINE int write_obj_normals_impl(FILE *outFile, md3SurfaceData *surfaces, int numSurfaces, int frame, const char *outputName, const int swapYZ) {
+    int maxVerts = 0;
+    for (int s = 0; s < numSurfaces; s++) {
+        if (surfaces[s].header.numVerts > maxVerts) maxVerts = surfaces[s].header.numVerts;
+    }
+    float *nxyz = (float*) malloc((size_t)(maxVerts > 0 ? maxVerts : 1) * 3 * sizeof(float));
+    if (!nxyz) {
+        fprintf(stderr, "Memory allocation failed for normal buffer.\n");
+        return 0;
+    }
+    float *nx = nxyz, *ny = nxyz + maxVerts, *nz = nxyz + 2 * maxVerts;
+    const float *py = swapYZ ? nz : ny, *pz = swapYZ ? ny : nz;
+    md3Clock clock;
     for (int s = 0; s < numSurfaces; s++) {
         int numVerts = surfaces[s].header.numVerts;
+        stats_begin(&clock);
+        decode_normals(surfaces[s].vertices + (size_t)frame * numVerts, numVerts, nx, ny, nz);
+        stats_end(STAT_DECODE, &clock);
+        stats_begin(&clock);
         for (int v = 0; v < numVerts; v++) {
-            int idx = frame * numVerts + v;
-            md3Vertex_t vert = surfaces[s].vertices[idx];
-            float nx, ny, nz;
-            decodeNormal(vert.normal, &nx, &ny, &nz);
-            if (g_swapYZ) {
-                float temp = ny; ny = nz; nz = temp;
-            }
-            if (fprintf(outFile, "vn %f %f %f\n", nx, ny, nz) < 0) {
+            if (fprintf(outFile, "vn %f %f %f\n", nx[v], py[v], pz[v]) < 0) {
                 fprintf(stderr, "Error writing normal to %s\n", outputName);
-                fclose(outFile);
+                free(nxyz);
                 return 0;
             }
         }
+        stats_end(STAT_FORMAT, &clock);
     }
-    /* Write face definitions (f) */
+    free(nxyz);
+    return 1;
+}
+
+/* Writes the face definitions (f) for every surface. Position and normal
+   indices are shifted by frameOffset; texture coordinate indices are not, so
+   several frames in one OBJ can share a single vt block. */
+MD3_FORCE_INLINE int write_obj_faces_impl(FILE *outFile, md3SurfaceData *surfaces, int numSurfaces, int frameOffset, const char *outputName, const int swapYZ) {
+    md3Clock clock;
+    stats_begin(&clock);
     for (int s = 0; s < numSurfaces; s++) {
-        if (fprintf(outFile, "g %s\n", surfaces[s].header.name) < 0) {
+        if (fprintf(outFile, "g %s\n", surfaces[s].header.name) < 0 ||
+            (surfaces[s].material[0] && fprintf(outFile, "usemtl %s\n", surfaces[s].material) < 0)) {
             fprintf(stderr, "Error writing group name to %s\n", outputName);
-            fclose(outFile);
             return 0;
         }
         int base = surfaces[s].baseIndex;
@@ -339,7 +926,7 @@ int write_obj_frame(const md3Header_t *header, md3SurfaceData *surfaces, int num
         for (int t = 0; t < numTris; t++) {
             md3Triangle_t tri = surfaces[s].triangles[t];
             int i1, i2, i3;
-            if (g_swapYZ) {
+            if (swapYZ) {
                 i1 = base + tri.indexes[0];
                 i2 = base + tri.indexes[1];
                 i3 = base + tri.indexes[2];
@@ -349,202 +936,5110 @@ int write_obj_frame(const md3Header_t *header, md3SurfaceData *surfaces, int num
                 i3 = base + tri.indexes[0];
             }
             if (fprintf(outFile, "f %d/%d/%d %d/%d/%d %d/%d/%d\n",
-                        i1, i1, i1, i2, i2, i2, i3, i3, i3) < 0) {
+                        i1 + frameOffset, i1, i1 + frameOffset,
+                        i2 + frameOffset, i2, i2 + frameOffset,
+                        i3 + frameOffset, i3, i3 + frameOffset) < 0) {
                 fprintf(stderr, "Error writing face data to %s\n", outputName);
-                fclose(outFile);
                 return 0;
             }
         }
     }
-    fclose(outFile);
+    stats_end(STAT_FORMAT, &clock);
     return 1;
 }
 
-/* --- New Merge Mode Functions --- */
+/* One specialized set of emit loops for a flipUVs/swapYZ combination */
+typedef struct {
+    int (*positions)(FILE *outFile, md3SurfaceData *surfaces, int numSurfaces, int frame, const char *outputName);
+    int (*texcoords)(FILE *outFile, md3SurfaceData *surfaces, int numSurfaces, const char *outputName);
+    int (*normals)(FILE *outFile, md3SurfaceData *surfaces, int numSurfaces, int frame, const char *outputName);
+    int (*faces)(FILE *outFile, md3SurfaceData *surfaces, int numSurfaces, int frameOffset, const char *outputName);
+} objEmitters_t;
 
-/* Reads a single MD3 file into an md3FileData structure.
-   Now also reads tag data (if available). */
-int load_md3_file(const char *filename, md3FileData *fileData) {
-    FILE *fp = fopen(filename, "rb");
-    if (!fp) {
-        fprintf(stderr, "Error opening file %s: %s\n", filename, strerror(errno));
+#define DEFINE_OBJ_EMITTERS(NAME, FLIP, SWAP) \
+    static int NAME##_positions(FILE *outFile, md3SurfaceData *surfaces, int numSurfaces, int frame, const char *outputName) { \
+        return write_obj_positions_impl(outFile, surfaces, numSurfaces, frame, outputName, SWAP); \
+    } \
+    static int NAME##_texcoords(FILE *outFile, md3SurfaceData *surfaces, int numSurfaces, const char *outputName) { \
+        return write_obj_texcoords_impl(outFile, surfaces, numSurfaces, outputName, FLIP); \
+    } \
+    static int NAME##_normals(FILE *outFile, md3SurfaceData *surfaces, int numSurfaces, int frame, const char *outputName) { \
+        return write_obj_normals_impl(outFile, surfaces, numSurfaces, frame, outputName, SWAP); \
+    } \
+    static int NAME##_faces(FILE *outFile, md3SurfaceData *surfaces, int numSurfaces, int frameOffset, const char *outputName) { \
+        return write_obj_faces_impl(outFile, surfaces, numSurfaces, frameOffset, outputName, SWAP); \
+    } \
+    static const objEmitters_t NAME = { NAME##_positions, NAME##_texcoords, NAME##_normals, NAME##_faces };
+
+DEFINE_OBJ_EMITTERS(objEmitPlain, 0, 0)
+DEFINE_OBJ_EMITTERS(objEmitSwap, 0, 1)
+DEFINE_OBJ_EMITTERS(objEmitFlip, 1, 0)
+DEFINE_OBJ_EMITTERS(objEmitFlipSwap, 1, 1)
+
+/* Returns the emitters specialized for the given option combination */
+const objEmitters_t *select_obj_emitters(int flipUVs, int swapYZ) {
+    static const objEmitters_t *table[2][2] = {
+        { &objEmitPlain, &objEmitSwap },
+        { &objEmitFlip,  &objEmitFlipSwap }
+    };
+    return table[flipUVs != 0][swapYZ != 0];
+}
+
+/* --- End OBJ Emitters --- */
+
+/* Writes the OBJ text for a given animation frame to an already open stream.
+   outputName is only used in error messages; the stream is left open. */
+int write_obj_frame_to_stream(FILE *outFile, const md3Header_t *header, md3SurfaceData *surfaces, int numSurfaces, int frame, const char *outputName) {
+    /* Write object header */
+    if ((g_mtlLib && fprintf(outFile, "mtllib %s\n", g_mtlLib) < 0) ||
+        fprintf(outFile, "o %s\n", header->name) < 0) {
+        fprintf(stderr, "Error writing to %s\n", outputName);
         return 0;
     }
-    long fileSize = getFileSize(fp);
-    if (fileSize < 0) {
-        fclose(fp);
+    const objEmitters_t *emit = select_obj_emitters(g_flipUVs, g_swapYZ);
+    if (!emit->positions(outFile, surfaces, numSurfaces, frame, outputName) ||
+        !emit->texcoords(outFile, surfaces, numSurfaces, outputName) ||
+        !emit->normals(outFile, surfaces, numSurfaces, frame, outputName) ||
+        !emit->faces(outFile, surfaces, numSurfaces, 0, outputName)) {
         return 0;
     }
-    if (!read_md3_header(fp, &fileData->header, fileSize)) {
-        fclose(fp);
+    stats_add_geometry(surfaces, numSurfaces);
+    return 1;
+}
+
+/* Writes a single OBJ file for a given animation frame (single-file mode) */
+int write_obj_frame(const md3Header_t *header, md3SurfaceData *surfaces, int numSurfaces, int frame, const char *outputName) {
+    md3Clock clock;
+    stats_begin(&clock);
+    FILE *outFile = fopen(outputName, "w");
+    stats_end(STAT_WRITE, &clock);
+    if (!outFile) {
+        fprintf(stderr, "Error opening output file %s: %s\n", outputName, strerror(errno));
         return 0;
     }
-    /* If there are tags, read the first frame's tags */
-    if (fileData->header.numTags > 0) {
-        fileData->tags = (md3Tag_t*) malloc(fileData->header.numTags * sizeof(md3Tag_t));
-        if (!fileData->tags) {
-            fprintf(stderr, "Memory allocation failed for tags in %s\n", filename);
-            fclose(fp);
-            return 0;
-        }
-        if (!read_from_offset(fp, fileData->header.ofsTags, fileData->tags, fileData->header.numTags * sizeof(md3Tag_t), fileSize)) {
-            fprintf(stderr, "Error reading tags for %s\n", filename);
-            free(fileData->tags);
-            fileData->tags = NULL;
-        }
-    } else {
-        fileData->tags = NULL;
+    if (!write_obj_frame_to_stream(outFile, header, surfaces, numSurfaces, frame, outputName)) {
+        fclose(outFile);
+        return 0;
     }
-    fileData->surfaces = read_md3_surfaces(fp, &fileData->header, &fileData->numSurfaces);
-    fclose(fp);
-    if (!fileData->surfaces) {
+    stats_begin(&clock);
+    long bytes = ftell(outFile);
+    int closed = fclose(outFile) == 0;
+    stats_end(STAT_WRITE, &clock);
+    if (!closed) {
+        fprintf(stderr, "Error closing %s: %s\n", outputName, strerror(errno));
         return 0;
     }
+    stats_add_bytes_written(bytes);
     return 1;
 }
 
-/* Writes a merged OBJ file from multiple MD3 files (only first frame used).
-   For each file, the vertex positions and normals are transformed using the
-   first tag's transformation (if available). */
-int write_merged_obj(md3FileData *files, int numFiles, const char *outputName) {
+/* Writes every animation frame into one OBJ file, each frame as its own
+   "o frame_N" object. The vt block is written once up front and shared by all
+   frames; each frame's faces reuse the same layout with v/vn indices offset by
+   the frame's position in the file. */
+int write_obj_all_frames(const md3Header_t *header, md3SurfaceData *surfaces, int numSurfaces, const char *outputName) {
+    md3Clock clock;
+    stats_begin(&clock);
     FILE *outFile = fopen(outputName, "w");
+    stats_end(STAT_WRITE, &clock);
     if (!outFile) {
         fprintf(stderr, "Error opening output file %s: %s\n", outputName, strerror(errno));
         return 0;
     }
-    fprintf(outFile, "o MergedMD3\n");
-    
-    /* First pass: write vertex positions and compute global base indices */
-    int globalIndex = 1;
-    for (int f = 0; f < numFiles; f++) {
-        md3FileData *mfile = &files[f];
-        for (int s = 0; s < mfile->numSurfaces; s++) {
-            mfile->surfaces[s].baseIndex = globalIndex;
+    const objEmitters_t *emit = select_obj_emitters(g_flipUVs, g_swapYZ);
+    int vertsPerFrame = 0;
+    for (int s = 0; s < numSurfaces; s++) {
+        vertsPerFrame += surfaces[s].header.numVerts;
+    }
+    if (fprintf(outFile, "# %s: %d frames\n", header->name, header->numFrames) < 0 ||
+        (g_mtlLib && fprintf(outFile, "mtllib %s\n", g_mtlLib) < 0) ||
+        !emit->texcoords(outFile, surfaces, numSurfaces, outputName)) {
+        fclose(outFile);
+        return 0;
+    }
+    stats_add_bytes_written(ftell(outFile));
+    for (int frame = 0; frame < header->numFrames; frame++) {
+        long start = ftell(outFile);
+        stats_frame_begin(frame, outputName);
+        if (fprintf(outFile, "o frame_%d\n", frame) < 0) {
+            fprintf(stderr, "Error writing to %s\n", outputName);
+            stats_frame_end();
+            fclose(outFile);
+            return 0;
+        }
+        if (!emit->positions(outFile, surfaces, numSurfaces, frame, outputName) ||
+            !emit->normals(outFile, surfaces, numSurfaces, frame, outputName) ||
+            !emit->faces(outFile, surfaces, numSurfaces, frame * vertsPerFrame, outputName)) {
+            stats_frame_end();
+            fclose(outFile);
+            return 0;
+        }
+        stats_add_geometry(surfaces, numSurfaces);
+        stats_add_bytes_written(ftell(outFile) - start);
+        stats_frame_end();
+    }
+    stats_begin(&clock);
+    int closed = fclose(outFile) == 0;
+    stats_end(STAT_WRITE, &clock);
+    if (!closed) {
+        fprintf(stderr, "Error closing %s: %s\n", outputName, strerror(errno));
+        return 0;
+    }
+    return 1;
+}
+
+/* --- Tar Archive Output --- */
+
+/* All frames can be streamed into a single ustar archive instead of one file
+   per frame. Each entry's 512-byte header is reserved up front, the OBJ text is
+   written straight after it, and the header is patched once the size is known,
+   so the archive is produced with a single open/close and no temporary files. */
+#define TAR_BLOCK_SIZE 512
+
+/* Entry timestamp: SOURCE_DATE_EPOCH if set (reproducible archives), else now */
+unsigned long tar_mtime(void) {
+    const char *epoch = getenv("SOURCE_DATE_EPOCH");
+    if (epoch && *epoch) {
+        return strtoul(epoch, NULL, 10);
+    }
+    return (unsigned long)time(NULL);
+}
+
+/* Reserves space for an entry header; returns the header position in *headerPos
+   (-1 if it could not be determined) */
+int tar_begin_entry(FILE *tar, long *headerPos) {
+    static const char zeros[TAR_BLOCK_SIZE] = {0};
+    *headerPos = ftell(tar);
+    if (*headerPos < 0) {
+        perror("ftell failed");
+        return 0;
+    }
+    if (fwrite(zeros, TAR_BLOCK_SIZE, 1, tar) != 1) {
+        fprintf(stderr, "Error writing tar header: %s\n", strerror(errno));
+        return 0;
+    }
+    return 1;
+}
+
+/* Pads the entry data to a block boundary and fills in its header */
+int tar_end_entry(FILE *tar, long headerPos, const char *entryName) {
+    static const char zeros[TAR_BLOCK_SIZE] = {0};
+    long endPos = ftell(tar);
+    if (endPos < 0) {
+        perror("ftell failed");
+        return 0;
+    }
+    long size = endPos - headerPos - TAR_BLOCK_SIZE;
+    size_t pad = (TAR_BLOCK_SIZE - (size % TAR_BLOCK_SIZE)) % TAR_BLOCK_SIZE;
+    if (pad > 0 && fwrite(zeros, pad, 1, tar) != 1) {
+        fprintf(stderr, "Error writing tar padding: %s\n", strerror(errno));
+        return 0;
+    }
+    if (strlen(entryName) >= 100) {
+        fprintf(stderr, "Tar entry name too long: %s\n", entryName);
+        return 0;
+    }
+    unsigned char header[TAR_BLOCK_SIZE];
+    memset(header, 0, sizeof(header));
+    memcpy(header, entryName, strlen(entryName));                                /* name */
+    snprintf((char*)header + 100, 8, "%07o", 0644);                              /* mode */
+    snprintf((char*)header + 108, 8, "%07o", 0);                                 /* uid */
+    snprintf((char*)header + 116, 8, "%07o", 0);                                 /* gid */
+    snprintf((char*)header + 124, 12, "%011lo", (unsigned long)size);            /* size */
+    snprintf((char*)header + 136, 12, "%011lo", tar_mtime());                    /* mtime */
+    memset(header + 148, ' ', 8);                                                /* chksum placeholder */
+    header[156] = '0';                                                           /* regular file */
+    memcpy(header + 257, "ustar", 6);                                            /* magic */
+    memcpy(header + 263, "00", 2);                                               /* version */
+    unsigned int checksum = 0;
+    for (int i = 0; i < TAR_BLOCK_SIZE; i++) {
+        checksum += header[i];
+    }
+    snprintf((char*)header + 148, 8, "%06o", checksum);
+    header[155] = ' ';
+    if (fseek(tar, headerPos, SEEK_SET) != 0 ||
+        fwrite(header, TAR_BLOCK_SIZE, 1, tar) != 1 ||
+        fseek(tar, 0, SEEK_END) != 0) {
+        fprintf(stderr, "Error writing tar header for %s: %s\n", entryName, strerror(errno));
+        return 0;
+    }
+    return 1;
+}
+
+/* Drops a failed entry and everything after it. Its zeroed header would
+   otherwise read as the end of the archive and hide the entries after it */
+int tar_abort_entry(FILE *tar, long headerPos) {
+    if (fflush(tar) != 0 || ftruncate(fileno(tar), headerPos) != 0 || fseek(tar, headerPos, SEEK_SET) != 0) {
+        fprintf(stderr, "Error truncating tar archive: %s\n", strerror(errno));
+        return 0;
+    }
+    return 1;
+}
+
+/* Writes the two zero blocks that terminate a tar archive */
+int tar_finish(FILE *tar) {
+    static const char zeros[TAR_BLOCK_SIZE * 2] = {0};
+    if (fwrite(zeros, sizeof(zeros), 1, tar) != 1) {
+        fprintf(stderr, "Error finishing tar archive: %s\n", strerror(errno));
+        return 0;
+    }
+    return 1;
+}
+
+/* --- End Tar Archive Output --- */
+
+/* --- Level of Detail (QEM Simplification) --- */
+
+/* Surfaces are simplified with quadric error metrics (Garland & Heckbert)
+   using half-edge collapses: a vertex is always merged into an existing
+   neighbour, so the kept vertices are a subset of the originals. Errors are
+   measured on frame 0, and the resulting index buffer is valid for every
+   frame, so the animation stays intact. Vertices on open edges of the index
+   topology are locked; since MD3 splits vertices along texture seams, this
+   keeps UV seams and mesh borders unchanged. */
+
+typedef struct {
+    double q[10];  /* symmetric 4x4: xx xy xz xw yy yz yw zz zw ww */
+} lodQuadric;
+
+typedef struct {
+    double cost;
+    int from, to;
+    int stampFrom, stampTo;
+} lodCollapse;
+
+typedef struct {
+    int *tris;
+    int count, cap;
+} lodAdjacency;
+
+typedef struct {
+    lodCollapse *items;
+    int count, cap;
+} lodHeap;
+
+void lod_quadric_add_plane(lodQuadric *Q, double a, double b, double c, double d, double w) {
+    double p[4] = { a, b, c, d };
+    int k = 0;
+    for (int i = 0; i < 4; i++) {
+        for (int j = i; j < 4; j++) {
+            Q->q[k++] += w * p[i] * p[j];
+        }
+    }
+}
+
+double lod_quadric_error(const lodQuadric *A, const lodQuadric *B, const float *p) {
+    double q[10];
+    for (int i = 0; i < 10; i++) q[i] = A->q[i] + B->q[i];
+    double x = p[0], y = p[1], z = p[2];
+    return q[0]*x*x + 2*q[1]*x*y + 2*q[2]*x*z + 2*q[3]*x
+         + q[4]*y*y + 2*q[5]*y*z + 2*q[6]*y
+         + q[7]*z*z + 2*q[8]*z
+         + q[9];
+}
+
+int lod_heap_push(lodHeap *h, lodCollapse c) {
+    if (h->count == h->cap) {
+        int cap = h->cap ? h->cap * 2 : 256;
+        lodCollapse *items = (lodCollapse*) realloc(h->items, cap * sizeof(lodCollapse));
+        if (!items) return 0;
+        h->items = items;
+        h->cap = cap;
+    }
+    int i = h->count++;
+    while (i > 0 && h->items[(i - 1) / 2].cost > c.cost) {
+        h->items[i] = h->items[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    h->items[i] = c;
+    return 1;
+}
+
+lodCollapse lod_heap_pop(lodHeap *h) {
+    lodCollapse top = h->items[0];
+    lodCollapse last = h->items[--h->count];
+    int i = 0;
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= h->count) break;
+        if (child + 1 < h->count && h->items[child + 1].cost < h->items[child].cost) child++;
+        if (h->items[child].cost >= last.cost) break;
+        h->items[i] = h->items[child];
+        i = child;
+    }
+    h->items[i] = last;
+    return top;
+}
+
+int lod_adjacency_add(lodAdjacency *adj, int tri) {
+    if (adj->count == adj->cap) {
+        int cap = adj->cap ? adj->cap * 2 : 8;
+        int *tris = (int*) realloc(adj->tris, cap * sizeof(int));
+        if (!tris) return 0;
+        adj->tris = tris;
+        adj->cap = cap;
+    }
+    adj->tris[adj->count++] = tri;
+    return 1;
+}
+
+void lod_triangle_normal(const float *pos, const int *idx, double *n) {
+    const float *a = pos + 3 * idx[0], *b = pos + 3 * idx[1], *c = pos + 3 * idx[2];
+    double e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+    double e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+    n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+    n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+    n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+}
+
+/* Pushes both collapse directions for every live edge around vertex v */
+int lod_push_vertex_edges(int v, int *tris, const unsigned char *triAlive, const lodAdjacency *adj,
+                          const unsigned char *locked, const int *stamp, const lodQuadric *Q,
+                          const float *pos, lodHeap *heap) {
+    for (int i = 0; i < adj[v].count; i++) {
+        int t = adj[v].tris[i];
+        if (!triAlive[t]) continue;
+        for (int k = 0; k < 3; k++) {
+            int w = tris[3 * t + k];
+            if (w == v) continue;
+            lodCollapse c;
+            if (!locked[v]) {
+                c.from = v; c.to = w; c.stampFrom = stamp[v]; c.stampTo = stamp[w];
+                c.cost = lod_quadric_error(&Q[v], &Q[w], pos + 3 * w);
+                if (!lod_heap_push(heap, c)) return 0;
+            }
+            if (!locked[w]) {
+                c.from = w; c.to = v; c.stampFrom = stamp[w]; c.stampTo = stamp[v];
+                c.cost = lod_quadric_error(&Q[w], &Q[v], pos + 3 * v);
+                if (!lod_heap_push(heap, c)) return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+/* Checks that collapsing from -> to keeps the mesh manifold and does not flip
+   or degenerate any of the triangles that move */
+int lod_collapse_is_valid(int from, int to, const int *tris, const unsigned char *triAlive,
+                          const lodAdjacency *adj, const float *pos, int *mark, int markId) {
+    int shared = 0, common = 0;
+    for (int i = 0; i < adj[to].count; i++) {
+        int t = adj[to].tris[i];
+        if (!triAlive[t]) continue;
+        for (int k = 0; k < 3; k++) mark[tris[3 * t + k]] = markId;
+    }
+    for (int i = 0; i < adj[from].count; i++) {
+        int t = adj[from].tris[i];
+        if (!triAlive[t]) continue;
+        int hasTo = 0;
+        for (int k = 0; k < 3; k++) {
+            int w = tris[3 * t + k];
+            if (w == to) hasTo = 1;
+            else if (w != from && mark[w] == markId) {
+                mark[w] = markId - 1;  /* count each common neighbour once */
+                common++;
+            }
+        }
+        if (hasTo) {
+            shared++;
+            continue;
+        }
+        int moved[3];
+        for (int k = 0; k < 3; k++) moved[k] = tris[3 * t + k] == from ? to : tris[3 * t + k];
+        double before[3], after[3];
+        lod_triangle_normal(pos, &tris[3 * t], before);
+        lod_triangle_normal(pos, moved, after);
+        double dot = before[0] * after[0] + before[1] * after[1] + before[2] * after[2];
+        double lenAfter = sqrt(after[0] * after[0] + after[1] * after[1] + after[2] * after[2]);
+        if (dot <= 0.0 || lenAfter < 1e-12) return 0;
+    }
+    /* An interior edge has exactly two neighbours in common (the opposite
+       vertices of its two triangles); more would pinch the surface */
+    return shared > 0 && common <= shared;
+}
+
+/* Simplifies one surface to about targetTris triangles. dst receives newly
+   allocated triangles, texcoords and all frames of the kept vertices. */
+int simplify_surface(const md3SurfaceData *src, int targetTris, md3SurfaceData *dst) {
+    int numVerts = src->header.numVerts;
+    int numTris = src->header.numTriangles;
+    int ok = 0;
+    memset(dst, 0, sizeof(*dst));
+    dst->header = src->header;
+
+    float *pos = (float*) malloc((size_t)(numVerts > 0 ? numVerts : 1) * 3 * sizeof(float));
+    int *tris = (int*) malloc((size_t)(numTris > 0 ? numTris : 1) * 3 * sizeof(int));
+    unsigned char *triAlive = (unsigned char*) calloc(numTris > 0 ? numTris : 1, 1);
+    unsigned char *locked = (unsigned char*) calloc(numVerts > 0 ? numVerts : 1, 1);
+    unsigned char *vertAlive = (unsigned char*) calloc(numVerts > 0 ? numVerts : 1, 1);
+    int *stamp = (int*) calloc(numVerts > 0 ? numVerts : 1, sizeof(int));
+    int *mark = (int*) calloc(numVerts > 0 ? numVerts : 1, sizeof(int));
+    int *remap = (int*) malloc((size_t)(numVerts > 0 ? numVerts : 1) * sizeof(int));
+    lodQuadric *Q = (lodQuadric*) calloc(numVerts > 0 ? numVerts : 1, sizeof(lodQuadric));
+    lodAdjacency *adj = (lodAdjacency*) calloc(numVerts > 0 ? numVerts : 1, sizeof(lodAdjacency));
+    lodHeap heap = { NULL, 0, 0 };
+    if (!pos || !tris || !triAlive || !locked || !vertAlive || !stamp || !mark || !remap || !Q || !adj) {
+        fprintf(stderr, "Memory allocation failed for LOD of surface %s.\n", src->header.name);
+        goto done;
+    }
+    for (int v = 0; v < numVerts; v++) {
+        for (int k = 0; k < 3; k++) pos[3 * v + k] = src->vertices[v].xyz[k] * MD3_XYZ_SCALE;
+        vertAlive[v] = 1;
+    }
+    int liveTris = 0;
+    for (int t = 0; t < numTris; t++) {
+        const int *idx = src->triangles[t].indexes;
+        int degenerate = idx[0] == idx[1] || idx[1] == idx[2] || idx[0] == idx[2];
+        for (int k = 0; k < 3; k++) {
+            if (idx[k] < 0 || idx[k] >= numVerts) degenerate = 1;
+        }
+        for (int k = 0; k < 3; k++) tris[3 * t + k] = degenerate ? 0 : idx[k];
+        if (degenerate) continue;
+        triAlive[t] = 1;
+        liveTris++;
+        double n[3];
+        lod_triangle_normal(pos, idx, n);
+        double len = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        for (int k = 0; k < 3; k++) {
+            if (!lod_adjacency_add(&adj[idx[k]], t)) {
+                fprintf(stderr, "Memory allocation failed for LOD of surface %s.\n", src->header.name);
+                goto done;
+            }
+        }
+        if (len < 1e-12) continue;
+        const float *p0 = pos + 3 * idx[0];
+        double a = n[0] / len, b = n[1] / len, c = n[2] / len;
+        double d = -(a * p0[0] + b * p0[1] + c * p0[2]);
+        for (int k = 0; k < 3; k++) lod_quadric_add_plane(&Q[idx[k]], a, b, c, d, len * 0.5);
+    }
+    /* Lock vertices on open edges: an edge (a,b) is open when only one
+       triangle uses it. Count edge uses per vertex pair via the adjacency. */
+    for (int v = 0; v < numVerts; v++) {
+        for (int i = 0; i < adj[v].count && !locked[v]; i++) {
+            int t = adj[v].tris[i];
+            for (int k = 0; k < 3; k++) {
+                int w = tris[3 * t + k];
+                if (w == v) continue;
+                int uses = 0;
+                for (int j = 0; j < adj[v].count; j++) {
+                    const int *o = &tris[3 * adj[v].tris[j]];
+                    if (o[0] == w || o[1] == w || o[2] == w) uses++;
+                }
+                if (uses < 2) {
+                    locked[v] = 1;
+                    locked[w] = 1;
+                }
+            }
+        }
+    }
+    for (int v = 0; v < numVerts; v++) {
+        if (!lod_push_vertex_edges(v, tris, triAlive, adj, locked, stamp, Q, pos, &heap)) {
+            fprintf(stderr, "Memory allocation failed for LOD of surface %s.\n", src->header.name);
+            goto done;
+        }
+    }
+    int markId = 2;
+    while (liveTris > targetTris && heap.count > 0) {
+        lodCollapse c = lod_heap_pop(&heap);
+        if (!vertAlive[c.from] || !vertAlive[c.to] ||
+            stamp[c.from] != c.stampFrom || stamp[c.to] != c.stampTo) {
+            continue;
+        }
+        markId += 2;
+        if (!lod_collapse_is_valid(c.from, c.to, tris, triAlive, adj, pos, mark, markId)) {
+            continue;
+        }
+        for (int i = 0; i < adj[c.from].count; i++) {
+            int t = adj[c.from].tris[i];
+            if (!triAlive[t]) continue;
+            int *idx = &tris[3 * t];
+            if (idx[0] == c.to || idx[1] == c.to || idx[2] == c.to) {
+                triAlive[t] = 0;
+                liveTris--;
+                continue;
+            }
+            for (int k = 0; k < 3; k++) {
+                if (idx[k] == c.from) idx[k] = c.to;
+            }
+            if (!lod_adjacency_add(&adj[c.to], t)) {
+                fprintf(stderr, "Memory allocation failed for LOD of surface %s.\n", src->header.name);
+                goto done;
+            }
+        }
+        for (int i = 0; i < 10; i++) Q[c.to].q[i] += Q[c.from].q[i];
+        vertAlive[c.from] = 0;
+        stamp[c.to]++;
+        if (!lod_push_vertex_edges(c.to, tris, triAlive, adj, locked, stamp, Q, pos, &heap)) {
+            fprintf(stderr, "Memory allocation failed for LOD of surface %s.\n", src->header.name);
+            goto done;
+        }
+    }
+
+    /* Compact: keep referenced vertices in their original order */
+    int keptVerts = 0;
+    for (int v = 0; v < numVerts; v++) remap[v] = -1;
+    for (int t = 0; t < numTris; t++) {
+        if (!triAlive[t]) continue;
+        for (int k = 0; k < 3; k++) remap[tris[3 * t + k]] = 1;
+    }
+    for (int v = 0; v < numVerts; v++) {
+        if (remap[v] >= 0) remap[v] = keptVerts++;
+    }
+    int numFrames = src->header.numFrames;
+    dst->header.numVerts = keptVerts;
+    dst->header.numTriangles = liveTris;
+    dst->triangles = (md3Triangle_t*) malloc((size_t)(liveTris > 0 ? liveTris : 1) * sizeof(md3Triangle_t));
+    dst->texCoords = (md3TexCoord_t*) malloc((size_t)(keptVerts > 0 ? keptVerts : 1) * sizeof(md3TexCoord_t));
+    dst->vertices = (md3Vertex_t*) malloc((size_t)(keptVerts > 0 ? keptVerts : 1) * numFrames * sizeof(md3Vertex_t));
+    if (!dst->triangles || !dst->texCoords || !dst->vertices) {
+        fprintf(stderr, "Memory allocation failed for LOD of surface %s.\n", src->header.name);
+        goto done;
+    }
+    int outTri = 0;
+    for (int t = 0; t < numTris; t++) {
+        if (!triAlive[t]) continue;
+        for (int k = 0; k < 3; k++) dst->triangles[outTri].indexes[k] = remap[tris[3 * t + k]];
+        outTri++;
+    }
+    for (int v = 0; v < numVerts; v++) {
+        if (remap[v] < 0) continue;
+        dst->texCoords[remap[v]] = src->texCoords[v];
+        for (int f = 0; f < numFrames; f++) {
+            dst->vertices[(size_t)f * keptVerts + remap[v]] = src->vertices[(size_t)f * numVerts + v];
+        }
+    }
+    ok = 1;
+
+done:
+    if (adj) {
+        for (int v = 0; v < numVerts; v++) free(adj[v].tris);
+    }
+    free(adj);
+    free(Q);
+    free(remap);
+    free(mark);
+    free(stamp);
+    free(vertAlive);
+    free(locked);
+    free(triAlive);
+    free(tris);
+    free(pos);
+    free(heap.items);
+    if (!ok) {
+        free(dst->triangles);
+        free(dst->texCoords);
+        free(dst->vertices);
+        memset(dst, 0, sizeof(*dst));
+    }
+    return ok;
+}
+
+/* Builds a simplified copy of every surface, keeping about ratio of each
+   surface's triangles. Returns NULL on failure. */
+md3SurfaceData *build_lod_surfaces(md3SurfaceData *surfaces, int numSurfaces, double ratio) {
+    md3SurfaceData *lod = (md3SurfaceData*) calloc(numSurfaces > 0 ? numSurfaces : 1, sizeof(md3SurfaceData));
+    if (!lod) {
+        fprintf(stderr, "Memory allocation failed for LOD surfaces.\n");
+        return NULL;
+    }
+    for (int s = 0; s < numSurfaces; s++) {
+        int target = (int)(surfaces[s].header.numTriangles * ratio + 0.5);
+        if (target < 1) target = 1;
+        if (!simplify_surface(&surfaces[s], target, &lod[s])) {
+            free_surfaces(lod, s);
+            return NULL;
+        }
+        memcpy(lod[s].material, surfaces[s].material, sizeof(lod[s].material));
+        printf("LOD %.3f: %s %d -> %d triangles, %d -> %d vertices\n", ratio, surfaces[s].header.name,
+               surfaces[s].header.numTriangles, lod[s].header.numTriangles,
+               surfaces[s].header.numVerts, lod[s].header.numVerts);
+    }
+    return lod;
+}
+
+/* --- End Level of Detail --- */
+
+/* --- Vertex Cache Optimization (-optimizeCache) --- */
+
+/* Triangles are reordered with Tom Forsyth's linear-speed vertex cache
+   optimization, then sorted in clusters to reduce overdraw (see
+   order_surface_overdraw), then vertices are renumbered in order of first
+   use so the vertex fetch walks memory sequentially. The vertex permutation
+   is applied to the texture coordinates and every frame alike. */
+
+#define VCACHE_SIZE 32
+#define VCACHE_FIFO_SIZE 16
+/* Largest ACMR increase the overdraw pass may cost, as a factor */
+#define OVERDRAW_THRESHOLD 1.05f
+
+/* Average cache miss ratio (misses per triangle) for a FIFO cache, a common
+   model of the post-transform cache on GPUs */
+double surface_acmr(const md3SurfaceData *surface) {
+    int numTris = surface->header.numTriangles;
+    if (numTris <= 0) return 0.0;
+    int fifo[VCACHE_FIFO_SIZE];
+    int head = 0, misses = 0;
+    for (int i = 0; i < VCACHE_FIFO_SIZE; i++) fifo[i] = -1;
+    for (int t = 0; t < numTris; t++) {
+        for (int k = 0; k < 3; k++) {
+            int v = surface->triangles[t].indexes[k];
+            int hit = 0;
+            for (int i = 0; i < VCACHE_FIFO_SIZE; i++) {
+                if (fifo[i] == v) {
+                    hit = 1;
+                    break;
+                }
+            }
+            if (!hit) {
+                fifo[head] = v;
+                head = (head + 1) % VCACHE_FIFO_SIZE;
+                misses++;
+            }
+        }
+    }
+    return (double) misses / numTris;
+}
+
+float vcache_vertex_score(int cachePos, int remainingTris) {
+    if (remainingTris <= 0) return -1.0f;
+    float score = 0.0f;
+    if (cachePos >= 0) {
+        if (cachePos < 3) {
+            /* The last triangle's vertices get a fixed score so the next
+               triangle does not simply reuse the same edge */
+            score = 0.75f;
+        } else {
+            score = powf(1.0f - (float)(cachePos - 3) / (VCACHE_SIZE - 3), 1.5f);
+        }
+    }
+    /* Boost vertices with few triangles left so they get finished off */
+    return score + 2.0f * powf((float) remainingTris, -0.5f);
+}
+
+/* Feeds one triangle through a FIFO cache kept as per-vertex timestamps;
+   returns its misses. Adding VCACHE_FIFO_SIZE + 1 to *timestamp empties it */
+int vcache_fifo_update(const int *idx, int *stamps, int *timestamp) {
+    int misses = 0;
+    for (int k = 0; k < 3; k++) {
+        if (*timestamp - stamps[idx[k]] > VCACHE_FIFO_SIZE) {
+            stamps[idx[k]] = (*timestamp)++;
+            misses++;
+        }
+    }
+    return misses;
+}
+
+typedef struct {
+    float key;
+    int cluster;
+} overdrawCluster;
+
+int compare_overdraw_clusters(const void *a, const void *b) {
+    const overdrawCluster *ca = (const overdrawCluster*) a, *cb = (const overdrawCluster*) b;
+    if (ca->key != cb->key) return ca->key > cb->key ? -1 : 1;
+    return ca->cluster - cb->cluster;
+}
+
+/* Sorts cache-ordered triangles to reduce overdraw without knowing the view
+   (meshoptimizer's approach, on frame 0). The order is cut into clusters
+   where the FIFO cache misses a whole triangle anyway, and again wherever a
+   cluster's running miss ratio gets within OVERDRAW_THRESHOLD of its
+   stretch's ratio, so regrouping costs at most that factor in ACMR.
+   Clusters whose area-weighted normal points away from the surface's
+   centroid come first since they tend to occlude the rest. */
+int order_surface_overdraw(const md3SurfaceData *surface, md3Triangle_t *tris, int numTris) {
+    int numVerts = surface->header.numVerts;
+    int ok = 0;
+    int *stamps = (int*) calloc(numVerts, sizeof(int));
+    int *hard = (int*) malloc(((size_t) numTris + 1) * sizeof(int));
+    int *soft = (int*) malloc(((size_t) numTris + 1) * sizeof(int));
+    overdrawCluster *clusters = (overdrawCluster*) malloc((size_t) numTris * sizeof(overdrawCluster));
+    md3Triangle_t *sorted = (md3Triangle_t*) malloc((size_t) numTris * sizeof(md3Triangle_t));
+    if (!stamps || !hard || !soft || !clusters || !sorted) {
+        fprintf(stderr, "Memory allocation failed for overdraw ordering of surface %s.\n", surface->header.name);
+        goto done;
+    }
+
+    int timestamp = VCACHE_FIFO_SIZE + 1;
+    int numHard = 0;
+    for (int t = 0; t < numTris; t++) {
+        if (vcache_fifo_update(tris[t].indexes, stamps, &timestamp) == 3 || t == 0) hard[numHard++] = t;
+    }
+    hard[numHard] = numTris;
+
+    int numSoft = 0;
+    for (int c = 0; c < numHard; c++) {
+        int start = hard[c], end = hard[c + 1];
+        int misses = 0;
+        timestamp += VCACHE_FIFO_SIZE + 1;
+        for (int t = start; t < end; t++) misses += vcache_fifo_update(tris[t].indexes, stamps, &timestamp);
+        float limit = OVERDRAW_THRESHOLD * misses / (end - start);
+        soft[numSoft++] = start;
+        int runMisses = 0, runTris = 0;
+        timestamp += VCACHE_FIFO_SIZE + 1;
+        for (int t = start; t < end; t++) {
+            runMisses += vcache_fifo_update(tris[t].indexes, stamps, &timestamp);
+            runTris++;
+            if ((float) runMisses / runTris <= limit) {
+                soft[numSoft++] = t + 1;
+                timestamp += VCACHE_FIFO_SIZE + 1;
+                runMisses = 0;
+                runTris = 0;
+            }
+        }
+        /* The tail after the last cut never reached the target (or is
+           empty); fold it into the cluster before it */
+        if (soft[numSoft - 1] != start) numSoft--;
+    }
+    soft[numSoft] = numTris;
+
+    /* Centroid of the surface's frame 0 corners */
+    const md3Vertex_t *verts = surface->vertices;
+    double centroid[3] = { 0.0, 0.0, 0.0 };
+    for (int t = 0; t < numTris; t++) {
+        for (int k = 0; k < 3; k++) {
+            for (int i = 0; i < 3; i++) centroid[i] += verts[tris[t].indexes[k]].xyz[i];
+        }
+    }
+    for (int i = 0; i < 3; i++) centroid[i] /= 3.0 * numTris;
+
+    for (int c = 0; c < numSoft; c++) {
+        float center[3] = { 0.0f, 0.0f, 0.0f }, normal[3] = { 0.0f, 0.0f, 0.0f };
+        float area = 0.0f;
+        for (int t = soft[c]; t < soft[c + 1]; t++) {
+            const short *a = verts[tris[t].indexes[0]].xyz;
+            const short *b = verts[tris[t].indexes[1]].xyz;
+            const short *cc = verts[tris[t].indexes[2]].xyz;
+            /* MD3 winding is clockwise */
+            float e1[3] = { (float)(cc[0] - a[0]), (float)(cc[1] - a[1]), (float)(cc[2] - a[2]) };
+            float e2[3] = { (float)(b[0] - a[0]), (float)(b[1] - a[1]), (float)(b[2] - a[2]) };
+            float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+            float w = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            for (int i = 0; i < 3; i++) {
+                center[i] += w * (a[i] + b[i] + cc[i]) / 3.0f;
+                normal[i] += n[i];
+            }
+            area += w;
+        }
+        float len = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        clusters[c].cluster = c;
+        clusters[c].key = 0.0f;
+        if (area > 0.0f && len > 0.0f) {
+            for (int i = 0; i < 3; i++) {
+                clusters[c].key += (center[i] / area - (float) centroid[i]) * normal[i] / len;
+            }
+        }
+    }
+    qsort(clusters, numSoft, sizeof(overdrawCluster), compare_overdraw_clusters);
+    int out = 0;
+    for (int c = 0; c < numSoft; c++) {
+        int first = soft[clusters[c].cluster], count = soft[clusters[c].cluster + 1] - first;
+        memcpy(sorted + out, tris + first, (size_t) count * sizeof(md3Triangle_t));
+        out += count;
+    }
+    memcpy(tris, sorted, (size_t) numTris * sizeof(md3Triangle_t));
+    ok = 1;
+
+done:
+    free(stamps);
+    free(hard);
+    free(soft);
+    free(clusters);
+    free(sorted);
+    return ok;
+}
+
+/* Reorders one surface's triangles and vertices in place */
+int optimize_surface_cache(md3SurfaceData *surface) {
+    int numVerts = surface->header.numVerts;
+    int numTris = surface->header.numTriangles;
+    int numFrames = surface->header.numFrames;
+    if (numVerts <= 0 || numTris <= 0) return 1;
+    int ok = 0;
+    int *remaining = (int*) calloc(numVerts, sizeof(int));
+    int *adjStart = (int*) calloc(numVerts + 1, sizeof(int));
+    int *adjTris = (int*) malloc((size_t) numTris * 3 * sizeof(int));
+    int *cachePos = (int*) malloc(numVerts * sizeof(int));
+    float *vertScore = (float*) malloc(numVerts * sizeof(float));
+    float *triScore = (float*) malloc(numTris * sizeof(float));
+    unsigned char *emitted = (unsigned char*) calloc(numTris, 1);
+    md3Triangle_t *newTris = (md3Triangle_t*) malloc(numTris * sizeof(md3Triangle_t));
+    int *remap = (int*) malloc(numVerts * sizeof(int));
+    md3TexCoord_t *newTexCoords = (md3TexCoord_t*) malloc(numVerts * sizeof(md3TexCoord_t));
+    md3Vertex_t *newVertices = (md3Vertex_t*) malloc((size_t) numVerts * numFrames * sizeof(md3Vertex_t));
+    if (!remaining || !adjStart || !adjTris || !cachePos || !vertScore || !triScore ||
+        !emitted || !newTris || !remap || !newTexCoords || !newVertices) {
+        fprintf(stderr, "Memory allocation failed for cache optimization of surface %s.\n", surface->header.name);
+        goto done;
+    }
+    for (int t = 0; t < numTris; t++) {
+        for (int k = 0; k < 3; k++) {
+            int v = surface->triangles[t].indexes[k];
+            if (v < 0 || v >= numVerts) {
+                fprintf(stderr, "Surface %s has an out-of-range vertex index.\n", surface->header.name);
+                goto done;
+            }
+            remaining[v]++;
+        }
+    }
+    /* Triangle lists per vertex, stored contiguously (CSR) */
+    for (int v = 0; v < numVerts; v++) adjStart[v + 1] = adjStart[v] + remaining[v];
+    for (int v = 0; v < numVerts; v++) cachePos[v] = adjStart[v];
+    for (int t = 0; t < numTris; t++) {
+        for (int k = 0; k < 3; k++) {
+            int v = surface->triangles[t].indexes[k];
+            adjTris[cachePos[v]++] = t;
+        }
+    }
+    for (int v = 0; v < numVerts; v++) {
+        cachePos[v] = -1;
+        vertScore[v] = vcache_vertex_score(-1, remaining[v]);
+    }
+    for (int t = 0; t < numTris; t++) {
+        const int *idx = surface->triangles[t].indexes;
+        triScore[t] = vertScore[idx[0]] + vertScore[idx[1]] + vertScore[idx[2]];
+    }
+
+    int cache[VCACHE_SIZE + 3];
+    int cacheCount = 0;
+    int nextTri = -1;
+    int scanFrom = 0;
+    for (int out = 0; out < numTris; out++) {
+        if (nextTri < 0) {
+            /* No candidate next to the cache: take the best remaining triangle,
+               scanning forward since emitted ones never come back */
+            float best = -1.0f;
+            while (scanFrom < numTris && emitted[scanFrom]) scanFrom++;
+            for (int t = scanFrom; t < numTris; t++) {
+                if (!emitted[t] && triScore[t] > best) {
+                    best = triScore[t];
+                    nextTri = t;
+                }
+            }
+        }
+        int t = nextTri;
+        const int *idx = surface->triangles[t].indexes;
+        newTris[out] = surface->triangles[t];
+        emitted[t] = 1;
+
+        /* Detach the triangle from its vertices */
+        for (int k = 0; k < 3; k++) {
+            int v = idx[k];
+            int *list = adjTris + adjStart[v];
+            for (int i = 0; i < remaining[v]; i++) {
+                if (list[i] == t) {
+                    list[i] = list[remaining[v] - 1];
+                    break;
+                }
+            }
+            remaining[v]--;
+        }
+        /* Move its vertices to the front of the LRU cache */
+        int newCache[VCACHE_SIZE + 3];
+        int newCount = 0;
+        for (int k = 0; k < 3; k++) newCache[newCount++] = idx[k];
+        for (int i = 0; i < cacheCount; i++) {
+            int v = cache[i];
+            if (v != idx[0] && v != idx[1] && v != idx[2]) newCache[newCount++] = v;
+        }
+        for (int i = VCACHE_SIZE; i < newCount; i++) cachePos[newCache[i]] = -1;
+        cacheCount = newCount < VCACHE_SIZE ? newCount : VCACHE_SIZE;
+        memcpy(cache, newCache, cacheCount * sizeof(int));
+
+        /* Rescore the cached vertices and their triangles; the evicted ones
+           only lose score, so leaving them stale just delays them */
+        for (int i = 0; i < cacheCount; i++) {
+            cachePos[cache[i]] = i;
+        }
+        for (int i = VCACHE_SIZE; i < newCount; i++) {
+            int v = newCache[i];
+            vertScore[v] = vcache_vertex_score(-1, remaining[v]);
+            for (int j = 0; j < remaining[v]; j++) {
+                int u = adjTris[adjStart[v] + j];
+                const int *ui = surface->triangles[u].indexes;
+                triScore[u] = vertScore[ui[0]] + vertScore[ui[1]] + vertScore[ui[2]];
+            }
+        }
+        for (int i = 0; i < cacheCount; i++) {
+            int v = cache[i];
+            vertScore[v] = vcache_vertex_score(i, remaining[v]);
+        }
+        nextTri = -1;
+        float best = -1.0f;
+        for (int i = 0; i < cacheCount; i++) {
+            int v = cache[i];
+            for (int j = 0; j < remaining[v]; j++) {
+                int u = adjTris[adjStart[v] + j];
+                const int *ui = surface->triangles[u].indexes;
+                triScore[u] = vertScore[ui[0]] + vertScore[ui[1]] + vertScore[ui[2]];
+                if (triScore[u] > best) {
+                    best = triScore[u];
+                    nextTri = u;
+                }
+            }
+        }
+    }
+
+    if (!order_surface_overdraw(surface, newTris, numTris)) goto done;
+
+    /* Renumber vertices in order of first use; unreferenced ones go last */
+    int nextVert = 0;
+    for (int v = 0; v < numVerts; v++) remap[v] = -1;
+    for (int t = 0; t < numTris; t++) {
+        for (int k = 0; k < 3; k++) {
+            int v = newTris[t].indexes[k];
+            if (remap[v] < 0) remap[v] = nextVert++;
+            newTris[t].indexes[k] = remap[v];
+        }
+    }
+    for (int v = 0; v < numVerts; v++) {
+        if (remap[v] < 0) remap[v] = nextVert++;
+    }
+    for (int v = 0; v < numVerts; v++) {
+        newTexCoords[remap[v]] = surface->texCoords[v];
+        for (int f = 0; f < numFrames; f++) {
+            newVertices[(size_t) f * numVerts + remap[v]] = surface->vertices[(size_t) f * numVerts + v];
+        }
+    }
+    memcpy(surface->triangles, newTris, numTris * sizeof(md3Triangle_t));
+    memcpy(surface->texCoords, newTexCoords, numVerts * sizeof(md3TexCoord_t));
+    memcpy(surface->vertices, newVertices, (size_t) numVerts * numFrames * sizeof(md3Vertex_t));
+    ok = 1;
+
+done:
+    free(remaining);
+    free(adjStart);
+    free(adjTris);
+    free(cachePos);
+    free(vertScore);
+    free(triScore);
+    free(emitted);
+    free(newTris);
+    free(remap);
+    free(newTexCoords);
+    free(newVertices);
+    return ok;
+}
+
+/* Optimizes every surface and reports the cache miss ratio before and after */
+int optimize_surfaces_cache(md3SurfaceData *surfaces, int numSurfaces) {
+    for (int s = 0; s < numSurfaces; s++) {
+        double before = surface_acmr(&surfaces[s]);
+        if (!optimize_surface_cache(&surfaces[s])) {
+            return 0;
+        }
+        printf("Cache optimized %s: ACMR %.3f -> %.3f\n", surfaces[s].header.name, before, surface_acmr(&surfaces[s]));
+    }
+    return 1;
+}
+
+/* --- End Vertex Cache Optimization --- */
+
+/* --- Meshlet Sidecar (-meshlets) --- */
+
+/* Surfaces are split into meshlets of at most MESHLET_MAX_VERTS vertices and
+   MESHLET_MAX_TRIS triangles by walking the triangles in order (run
+   -optimizeCache first for tighter clusters). Cluster topology is the same
+   for every frame; bounding spheres and normal cones are stored per frame.
+
+   Sidecar layout (little-endian, 4-byte aligned):
+     meshletFileHeader_t
+     per surface:
+       meshletSurfaceHeader_t
+       meshletDesc_t     [numMeshlets]
+       int               [numMeshletVerts]   surface-local vertex indices
+       unsigned char     [numMeshletTris*3]  meshlet-local indices, OBJ winding,
+                                             zero-padded to a multiple of 4
+       meshletBounds_t   [numFrames][numMeshlets]
+   Coordinates match the exported OBJ (after -swapYZ). A cluster is
+   backfacing for view direction d when dot(d, coneAxis) >= coneCutoff
+   holds for all d from the camera to the sphere; coneCutoff is the sine of
+   the largest angle between a face normal and the axis (0 for a flat
+   cluster) and is 1 (never cull) when the normals spread too far to bound. */
+
+#define MESHLET_MAX_VERTS 64
+#define MESHLET_MAX_TRIS 124
+
+#pragma pack(push, 1)
+typedef struct {
+    char id[4];           // "MD3M"
+    int version;          // 1
+    int numSurfaces;
+    int numFrames;
+    int maxVerts;
+    int maxTris;
+} meshletFileHeader_t;
+
+typedef struct {
+    char name[64];
+    int firstVertex;      // 0-based offset of the surface in the OBJ vertex list
+    int numMeshlets;
+    int numMeshletVerts;
+    int numMeshletTris;
+} meshletSurfaceHeader_t;
+
+typedef struct {
+    int vertexOffset;
+    int vertexCount;
+    int triangleOffset;
+    int triangleCount;
+} meshletDesc_t;
+
+typedef struct {
+    float center[3];
+    float radius;
+    float coneAxis[3];
+    float coneCutoff;
+} meshletBounds_t;
+#pragma pack(pop)
+
+typedef struct {
+    meshletDesc_t *meshlets;
+    int *vertices;
+    unsigned char *triangles;
+    int numMeshlets, numVerts, numTris;
+} meshletSet;
+
+/* Greedily packs a surface's triangles into meshlets */
+int build_meshlets(const md3SurfaceData *surface, const int swapYZ, meshletSet *out) {
+    int numVerts = surface->header.numVerts;
+    int numTris = surface->header.numTriangles;
+    memset(out, 0, sizeof(*out));
+    int *local = (int*) malloc((size_t)(numVerts > 0 ? numVerts : 1) * sizeof(int));
+    /* Worst case is one meshlet per triangle, each with its own 3 vertices */
+    out->meshlets = (meshletDesc_t*) malloc((size_t)(numTris > 0 ? numTris : 1) * sizeof(meshletDesc_t));
+    out->vertices = (int*) malloc((size_t)(numTris > 0 ? numTris : 1) * 3 * sizeof(int));
+    out->triangles = (unsigned char*) malloc((size_t)(numTris > 0 ? numTris : 1) * 3 + 4);
+    if (!local || !out->meshlets || !out->vertices || !out->triangles) {
+        fprintf(stderr, "Memory allocation failed for meshlets of surface %s.\n", surface->header.name);
+        free(local);
+        free(out->meshlets);
+        free(out->vertices);
+        free(out->triangles);
+        memset(out, 0, sizeof(*out));
+        return 0;
+    }
+    for (int v = 0; v < numVerts; v++) local[v] = -1;
+    meshletDesc_t current = { 0, 0, 0, 0 };
+    for (int t = 0; t < numTris; t++) {
+        const int *idx = surface->triangles[t].indexes;
+        int order[3];
+        if (swapYZ) {
+            order[0] = idx[0]; order[1] = idx[1]; order[2] = idx[2];
+        } else {
+            order[0] = idx[2]; order[1] = idx[1]; order[2] = idx[0];
+        }
+        if (order[0] < 0 || order[0] >= numVerts || order[1] < 0 || order[1] >= numVerts ||
+            order[2] < 0 || order[2] >= numVerts) {
+            continue;
+        }
+        int newVerts = 0;
+        for (int k = 0; k < 3; k++) {
+            int v = order[k];
+            if (local[v] < 0 && (k < 1 || order[0] != v) && (k < 2 || order[1] != v)) newVerts++;
+        }
+        if (current.vertexCount + newVerts > MESHLET_MAX_VERTS || current.triangleCount == MESHLET_MAX_TRIS) {
+            for (int i = 0; i < current.vertexCount; i++) local[out->vertices[current.vertexOffset + i]] = -1;
+            out->meshlets[out->numMeshlets++] = current;
+            current.vertexOffset = out->numVerts;
+            current.triangleOffset = out->numTris;
+            current.vertexCount = 0;
+            current.triangleCount = 0;
+        }
+        for (int k = 0; k < 3; k++) {
+            int v = order[k];
+            if (local[v] < 0) {
+                local[v] = current.vertexCount++;
+                out->vertices[out->numVerts++] = v;
+            }
+            out->triangles[out->numTris * 3 + k] = (unsigned char) local[v];
+        }
+        out->numTris++;
+        current.triangleCount++;
+    }
+    if (current.triangleCount > 0) {
+        out->meshlets[out->numMeshlets++] = current;
+    }
+    free(local);
+    return 1;
+}
+
+/* Computes a meshlet's bounding sphere (Ritter) and normal cone from
+   decoded positions of one frame */
+void compute_meshlet_bounds(const meshletSet *set, const meshletDesc_t *m, const float *x, const float *y, const float *z, meshletBounds_t *b) {
+    const int *verts = set->vertices + m->vertexOffset;
+    float c[3] = { x[verts[0]], y[verts[0]], z[verts[0]] };
+    /* Ritter: start from the two far-apart points, then grow to fit */
+    int far1 = verts[0], far2 = verts[0];
+    float best = -1.0f;
+    for (int i = 0; i < m->vertexCount; i++) {
+        int v = verts[i];
+        float dx = x[v] - c[0], dy = y[v] - c[1], dz = z[v] - c[2];
+        float d = dx * dx + dy * dy + dz * dz;
+        if (d > best) { best = d; far1 = v; }
+    }
+    best = -1.0f;
+    for (int i = 0; i < m->vertexCount; i++) {
+        int v = verts[i];
+        float dx = x[v] - x[far1], dy = y[v] - y[far1], dz = z[v] - z[far1];
+        float d = dx * dx + dy * dy + dz * dz;
+        if (d > best) { best = d; far2 = v; }
+    }
+    c[0] = (x[far1] + x[far2]) * 0.5f;
+    c[1] = (y[far1] + y[far2]) * 0.5f;
+    c[2] = (z[far1] + z[far2]) * 0.5f;
+    float r = sqrtf(best) * 0.5f;
+    for (int i = 0; i < m->vertexCount; i++) {
+        int v = verts[i];
+        float dx = x[v] - c[0], dy = y[v] - c[1], dz = z[v] - c[2];
+        float d = sqrtf(dx * dx + dy * dy + dz * dz);
+        if (d > r) {
+            float grow = (d - r) * 0.5f;
+            r += grow;
+            float k = grow / d;
+            c[0] += dx * k;
+            c[1] += dy * k;
+            c[2] += dz * k;
+        }
+    }
+    b->center[0] = c[0];
+    b->center[1] = c[1];
+    b->center[2] = c[2];
+    b->radius = r;
+
+    /* Normal cone from unit face normals */
+    const unsigned char *tris = set->triangles + (size_t) m->triangleOffset * 3;
+    float axis[3] = { 0.0f, 0.0f, 0.0f };
+    for (int pass = 0; pass < 2; pass++) {
+        float cutoff = 1.0f;
+        for (int t = 0; t < m->triangleCount; t++) {
+            int a = verts[tris[t * 3]], bb = verts[tris[t * 3 + 1]], cc = verts[tris[t * 3 + 2]];
+            float e1[3] = { x[bb] - x[a], y[bb] - y[a], z[bb] - z[a] };
+            float e2[3] = { x[cc] - x[a], y[cc] - y[a], z[cc] - z[a] };
+            float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+            float len = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            if (len <= 0.0f) continue;
+            if (pass == 0) {
+                axis[0] += n[0] / len;
+                axis[1] += n[1] / len;
+                axis[2] += n[2] / len;
+            } else {
+                float d = (axis[0] * n[0] + axis[1] * n[1] + axis[2] * n[2]) / len;
+                if (d < cutoff) cutoff = d;
+            }
+        }
+        if (pass == 0) {
+            float len = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+            if (len <= 0.0f) {
+                break;
+            }
+            axis[0] /= len;
+            axis[1] /= len;
+            axis[2] /= len;
+        } else {
+            b->coneAxis[0] = axis[0];
+            b->coneAxis[1] = axis[1];
+            b->coneAxis[2] = axis[2];
+            /* cutoff is the cosine of the spread; all faces point away once d
+               is within 90 degrees minus the spread of the axis. Normals
+               spread past 90 degrees cannot all face away together */
+            b->coneCutoff = cutoff > 0.0f ? sqrtf(1.0f - cutoff * cutoff) : 1.0f;
+            return;
+        }
+    }
+    b->coneAxis[0] = 0.0f;
+    b->coneAxis[1] = 0.0f;
+    b->coneAxis[2] = 1.0f;
+    b->coneCutoff = 1.0f;
+}
+
+int write_meshlets_surface(FILE *fp, const md3SurfaceData *surface, int firstVertex, int numFrames, float *xyz, int maxVerts) {
+    meshletSet set;
+    if (!build_meshlets(surface, g_swapYZ, &set)) {
+        return 0;
+    }
+    meshletSurfaceHeader_t sh;
+    memset(&sh, 0, sizeof(sh));
+    memcpy(sh.name, surface->header.name, sizeof(sh.name));
+    sh.firstVertex = firstVertex;
+    sh.numMeshlets = set.numMeshlets;
+    sh.numMeshletVerts = set.numVerts;
+    sh.numMeshletTris = set.numTris;
+    size_t triBytes = (size_t) set.numTris * 3;
+    size_t padded = (triBytes + 3) & ~(size_t) 3;
+    memset(set.triangles + triBytes, 0, padded - triBytes);
+    int ok = fwrite(&sh, sizeof(sh), 1, fp) == 1 &&
+             fwrite(set.meshlets, sizeof(meshletDesc_t), set.numMeshlets, fp) == (size_t) set.numMeshlets &&
+             fwrite(set.vertices, sizeof(int), set.numVerts, fp) == (size_t) set.numVerts &&
+             fwrite(set.triangles, 1, padded, fp) == padded;
+    float *x = xyz, *y = xyz + maxVerts, *z = xyz + 2 * maxVerts;
+    int numVerts = surface->header.numVerts;
+    for (int f = 0; ok && f < numFrames; f++) {
+        decode_positions(surface->vertices + (size_t) f * numVerts, numVerts, g_swapYZ, x, y, z);
+        for (int i = 0; ok && i < set.numMeshlets; i++) {
+            meshletBounds_t b;
+            compute_meshlet_bounds(&set, &set.meshlets[i], x, y, z, &b);
+            ok = fwrite(&b, sizeof(b), 1, fp) == 1;
+        }
+    }
+    printf("Meshlets %s: %d meshlets for %d triangles\n", surface->header.name, set.numMeshlets, set.numTris);
+    free(set.meshlets);
+    free(set.vertices);
+    free(set.triangles);
+    return ok;
+}
+
+/* Writes the meshlet sidecar for a model */
+int write_meshlets(const char *path, md3SurfaceData *surfaces, int numSurfaces, int numFrames) {
+    md3Clock clock;
+    stats_begin(&clock);
+    FILE *fp = fopen(path, "wb");
+    if (!fp) {
+        fprintf(stderr, "Error opening output file %s: %s\n", path, strerror(errno));
+        return 0;
+    }
+    int maxVerts = 1;
+    for (int s = 0; s < numSurfaces; s++) {
+        if (surfaces[s].header.numVerts > maxVerts) maxVerts = surfaces[s].header.numVerts;
+    }
+    float *xyz = (float*) malloc((size_t) maxVerts * 3 * sizeof(float));
+    if (!xyz) {
+        fprintf(stderr, "Memory allocation failed for vertex buffer.\n");
+        fclose(fp);
+        return 0;
+    }
+    meshletFileHeader_t fh;
+    memcpy(fh.id, "MD3M", 4);
+    fh.version = 1;
+    fh.numSurfaces = numSurfaces;
+    fh.numFrames = numFrames;
+    fh.maxVerts = MESHLET_MAX_VERTS;
+    fh.maxTris = MESHLET_MAX_TRIS;
+    int ok = fwrite(&fh, sizeof(fh), 1, fp) == 1;
+    int firstVertex = 0;
+    for (int s = 0; ok && s < numSurfaces; s++) {
+        ok = write_meshlets_surface(fp, &surfaces[s], firstVertex, numFrames, xyz, maxVerts);
+        firstVertex += surfaces[s].header.numVerts;
+    }
+    free(xyz);
+    long written = ftell(fp);
+    if (fclose(fp) != 0) ok = 0;
+    if (!ok) {
+        fprintf(stderr, "Failed writing %s\n", path);
+        return 0;
+    }
+    stats_add_bytes_written(written);
+    stats_end(STAT_WRITE, &clock);
+    return 1;
+}
+
+/* --- End Meshlet Sidecar --- */
+
+/* --- OBJ Reader --- */
+
+/* Reads the subset of OBJ this tool writes, plus what common editors
+   export: v, vt, vn, f (polygons are fanned into triangles, negative
+   indices are relative), g/o groups and usemtl. Everything else is
+   ignored. Indices are stored 0-based, -1 when a corner has no vt/vn. */
+
+#define OBJ_MAX_LINE 4096
+
+typedef struct {
+    char name[64];
+    char material[64];
+    int firstFace;
+} objGroup;
+
+/* A g/o or usemtl line seen by a parallel chunk, replayed in order */
+typedef struct {
+    int isMaterial;
+    char name[64];
+    int face;
+} objEvent;
+
+typedef struct {
+    float *v, *vt, *vn;          // 3, 2 and 3 floats per entry
+    int numV, numVt, numVn;
+    int capV, capVt, capVn;
+    int *faces;                  // 9 ints per triangle: v/vt/vn per corner
+    int numFaces, capFaces;
+    objGroup *groups;
+    int numGroups, capGroups;
+    /* Parallel chunks: entries before this chunk, and group changes
+       recorded as events instead of applied */
+    int baseV, baseVt, baseVn;
+    int deferGroups;
+    objEvent *events;
+    int numEvents, capEvents;
+} objMesh;
+
+void free_obj_mesh(objMesh *mesh) {
+    free(mesh->v);
+    free(mesh->vt);
+    free(mesh->vn);
+    free(mesh->faces);
+    free(mesh->groups);
+    free(mesh->events);
+    memset(mesh, 0, sizeof(*mesh));
+}
+
+/* Grows *array (elemSize bytes each) so it can hold count + 1 entries */
+int obj_grow(void **array, int *cap, int count, size_t elemSize) {
+    if (count < *cap) return 1;
+    /* Keep headroom for the callers' int count arithmetic (at most 9 more
+       per element) and refuse sizes that do not fit size_t */
+    if (*cap > (INT_MAX - 16) / 2) return 0;
+    int newCap = *cap ? *cap * 2 : 1024;
+    if ((size_t) newCap > SIZE_MAX / elemSize) return 0;
+    void *grown = realloc(*array, (size_t) newCap * elemSize);
+    if (!grown) return 0;
+    *array = grown;
+    *cap = newCap;
+    return 1;
+}
+
+int obj_add_group(objMesh *mesh, const char *name) {
+    if (!obj_grow((void**) &mesh->groups, &mesh->capGroups, mesh->numGroups, sizeof(objGroup))) return 0;
+    objGroup *g = &mesh->groups[mesh->numGroups++];
+    memset(g, 0, sizeof(*g));
+    snprintf(g->name, sizeof(g->name), "%s", name);
+    g->firstFace = mesh->numFaces;
+    /* A material carries over into the next group until changed */
+    if (mesh->numGroups > 1) memcpy(g->material, mesh->groups[mesh->numGroups - 2].material, sizeof(g->material));
+    return 1;
+}
+
+/* Starts a group for a g/o line */
+int obj_begin_group(objMesh *mesh, const char *name) {
+    /* Reuse an empty group instead of stacking "o" and "g" lines */
+    if (mesh->numGroups > 0 && mesh->groups[mesh->numGroups - 1].firstFace == mesh->numFaces) {
+        snprintf(mesh->groups[mesh->numGroups - 1].name, sizeof(mesh->groups[0].name), "%s", name);
+        return 1;
+    }
+    return obj_add_group(mesh, name);
+}
+
+/* Applies a usemtl line to the current group */
+int obj_use_material(objMesh *mesh, const char *material) {
+    if (mesh->numGroups == 0 && !obj_add_group(mesh, "default")) return 0;
+    objGroup *g = &mesh->groups[mesh->numGroups - 1];
+    if (g->firstFace != mesh->numFaces && g->material[0]) {
+        /* Material change inside a group starts a new surface */
+        char name[64];
+        snprintf(name, sizeof(name), "%s", g->name);
+        if (!obj_add_group(mesh, name)) return 0;
+        g = &mesh->groups[mesh->numGroups - 1];
+    }
+    snprintf(g->material, sizeof(g->material), "%s", material);
+    return 1;
+}
+
+int obj_record_event(objMesh *mesh, int isMaterial, const char *name) {
+    if (!obj_grow((void**) &mesh->events, &mesh->capEvents, mesh->numEvents, sizeof(objEvent))) return 0;
+    objEvent *e = &mesh->events[mesh->numEvents++];
+    e->isMaterial = isMaterial;
+    snprintf(e->name, sizeof(e->name), "%s", name);
+    e->face = mesh->numFaces;
+    return 1;
+}
+
+/* Resolves a 1-based or negative OBJ index against count entries */
+int obj_resolve_index(long index, int count) {
+    if (index > 0 && index <= count) return (int)(index - 1);
+    if (index < 0 && -index <= count) return (int)(count + index);
+    return -2;
+}
+
+/* Parses one "v/vt/vn" corner. Returns 0 on a malformed or out-of-range index. */
+int obj_parse_corner(const objMesh *mesh, char **cursor, int *corner) {
+    char *p = *cursor;
+    long idx[3] = { 0, 0, 0 };
+    for (int k = 0; k < 3; k++) {
+        if (*p == '/') {
+            p++;
+            if (k == 0) return 0;
+            continue;
+        }
+        char *end;
+        idx[k] = strtol(p, &end, 10);
+        if (end == p) {
+            if (k == 0) return 0;
+        }
+        p = end;
+        if (*p != '/') break;
+        p++;
+    }
+    *cursor = p;
+    corner[0] = obj_resolve_index(idx[0], mesh->baseV + mesh->numV);
+    corner[1] = idx[1] ? obj_resolve_index(idx[1], mesh->baseVt + mesh->numVt) : -1;
+    corner[2] = idx[2] ? obj_resolve_index(idx[2], mesh->baseVn + mesh->numVn) : -1;
+    return corner[0] >= 0 && corner[1] >= -1 && corner[2] >= -1;
+}
+
+/* Parses one line into mesh. Returns 0 on error (message printed). */
+int parse_obj_line(objMesh *mesh, char *line, const char *source, long lineNo) {
+    char *p = line;
+    while (*p == ' ' || *p == '\t') p++;
+    if (p[0] == 'v' && (p[1] == ' ' || p[1] == '\t')) {
+        if (!obj_grow((void**) &mesh->v, &mesh->capV, mesh->numV * 3 + 2, sizeof(float))) goto nomem;
+        float *dst = mesh->v + (size_t) mesh->numV * 3;
+        char *end = p + 1;
+        for (int k = 0; k < 3; k++) dst[k] = strtof(end, &end);
+        mesh->numV++;
+    } else if (p[0] == 'v' && p[1] == 't' && (p[2] == ' ' || p[2] == '\t')) {
+        if (!obj_grow((void**) &mesh->vt, &mesh->capVt, mesh->numVt * 2 + 1, sizeof(float))) goto nomem;
+        float *dst = mesh->vt + (size_t) mesh->numVt * 2;
+        char *end = p + 2;
+        for (int k = 0; k < 2; k++) dst[k] = strtof(end, &end);
+        mesh->numVt++;
+    } else if (p[0] == 'v' && p[1] == 'n' && (p[2] == ' ' || p[2] == '\t')) {
+        if (!obj_grow((void**) &mesh->vn, &mesh->capVn, mesh->numVn * 3 + 2, sizeof(float))) goto nomem;
+        float *dst = mesh->vn + (size_t) mesh->numVn * 3;
+        char *end = p + 2;
+        for (int k = 0; k < 3; k++) dst[k] = strtof(end, &end);
+        mesh->numVn++;
+    } else if (p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+        int first[3], prev[3], corner[3], count = 0;
+        p++;
+        if (!mesh->deferGroups && mesh->numGroups == 0 && !obj_add_group(mesh, "default")) goto nomem;
+        for (;;) {
+            while (*p == ' ' || *p == '\t') p++;
+            if (!*p || *p == '\n' || *p == '\r') break;
+            if (!obj_parse_corner(mesh, &p, corner)) {
+                fprintf(stderr, "%s:%ld: invalid face index\n", source, lineNo);
+                return 0;
+            }
+            if (count == 0) memcpy(first, corner, sizeof(first));
+            if (count >= 2) {
+                if (!obj_grow((void**) &mesh->faces, &mesh->capFaces, mesh->numFaces * 9 + 8, sizeof(int))) goto nomem;
+                int *f = mesh->faces + (size_t) mesh->numFaces * 9;
+                memcpy(f, first, 3 * sizeof(int));
+                memcpy(f + 3, prev, 3 * sizeof(int));
+                memcpy(f + 6, corner, 3 * sizeof(int));
+                mesh->numFaces++;
+            }
+            memcpy(prev, corner, sizeof(prev));
+            count++;
+        }
+        if (count < 3) {
+            fprintf(stderr, "%s:%ld: face with fewer than 3 corners\n", source, lineNo);
+            return 0;
+        }
+    } else if ((p[0] == 'g' || p[0] == 'o') && (p[1] == ' ' || p[1] == '\t')) {
+        char name[64];
+        if (sscanf(p + 2, "%63s", name) != 1) strcpy(name, "default");
+        if (!(mesh->deferGroups ? obj_record_event(mesh, 0, name) : obj_begin_group(mesh, name))) goto nomem;
+    } else if (strncmp(p, "usemtl", 6) == 0 && (p[6] == ' ' || p[6] == '\t')) {
+        char material[64];
+        if (sscanf(p + 7, "%63s", material) != 1) material[0] = '\0';
+        if (!(mesh->deferGroups ? obj_record_event(mesh, 1, material) : obj_use_material(mesh, material))) goto nomem;
+    }
+    return 1;
+
+nomem:
+    fprintf(stderr, "Memory allocation failed while reading %s.\n", source);
+    return 0;
+}
+
+/* --- Parallel OBJ Parser --- */
+
+/* Parses a whole OBJ held in memory with run_parallel(). The buffer is cut
+   into chunks at line boundaries. A counting pass finds how many v/vt/vn
+   lines precede each chunk, so chunks can resolve relative face indices on
+   their own; each chunk then parses into private arrays, recording group
+   and material changes as events. The chunks are concatenated and the
+   events replayed in order, giving exactly what parse_obj_line() builds
+   sequentially. */
+
+#define OBJ_MIN_CHUNK (256 * 1024)
+
+typedef struct {
+    const char *begin, *end;
+    int numV, numVt, numVn;
+    long numLines;            // for error messages
+    objMesh mesh;
+    int ok;
+} objChunk;
+
+typedef struct {
+    objChunk *chunks;
+    const char *source;
+} objParseJob;
+
+void obj_count_chunks(void *ctx, int begin, int end) {
+    objParseJob *job = (objParseJob*) ctx;
+    for (int c = begin; c < end; c++) {
+        objChunk *chunk = &job->chunks[c];
+        const char *p = chunk->begin;
+        while (p < chunk->end) {
+            while (p < chunk->end && (*p == ' ' || *p == '\t')) p++;
+            if (chunk->end - p >= 2 && p[0] == 'v') {
+                if (p[1] == ' ' || p[1] == '\t') chunk->numV++;
+                else if (chunk->end - p >= 3 && p[1] == 't' && (p[2] == ' ' || p[2] == '\t')) chunk->numVt++;
+                else if (chunk->end - p >= 3 && p[1] == 'n' && (p[2] == ' ' || p[2] == '\t')) chunk->numVn++;
+            }
+            const char *nl = (const char*) memchr(p, '\n', chunk->end - p);
+            p = nl ? nl + 1 : chunk->end;
+            chunk->numLines++;
+        }
+    }
+}
+
+void obj_parse_chunks(void *ctx, int begin, int end) {
+    objParseJob *job = (objParseJob*) ctx;
+    char line[OBJ_MAX_LINE];
+    for (int c = begin; c < end; c++) {
+        objChunk *chunk = &job->chunks[c];
+        const char *p = chunk->begin;
+        long lineNo = 0;
+        for (int prev = 0; prev < c; prev++) lineNo += job->chunks[prev].numLines;
+        chunk->ok = 1;
+        while (p < chunk->end && chunk->ok) {
+            const char *nl = (const char*) memchr(p, '\n', chunk->end - p);
+            const char *lineEnd = nl ? nl : chunk->end;
+            /* Lines are copied so number parsing stops at the line end */
+            size_t len = (size_t)(lineEnd - p);
+            if (len >= sizeof(line)) len = sizeof(line) - 1;
+            memcpy(line, p, len);
+            line[len] = '\0';
+            chunk->ok = parse_obj_line(&chunk->mesh, line, job->source, ++lineNo);
+            p = nl ? nl + 1 : chunk->end;
+        }
+    }
+}
+
+/* Appends src (count entries of elemSize) to dst */
+int obj_append(void **dst, int *dstCount, int *dstCap, const void *src, int count, size_t elemSize) {
+    if (count == 0) return 1;
+    if (*dstCount + count > *dstCap) {
+        void *grown = realloc(*dst, (size_t)(*dstCount + count) * elemSize);
+        if (!grown) return 0;
+        *dst = grown;
+        *dstCap = *dstCount + count;
+    }
+    memcpy((char*) *dst + (size_t) *dstCount * elemSize, src, (size_t) count * elemSize);
+    *dstCount += count;
+    return 1;
+}
+
+int parse_obj_buffer(const char *data, size_t size, const char *source, objMesh *mesh) {
+    memset(mesh, 0, sizeof(*mesh));
+    int numChunks = parallel_thread_count((int)(size / OBJ_MIN_CHUNK + 1));
+    objChunk *chunks = (objChunk*) calloc(numChunks, sizeof(objChunk));
+    if (!chunks) {
+        fprintf(stderr, "Memory allocation failed while reading %s.\n", source);
+        return 0;
+    }
+    const char *cursor = data, *end = data + size;
+    for (int c = 0; c < numChunks; c++) {
+        const char *split = c + 1 < numChunks ? data + size / numChunks * (c + 1) : end;
+        if (split < cursor) split = cursor;
+        const char *nl = split < end ? (const char*) memchr(split, '\n', end - split) : NULL;
+        chunks[c].begin = cursor;
+        chunks[c].end = c + 1 < numChunks && nl ? nl + 1 : end;
+        cursor = chunks[c].end;
+    }
+    objParseJob job = { chunks, source };
+    run_parallel(numChunks, obj_count_chunks, &job);
+    int baseV = 0, baseVt = 0, baseVn = 0;
+    for (int c = 0; c < numChunks; c++) {
+        chunks[c].mesh.baseV = baseV;
+        chunks[c].mesh.baseVt = baseVt;
+        chunks[c].mesh.baseVn = baseVn;
+        chunks[c].mesh.deferGroups = 1;
+        baseV += chunks[c].numV;
+        baseVt += chunks[c].numVt;
+        baseVn += chunks[c].numVn;
+    }
+    run_parallel(numChunks, obj_parse_chunks, &job);
+
+    int ok = 1;
+    for (int c = 0; c < numChunks && ok; c++) ok = chunks[c].ok;
+    for (int c = 0; c < numChunks && ok; c++) {
+        objMesh *m = &chunks[c].mesh;
+        int faceBase = mesh->numFaces;
+        int floatsV = mesh->numV * 3, floatsVt = mesh->numVt * 2, floatsVn = mesh->numVn * 3, ints = mesh->numFaces * 9;
+        ok = obj_append((void**) &mesh->v, &floatsV, &mesh->capV, m->v, m->numV * 3, sizeof(float)) &&
+             obj_append((void**) &mesh->vt, &floatsVt, &mesh->capVt, m->vt, m->numVt * 2, sizeof(float)) &&
+             obj_append((void**) &mesh->vn, &floatsVn, &mesh->capVn, m->vn, m->numVn * 3, sizeof(float)) &&
+             obj_append((void**) &mesh->faces, &ints, &mesh->capFaces, m->faces, m->numFaces * 9, sizeof(int));
+        mesh->numV += m->numV;
+        mesh->numVt += m->numVt;
+        mesh->numVn += m->numVn;
+        mesh->numFaces += m->numFaces;
+        /* Replay group changes at their global face positions */
+        int totalFaces = mesh->numFaces;
+        for (int e = 0; ok && e < m->numEvents; e++) {
+            const objEvent *ev = &m->events[e];
+            mesh->numFaces = faceBase + ev->face;
+            if (mesh->numFaces > 0 && mesh->numGroups == 0 && !obj_add_group(mesh, "default")) ok = 0;
+            if (mesh->numGroups > 0 && mesh->groups[0].firstFace > 0) mesh->groups[0].firstFace = 0;
+            if (ok) ok = ev->isMaterial ? obj_use_material(mesh, ev->name) : obj_begin_group(mesh, ev->name);
+        }
+        mesh->numFaces = totalFaces;
+    }
+    if (ok && mesh->numFaces > 0 && mesh->numGroups == 0) {
+        ok = obj_add_group(mesh, "default");
+        if (ok) mesh->groups[0].firstFace = 0;
+    }
+    if (!ok) {
+        int reported = 0;
+        for (int c = 0; c < numChunks; c++) reported |= !chunks[c].ok;
+        if (!reported) fprintf(stderr, "Memory allocation failed while reading %s.\n", source);
+        free_obj_mesh(mesh);
+    }
+    for (int c = 0; c < numChunks; c++) free_obj_mesh(&chunks[c].mesh);
+    free(chunks);
+    return ok;
+}
+
+/* Reads a whole OBJ file and parses it in parallel */
+int read_obj_file(const char *path, objMesh *mesh) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        fprintf(stderr, "Error opening file %s: %s\n", path, strerror(errno));
+        return 0;
+    }
+    long size = getFileSize(fp);
+    char *data = size >= 0 ? (char*) malloc((size_t) size + 1) : NULL;
+    if (!data || fread(data, 1, (size_t) size, fp) != (size_t) size) {
+        fprintf(stderr, "Error reading %s\n", path);
+        free(data);
+        fclose(fp);
+        return 0;
+    }
+    fclose(fp);
+    stats_add_bytes_read(size);
+    int ok = parse_obj_buffer(data, (size_t) size, path, mesh);
+    free(data);
+    return ok;
+}
+
+/* --- End Parallel OBJ Parser --- */
+
+/* Streams an OBJ frame sequence: either one frame per file, or a single
+   file holding one "o frame_N" object per frame (as -allFrames writes). In
+   the single-file case, vt lines before the first object are shared by all
+   frames. Only one frame is resident at a time. */
+typedef struct {
+    char **paths;
+    int numPaths;
+    int multiObject;          // frames are objects of paths[0]
+    int next;                 // next frame to read
+    int numFrames;
+    FILE *fp;
+    long lineNo;
+    char pending[OBJ_MAX_LINE];  // "o" line that started the next frame
+    int hasPending;
+    objMesh shared;           // vt lines before the first object
+} objFrameReader;
+
+/* Counts "o" lines to decide between one file per frame and an
+   -allFrames style file */
+int open_obj_frames(objFrameReader *reader, char **paths, int numPaths) {
+    memset(reader, 0, sizeof(*reader));
+    reader->paths = paths;
+    reader->numPaths = numPaths;
+    reader->numFrames = numPaths;
+    if (numPaths != 1) return 1;
+    FILE *fp = fopen(paths[0], "r");
+    if (!fp) {
+        fprintf(stderr, "Error opening file %s: %s\n", paths[0], strerror(errno));
+        return 0;
+    }
+    char line[OBJ_MAX_LINE];
+    int objects = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        if (strncmp(line, "o frame_", 8) == 0) objects++;
+    }
+    fclose(fp);
+    if (objects > 1) {
+        reader->multiObject = 1;
+        reader->numFrames = objects;
+    }
+    return 1;
+}
+
+/* Gives mesh a private copy of the shared texture coordinates */
+int obj_copy_shared(objFrameReader *reader, objMesh *mesh) {
+    if (reader->shared.numVt == 0 || mesh->numVt > 0) return 1;
+    size_t bytes = (size_t) reader->shared.numVt * 2 * sizeof(float);
+    mesh->vt = (float*) malloc(bytes);
+    if (!mesh->vt) {
+        fprintf(stderr, "Memory allocation failed for texture coordinates.\n");
+        return 0;
+    }
+    memcpy(mesh->vt, reader->shared.vt, bytes);
+    mesh->numVt = mesh->capVt = reader->shared.numVt;
+    return 1;
+}
+
+/* Reads the next frame into mesh (cleared first). In a multi-object file,
+   faces are only read for frame 0, since later frames reuse its topology.
+   Returns 0 on error. */
+int read_next_obj_frame(objFrameReader *reader, objMesh *mesh) {
+    free_obj_mesh(mesh);
+    if (!reader->multiObject) {
+        /* Whole files go through the parallel parser */
+        if (!read_obj_file(reader->paths[reader->next], mesh)) return 0;
+        reader->next++;
+        return 1;
+    }
+    int skipFaces = reader->next > 0;
+    const char *source = reader->paths[0];
+    if (!reader->fp) {
+        reader->fp = fopen(source, "r");
+        reader->lineNo = 0;
+        if (!reader->fp) {
+            fprintf(stderr, "Error opening file %s: %s\n", source, strerror(errno));
+            return 0;
+        }
+    }
+    char line[OBJ_MAX_LINE];
+    int started = 0;
+    if (reader->hasPending) {
+        reader->hasPending = 0;
+        started = 1;
+        if (!obj_copy_shared(reader, mesh) || !parse_obj_line(mesh, reader->pending, source, reader->lineNo)) return 0;
+    }
+    while (fgets(line, sizeof(line), reader->fp)) {
+        reader->lineNo++;
+        if (strncmp(line, "o frame_", 8) == 0) {
+            if (started) {
+                memcpy(reader->pending, line, sizeof(line));
+                reader->hasPending = 1;
+                break;
+            }
+            started = 1;
+            if (!obj_copy_shared(reader, mesh)) return 0;
+        }
+        if (skipFaces && line[0] == 'f') continue;
+        /* Lines before the first object (shared vt) go to the shared mesh */
+        objMesh *target = started ? mesh : &reader->shared;
+        if (!parse_obj_line(target, line, source, reader->lineNo)) return 0;
+    }
+    reader->next++;
+    return 1;
+}
+
+void close_obj_frames(objFrameReader *reader) {
+    if (reader->fp) fclose(reader->fp);
+    free_obj_mesh(&reader->shared);
+    reader->fp = NULL;
+}
+
+/* --- End OBJ Reader --- */
+
+/* --- Output Verification (-verify) --- */
+
+/* Reads a written frame back with the parallel parser and checks it against
+   the model: element counts, every position, texture coordinate and normal
+   within the precision of the "%f" output, and every face index. */
+
+#define VERIFY_EPSILON 1e-5f
+
+int verify_close(const float *a, const float *b, int n) {
+    for (int k = 0; k < n; k++) {
+        if (fabsf(a[k] - b[k]) > VERIFY_EPSILON * (1.0f + fabsf(b[k]))) return 0;
+    }
+    return 1;
+}
+
+int verify_obj_frame(const char *path, md3SurfaceData *surfaces, int numSurfaces, int frame) {
+    objMesh mesh;
+    if (!read_obj_file(path, &mesh)) return 0;
+    int numVerts = 0, numTris = 0, maxVerts = 0;
+    for (int s = 0; s < numSurfaces; s++) {
+        numVerts += surfaces[s].header.numVerts;
+        numTris += surfaces[s].header.numTriangles;
+        if (surfaces[s].header.numVerts > maxVerts) maxVerts = surfaces[s].header.numVerts;
+    }
+    if (mesh.numV != numVerts || mesh.numVt != numVerts || mesh.numVn != numVerts || mesh.numFaces != numTris) {
+        fprintf(stderr, "Verify %s: expected %d vertices and %d triangles, read v/vt/vn %d/%d/%d and %d triangles\n",
+                path, numVerts, numTris, mesh.numV, mesh.numVt, mesh.numVn, mesh.numFaces);
+        free_obj_mesh(&mesh);
+        return 0;
+    }
+    float *buffer = (float*) malloc((size_t)(maxVerts > 0 ? maxVerts : 1) * 6 * sizeof(float));
+    if (!buffer) {
+        fprintf(stderr, "Memory allocation failed for verification.\n");
+        free_obj_mesh(&mesh);
+        return 0;
+    }
+    float *x = buffer, *y = x + maxVerts, *z = y + maxVerts;
+    float *nx = z + maxVerts, *ny = nx + maxVerts, *nz = ny + maxVerts;
+    int ok = 1, vertex = 0, face = 0;
+    for (int s = 0; ok && s < numSurfaces; s++) {
+        const md3SurfaceData *surf = &surfaces[s];
+        int count = surf->header.numVerts;
+        decode_positions(surf->vertices + (size_t) frame * count, count, g_swapYZ, x, y, z);
+        decode_normals(surf->vertices + (size_t) frame * count, count, nx, ny, nz);
+        for (int v = 0; ok && v < count; v++, vertex++) {
+            float pos[3] = { x[v], y[v], z[v] };
+            float st[2] = { surf->texCoords[v].st[0], surf->texCoords[v].st[1] };
+            float n[3] = { nx[v], g_swapYZ ? nz[v] : ny[v], g_swapYZ ? ny[v] : nz[v] };
+            if (g_flipUVs) st[1] = 1.0f - st[1];
+            ok = verify_close(mesh.v + (size_t) vertex * 3, pos, 3) &&
+                 verify_close(mesh.vt + (size_t) vertex * 2, st, 2) &&
+                 verify_close(mesh.vn + (size_t) vertex * 3, n, 3);
+            if (!ok) fprintf(stderr, "Verify %s: vertex %d of surface %s differs\n", path, v, surf->header.name);
+        }
+        int base = surf->baseIndex - 1;
+        for (int t = 0; ok && t < surf->header.numTriangles; t++, face++) {
+            const int *idx = surf->triangles[t].indexes;
+            int order[3] = { idx[2], idx[1], idx[0] };
+            if (g_swapYZ) memcpy(order, idx, sizeof(order));
+            const int *f = mesh.faces + (size_t) face * 9;
+            for (int c = 0; c < 3; c++) {
+                int expected = base + order[c];
+                if (f[c * 3] != expected || f[c * 3 + 1] != expected || f[c * 3 + 2] != expected) ok = 0;
+            }
+            if (!ok) fprintf(stderr, "Verify %s: triangle %d of surface %s differs\n", path, t, surf->header.name);
+        }
+    }
+    free(buffer);
+    free_obj_mesh(&mesh);
+    return ok;
+}
+
+/* --- End Output Verification --- */
+
+/* --- MD3 Encoder (-toMD3) --- */
+
+/* Encodes an OBJ frame sequence as MD3. Each OBJ group becomes a surface
+   and each distinct v/vt/vn corner an MD3 vertex, all taken from frame 0;
+   later frames must list their v and vn lines in the same order (as this
+   tool writes them) and only those are read. The -swapYZ/-flipUVs settings
+   are undone, so converting back with the same options reproduces the
+   input. Offsets are computed up front and every frame's vertices are
+   written straight to their place in each surface, so only one frame is
+   held in memory. */
+
+typedef struct {
+    md3Surface_t header;
+    md3Shader_t shader;
+    md3Triangle_t *triangles;
+    md3TexCoord_t *texCoords;
+    int *corners;             // v, vt, vn source indices per MD3 vertex
+    long fileOffset;
+} md3EncodeSurface;
+
+/* Open-addressing map from (group, v, vt, vn) to an MD3 vertex index */
+typedef struct {
+    int *keys;                // 4 ints per slot, keys[0] == -1 when empty
+    int *values;
+    size_t mask;
+} cornerMap;
+
+/* qsort order for MD3 vertices: by source v, then vt, then vn */
+int compare_corners(const void *a, const void *b) {
+    const int *ca = (const int*) a, *cb = (const int*) b;
+    for (int k = 0; k < 3; k++) {
+        if (ca[k] != cb[k]) return ca[k] < cb[k] ? -1 : 1;
+    }
+    return 0;
+}
+
+int corner_map_init(cornerMap *map, size_t minSlots) {
+    size_t slots = 64;
+    while (slots < minSlots * 2) slots *= 2;
+    map->keys = (int*) malloc(slots * 4 * sizeof(int));
+    map->values = (int*) malloc(slots * sizeof(int));
+    map->mask = slots - 1;
+    if (!map->keys || !map->values) {
+        free(map->keys);
+        free(map->values);
+        return 0;
+    }
+    for (size_t i = 0; i < slots; i++) map->keys[i * 4] = -1;
+    return 1;
+}
+
+/* Returns the slot for key, which is either empty or holds key */
+size_t corner_map_slot(const cornerMap *map, const int *key) {
+    unsigned int h = 2166136261u;
+    for (int k = 0; k < 4; k++) {
+        h = (h ^ (unsigned int) key[k]) * 16777619u;
+    }
+    size_t i = h & map->mask;
+    while (map->keys[i * 4] != -1 && memcmp(&map->keys[i * 4], key, 4 * sizeof(int)) != 0) {
+        i = (i + 1) & map->mask;
+    }
+    return i;
+}
+
+void free_encode_surfaces(md3EncodeSurface *surfaces, int count) {
+    if (!surfaces) return;
+    for (int s = 0; s < count; s++) {
+        free(surfaces[s].triangles);
+        free(surfaces[s].texCoords);
+        free(surfaces[s].corners);
+    }
+    free(surfaces);
+}
+
+/* Builds surfaces, triangles and texture coordinates from frame 0 */
+md3EncodeSurface *build_encode_surfaces(const objMesh *mesh, int numFrames, int *numSurfacesOut) {
+    int numSurfaces = 0;
+    for (int g = 0; g < mesh->numGroups; g++) {
+        int end = g + 1 < mesh->numGroups ? mesh->groups[g + 1].firstFace : mesh->numFaces;
+        if (end > mesh->groups[g].firstFace) numSurfaces++;
+    }
+    md3EncodeSurface *surfaces = (md3EncodeSurface*) calloc(numSurfaces > 0 ? numSurfaces : 1, sizeof(md3EncodeSurface));
+    cornerMap map;
+    if (!surfaces || !corner_map_init(&map, (size_t) mesh->numFaces * 3)) {
+        fprintf(stderr, "Memory allocation failed for MD3 surfaces.\n");
+        free(surfaces);
+        return NULL;
+    }
+    int s = 0;
+    for (int g = 0; g < mesh->numGroups; g++) {
+        const objGroup *group = &mesh->groups[g];
+        int end = g + 1 < mesh->numGroups ? mesh->groups[g + 1].firstFace : mesh->numFaces;
+        int numTris = end - group->firstFace;
+        if (numTris <= 0) continue;
+        md3EncodeSurface *surface = &surfaces[s];
+        md3Surface_t *h = &surface->header;
+        memcpy(h->id, "IDP3", 4);
+        snprintf(h->name, sizeof(h->name), "%s", group->name);
+        h->numFrames = numFrames;
+        h->numTriangles = numTris;
+        if (group->material[0]) {
+            h->numShaders = 1;
+            snprintf(surface->shader.name, sizeof(surface->shader.name), "%s", group->material);
+        }
+        surface->triangles = (md3Triangle_t*) malloc(numTris * sizeof(md3Triangle_t));
+        surface->texCoords = (md3TexCoord_t*) malloc((size_t) numTris * 3 * sizeof(md3TexCoord_t));
+        surface->corners = (int*) malloc((size_t) numTris * 3 * 4 * sizeof(int));
+        if (!surface->triangles || !surface->texCoords || !surface->corners) {
+            fprintf(stderr, "Memory allocation failed for MD3 surfaces.\n");
+            free_encode_surfaces(surfaces, s + 1);
+            free(map.keys);
+            free(map.values);
+            return NULL;
+        }
+        for (int t = 0; t < numTris; t++) {
+            const int *face = mesh->faces + (size_t)(group->firstFace + t) * 9;
+            int tri[3];
+            for (int c = 0; c < 3; c++) {
+                int key[4] = { s, face[c * 3], face[c * 3 + 1], face[c * 3 + 2] };
+                size_t slot = corner_map_slot(&map, key);
+                if (map.keys[slot * 4] == -1) {
+                    int v = h->numVerts++;
+                    memcpy(&map.keys[slot * 4], key, sizeof(key));
+                    map.values[slot] = v;
+                    /* v, vt, vn and the first-seen index, sorted below */
+                    surface->corners[v * 4] = key[1];
+                    surface->corners[v * 4 + 1] = key[2];
+                    surface->corners[v * 4 + 2] = key[3];
+                    surface->corners[v * 4 + 3] = v;
+                }
+                tri[c] = map.values[slot];
+            }
+            /* The OBJ writer reverses the winding unless swapping Y/Z */
+            md3Triangle_t *out = &surface->triangles[t];
+            out->indexes[0] = g_swapYZ ? tri[0] : tri[2];
+            out->indexes[1] = tri[1];
+            out->indexes[2] = g_swapYZ ? tri[2] : tri[0];
+        }
+        /* Number vertices in source order, so an OBJ written by this tool
+           gets its original vertex order back */
+        int numVerts = h->numVerts;
+        int *remap = (int*) malloc((numVerts > 0 ? numVerts : 1) * sizeof(int));
+        if (!remap) {
+            fprintf(stderr, "Memory allocation failed for MD3 surfaces.\n");
+            free_encode_surfaces(surfaces, s + 1);
+            free(map.keys);
+            free(map.values);
+            return NULL;
+        }
+        qsort(surface->corners, numVerts, 4 * sizeof(int), compare_corners);
+        for (int v = 0; v < numVerts; v++) {
+            int *c = surface->corners + v * 4;
+            remap[c[3]] = v;
+            float st[2] = { 0.0f, 0.0f };
+            if (c[1] >= 0) {
+                st[0] = mesh->vt[(size_t) c[1] * 2];
+                st[1] = mesh->vt[(size_t) c[1] * 2 + 1];
+            }
+            surface->texCoords[v].st[0] = st[0];
+            surface->texCoords[v].st[1] = g_flipUVs ? 1.0f - st[1] : st[1];
+        }
+        for (int t = 0; t < numTris; t++) {
+            for (int k = 0; k < 3; k++) surface->triangles[t].indexes[k] = remap[surface->triangles[t].indexes[k]];
+        }
+        free(remap);
+        s++;
+    }
+    free(map.keys);
+    free(map.values);
+    *numSurfacesOut = numSurfaces;
+    return surfaces;
+}
+
+/* Fills one surface's vertices for the current frame */
+int encode_frame_vertices(const md3EncodeSurface *surface, const objMesh *frame, md3Vertex_t *out, md3Frame_t *bounds, int *haveBounds) {
+    for (int v = 0; v < surface->header.numVerts; v++) {
+        int vi = surface->corners[v * 4], ni = surface->corners[v * 4 + 2];
+        if (vi >= frame->numV || ni >= frame->numVn) {
+            return 0;
+        }
+        const float *p = frame->v + (size_t) vi * 3;
+        float pos[3] = { p[0], g_swapYZ ? p[2] : p[1], g_swapYZ ? p[1] : p[2] };
+        for (int k = 0; k < 3; k++) {
+            out[v].xyz[k] = quantizePosition(pos[k]);
+            float q = out[v].xyz[k] * MD3_XYZ_SCALE;
+            if (!*haveBounds || q < bounds->mins[k]) bounds->mins[k] = q;
+            if (!*haveBounds || q > bounds->maxs[k]) bounds->maxs[k] = q;
+        }
+        *haveBounds = 1;
+        float r2 = out[v].xyz[0] * MD3_XYZ_SCALE * out[v].xyz[0] * MD3_XYZ_SCALE +
+                   out[v].xyz[1] * MD3_XYZ_SCALE * out[v].xyz[1] * MD3_XYZ_SCALE +
+                   out[v].xyz[2] * MD3_XYZ_SCALE * out[v].xyz[2] * MD3_XYZ_SCALE;
+        if (r2 > bounds->radius) bounds->radius = r2;  // squared until the frame is done
+        if (ni >= 0) {
+            const float *n = frame->vn + (size_t) ni * 3;
+            out[v].normal = encodeNormal(n[0], g_swapYZ ? n[2] : n[1], g_swapYZ ? n[1] : n[2]);
+        } else {
+            out[v].normal = 0;
+        }
+    }
+    return 1;
+}
+
+/* Writes zero bytes up to the given offset */
+int write_md3_padding(FILE *fp, long offset) {
+    while (ftell(fp) < offset) {
+        if (fputc(0, fp) == EOF) return 0;
+    }
+    return 1;
+}
+
+/* Copies numFrames * numTags tags from a reference MD3; when its frame count
+   differs, its first frame's tags are repeated for every frame */
+md3Tag_t *load_reference_tags(const char *path, int numFrames, int *numTagsOut) {
+    FILE *fp = fopen(path, "rb");
+    if (!fp) {
+        fprintf(stderr, "Error opening file %s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+    long fileSize = getFileSize(fp);
+    md3Header_t header;
+    if (fileSize < 0 || !read_md3_header(fp, &header, fileSize) || header.numTags < 0 || header.numFrames < 1) {
+        fclose(fp);
+        return NULL;
+    }
+    int sourceFrames = header.numFrames == numFrames ? numFrames : 1;
+    if (header.numFrames != numFrames) {
+        printf("Reference %s has %d frames, repeating its first frame's tags\n", path, header.numFrames);
+    }
+    md3Tag_t *tags = (md3Tag_t*) malloc((size_t)(header.numTags > 0 ? header.numTags : 1) * numFrames * sizeof(md3Tag_t));
+    size_t sourceBytes = (size_t) header.numTags * sourceFrames * sizeof(md3Tag_t);
+    if (!tags || !read_from_offset(fp, header.ofsTags, tags, sourceBytes, fileSize)) {
+        fprintf(stderr, "Error reading tags from %s\n", path);
+        free(tags);
+        fclose(fp);
+        return NULL;
+    }
+    fclose(fp);
+    for (int f = sourceFrames; f < numFrames; f++) {
+        memcpy(tags + (size_t) f * header.numTags, tags, (size_t) header.numTags * sizeof(md3Tag_t));
+    }
+    *numTagsOut = header.numTags;
+    return tags;
+}
+
+/* Encodes OBJ inputs (a frame sequence) into an MD3 file */
+int write_md3_from_obj(const char *outputName, char **inputs, int numInputs, const char *tagsFrom) {
+    objFrameReader reader;
+    if (!open_obj_frames(&reader, inputs, numInputs)) return 0;
+    int numFrames = reader.numFrames;
+    objMesh frame;
+    memset(&frame, 0, sizeof(frame));
+    md3Header_t header;
+    memset(&header, 0, sizeof(header));
+    md3Clock clock;
+    stats_file_begin(inputs[0]);
+    stats_begin(&clock);
+    int ok = read_next_obj_frame(&reader, &frame);
+    stats_end(STAT_SURFACES, &clock);
+    int numSurfaces = 0;
+    md3EncodeSurface *surfaces = ok ? build_encode_surfaces(&frame, numFrames, &numSurfaces) : NULL;
+    int numTags = 0;
+    md3Tag_t *tags = NULL;
+    md3Frame_t *frames = (md3Frame_t*) calloc(numFrames, sizeof(md3Frame_t));
+    md3Vertex_t *vertexBuffer = NULL;
+    FILE *fp = NULL;
+    if (!surfaces || !frames || (tagsFrom && !(tags = load_reference_tags(tagsFrom, numFrames, &numTags)))) {
+        ok = 0;
+        goto done;
+    }
+
+    /* Layout: header, frames, tags, then each surface's header, shaders,
+       triangles, texture coordinates and per-frame vertices */
+    memcpy(header.id, "IDP3", 4);
+    header.version = MD3_VERSION;
+    getBasename(outputName, header.name, sizeof(header.name));
+    header.numFrames = numFrames;
+    header.numTags = numTags;
+    header.numSurfaces = numSurfaces;
+    header.ofsFrames = sizeof(md3Header_t);
+    header.ofsTags = header.ofsFrames + numFrames * (int) sizeof(md3Frame_t);
+    long offset = header.ofsTags + (long) numTags * numFrames * (long) sizeof(md3Tag_t);
+    header.ofsSurfaces = (int) offset;
+    int maxVerts = 1;
+    for (int s = 0; s < numSurfaces; s++) {
+        md3Surface_t *h = &surfaces[s].header;
+        surfaces[s].fileOffset = offset;
+        h->ofsShaders = sizeof(md3Surface_t);
+        h->ofsTriangles = h->ofsShaders + h->numShaders * (int) sizeof(md3Shader_t);
+        h->ofsST = h->ofsTriangles + h->numTriangles * (int) sizeof(md3Triangle_t);
+        h->ofsVerts = h->ofsST + h->numVerts * (int) sizeof(md3TexCoord_t);
+        h->ofsEnd = h->ofsVerts + h->numVerts * numFrames * (int) sizeof(md3Vertex_t);
+        offset += h->ofsEnd;
+        if (h->numVerts > maxVerts) maxVerts = h->numVerts;
+    }
+    header.ofsEnd = (int) offset;
+    vertexBuffer = (md3Vertex_t*) malloc((size_t) maxVerts * sizeof(md3Vertex_t));
+    if (!vertexBuffer) {
+        fprintf(stderr, "Memory allocation failed for vertex buffer.\n");
+        ok = 0;
+        goto done;
+    }
+
+    stats_begin(&clock);
+    fp = fopen(outputName, "wb");
+    if (!fp) {
+        fprintf(stderr, "Error opening output file %s: %s\n", outputName, strerror(errno));
+        ok = 0;
+        goto done;
+    }
+    ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+         write_md3_padding(fp, header.ofsTags) &&
+         (numTags == 0 || fwrite(tags, sizeof(md3Tag_t), (size_t) numTags * numFrames, fp) == (size_t) numTags * numFrames);
+    for (int s = 0; ok && s < numSurfaces; s++) {
+        md3EncodeSurface *surface = &surfaces[s];
+        ok = fseek(fp, surface->fileOffset, SEEK_SET) == 0 &&
+             fwrite(&surface->header, sizeof(md3Surface_t), 1, fp) == 1 &&
+             (surface->header.numShaders == 0 || fwrite(&surface->shader, sizeof(md3Shader_t), 1, fp) == 1) &&
+             fwrite(surface->triangles, sizeof(md3Triangle_t), surface->header.numTriangles, fp) == (size_t) surface->header.numTriangles &&
+             fwrite(surface->texCoords, sizeof(md3TexCoord_t), surface->header.numVerts, fp) == (size_t) surface->header.numVerts;
+    }
+    stats_end(STAT_WRITE, &clock);
+    for (int f = 0; ok && f < numFrames; f++) {
+        if (f > 0) {
+            stats_begin(&clock);
+            ok = read_next_obj_frame(&reader, &frame);
+            stats_end(STAT_SURFACES, &clock);
+            if (!ok) break;
+        }
+        md3Frame_t *bounds = &frames[f];
+        int haveBounds = 0;
+        char frameName[32] = { 0 };
+        snprintf(frameName, sizeof(frameName), "frame%d", f);
+        memcpy(bounds->name, frameName, sizeof(bounds->name) - 1);
+        for (int s = 0; ok && s < numSurfaces; s++) {
+            md3EncodeSurface *surface = &surfaces[s];
+            stats_begin(&clock);
+            if (!encode_frame_vertices(surface, &frame, vertexBuffer, bounds, &haveBounds)) {
+                fprintf(stderr, "Frame %d does not match the vertices of frame 0\n", f);
+                ok = 0;
+                break;
+            }
+            stats_end(STAT_FORMAT, &clock);
+            stats_begin(&clock);
+            long pos = surface->fileOffset + surface->header.ofsVerts + (long) f * surface->header.numVerts * (long) sizeof(md3Vertex_t);
+            ok = fseek(fp, pos, SEEK_SET) == 0 &&
+                 fwrite(vertexBuffer, sizeof(md3Vertex_t), surface->header.numVerts, fp) == (size_t) surface->header.numVerts;
+            stats_end(STAT_WRITE, &clock);
+        }
+        bounds->radius = sqrtf(bounds->radius);
+        if (ok) printf("Encoded frame %d\n", f);
+    }
+    if (ok) {
+        ok = fseek(fp, header.ofsFrames, SEEK_SET) == 0 &&
+             fwrite(frames, sizeof(md3Frame_t), numFrames, fp) == (size_t) numFrames;
+    }
+
+done:
+    if (fp) {
+        if (fclose(fp) != 0) ok = 0;
+        if (ok) stats_add_bytes_written(header.ofsEnd);
+        if (!ok) fprintf(stderr, "Failed writing %s\n", outputName);
+    }
+    stats_file_end(&header, NULL, 0);
+    free(vertexBuffer);
+    free(frames);
+    free(tags);
+    free_encode_surfaces(surfaces, numSurfaces);
+    free_obj_mesh(&frame);
+    close_obj_frames(&reader);
+    return ok;
+}
+
+/* --- End MD3 Encoder --- */
+
+/* --- Other Model Formats (MD2, MDC, MDR) --- */
+
+/* load_md3_file() hands anything that is not IDP3 to these loaders. Each
+   reads the whole file, checks every block against the file size, and fills
+   md3FileData exactly as an MD3 would, so every writer and option applies.
+     MD2 (IDP2 v8, Quake II): one surface. Vertices are split per distinct
+       position/texcoord pair, byte positions are scaled and re-quantized.
+       Normals come from the 162-entry anorms table (out-of-range indices
+       fall back to normals recomputed from the triangles). Skins become
+       shaders.
+     MDC (IDPC v2, RtCW): frames are a base frame plus an optional
+       compressed offset (8 bits per axis, 0.05 units). The compressed
+       normal byte indexes RtCW's 256-entry table, which is not included,
+       so compressed frames get normals recomputed from their moved
+       positions. Tags are stored as angles and converted to axes.
+     MDR (RDM5 v2, skeletal): the first LOD is skinned on the CPU for every
+       frame and stored as vertex animation; tags follow their bone.
+       Compressed frames (negative ofsFrames) are not supported. */
+
+#pragma pack(push, 1)
+typedef struct {
+    char id[4];           // "IDP2"
+    int version;          // 8
+    int skinWidth, skinHeight;
+    int frameSize;
+    int numSkins, numXyz, numSt, numTris, numGlCmds, numFrames;
+    int ofsSkins, ofsSt, ofsTris, ofsFrames, ofsGlCmds, ofsEnd;
+} md2Header_t;
+
+typedef struct {
+    short s, t;
+} md2TexCoord_t;
+
+typedef struct {
+    short indexXyz[3];
+    short indexSt[3];
+} md2Triangle_t;
+
+typedef struct {
+    float scale[3];
+    float translate[3];
+    char name[16];
+} md2Frame_t;             // followed by numXyz md2Vertex_t
+
+typedef struct {
+    unsigned char v[3];
+    unsigned char normalIndex;
+} md2Vertex_t;
+
+typedef struct {
+    char id[4];           // "IDPC"
+    int version;          // 2
+    char name[64];
+    int flags;
+    int numFrames;
+    int numTags;
+    int numSurfaces;
+    int numSkins;
+    int ofsFrames;
+    int ofsTagNames;      // numTags names of 64 chars
+    int ofsTags;          // numFrames * numTags mdcTag_t
+    int ofsSurfaces;
+    int ofsEnd;
+} mdcHeader_t;
+
+typedef struct {
+    short xyz[3];         // MD3_XYZ_SCALE units
+    short angles[3];      // pitch, yaw, roll in MDC_TAG_ANGLE_SCALE units
+} mdcTag_t;
+
+typedef struct {
+    char id[4];           // "IDPC"
+    char name[64];
+    int flags;
+    int numCompFrames;
+    int numBaseFrames;
+    int numShaders;
+    int numVerts;
+    int numTriangles;
+    int ofsTriangles;
+    int ofsShaders;
+    int ofsSt;
+    int ofsXyzNormals;      // numBaseFrames * numVerts md3Vertex_t
+    int ofsXyzCompressed;   // numCompFrames * numVerts packed offsets
+    int ofsFrameBaseFrames; // numFrames shorts
+    int ofsFrameCompFrames; // numFrames shorts, -1 for none
+    int ofsEnd;
+} mdcSurface_t;
+
+typedef struct {
+    char id[4];           // "RDM5"
+    int version;          // 2
+    char name[64];
+    int numFrames;
+    int numBones;
+    int ofsFrames;        // negative for compressed frames
+    int numLODs;
+    int ofsLODs;
+    int numTags;
+    int ofsTags;
+    int ofsEnd;
+} mdrHeader_t;
+
+typedef struct {
+    float mins[3];
+    float maxs[3];
+    float localOrigin[3];
+    float radius;
+    char name[16];
+} mdrFrame_t;             // followed by numBones mdrBone_t
+
+typedef struct {
+    float matrix[3][4];
+} mdrBone_t;
+
+typedef struct {
+    int numSurfaces;
+    int ofsSurfaces;      // from the LOD start
+    int ofsEnd;
+} mdrLOD_t;
+
+typedef struct {
+    char id[4];           // "RDM5"
+    char name[64];
+    char shader[64];
+    int shaderIndex;
+    int ofsHeader;
+    int numVerts;
+    int ofsVerts;
+    int numTriangles;
+    int ofsTriangles;
+    int numBoneReferences;
+    int ofsBoneReferences;
+    int ofsEnd;
+} mdrSurface_t;
+
+typedef struct {
+    float normal[3];
+    float texCoords[2];
+    int numWeights;
+} mdrVertex_t;            // followed by numWeights mdrWeight_t
+
+typedef struct {
+    int boneIndex;
+    float boneWeight;
+    float offset[3];
+} mdrWeight_t;
+
+typedef struct {
+    int boneIndex;
+    char name[32];
+} mdrTag_t;
+#pragma pack(pop)
+
+#define MD2_VERSION 8
+#define MD2_NUM_NORMALS 162
+#define MDC_VERSION 2
+#define MDR_VERSION 2
+#define MDC_DIST_SCALE 0.05f
+#define MDC_MAX_OFS 127.0f
+#define MDC_TAG_ANGLE_SCALE (360.0f / 32700.0f)
+
+/* Returns data + offset when count elements of size fit in the file */
+const unsigned char *model_block(const unsigned char *data, long fileSize, long offset, long count, size_t size) {
+    if (offset < 0 || count < 0 || offset > fileSize) return NULL;
+    if (size > 0 && (unsigned long) count > (unsigned long)(fileSize - offset) / size) return NULL;
+    return data + offset;
+}
+
+/* Allocates the surface array and a zeroed frame block */
+int alloc_model(md3FileData *out, const char *name, int numFrames, int numTags, int numSurfaces) {
+    memset(&out->header, 0, sizeof(out->header));
+    memcpy(out->header.id, "IDP3", 4);
+    out->header.version = MD3_VERSION;
+    snprintf(out->header.name, sizeof(out->header.name), "%.63s", name);
+    out->header.numFrames = numFrames;
+    out->header.numTags = numTags;
+    out->header.numSurfaces = numSurfaces;
+    out->numSurfaces = numSurfaces;
+    out->surfaces = (md3SurfaceData*) calloc(numSurfaces > 0 ? numSurfaces : 1, sizeof(md3SurfaceData));
+    out->frames = (md3Frame_t*) calloc(numFrames > 0 ? numFrames : 1, sizeof(md3Frame_t));
+    if (numTags > 0) out->tags = (md3Tag_t*) calloc((size_t) numTags * numFrames, sizeof(md3Tag_t));
+    if (!out->surfaces || !out->frames || (numTags > 0 && !out->tags)) {
+        fprintf(stderr, "Memory allocation failed for model %s\n", name);
+        return 0;
+    }
+    return 1;
+}
+
+/* Allocates one surface's arrays */
+int alloc_surface(md3SurfaceData *surface, const char *name, int numFrames, int numVerts, int numTris, int numShaders) {
+    md3Surface_t *h = &surface->header;
+    memcpy(h->id, "IDP3", 4);
+    snprintf(h->name, sizeof(h->name), "%.63s", name);
+    h->numFrames = numFrames;
+    h->numVerts = numVerts;
+    h->numTriangles = numTris;
+    h->numShaders = numShaders;
+    surface->triangles = (md3Triangle_t*) malloc((size_t)(numTris > 0 ? numTris : 1) * sizeof(md3Triangle_t));
+    surface->texCoords = (md3TexCoord_t*) malloc((size_t)(numVerts > 0 ? numVerts : 1) * sizeof(md3TexCoord_t));
+    surface->vertices = (md3Vertex_t*) malloc((size_t)(numVerts > 0 ? numVerts : 1) * numFrames * sizeof(md3Vertex_t));
+    if (numShaders > 0) surface->shaders = (md3Shader_t*) calloc(numShaders, sizeof(md3Shader_t));
+    if (!surface->triangles || !surface->texCoords || !surface->vertices || (numShaders > 0 && !surface->shaders)) {
+        fprintf(stderr, "Memory allocation failed for surface %s\n", name);
+        return 0;
+    }
+    return 1;
+}
+
+/* Checks a surface's copied triangles against its vertex count */
+int surface_indexes_valid(const md3SurfaceData *surface) {
+    const int *index = &surface->triangles[0].indexes[0];
+    for (long i = 0; i < (long) surface->header.numTriangles * 3; i++) {
+        if ((unsigned int) index[i] >= (unsigned int) surface->header.numVerts) return 0;
+    }
+    return 1;
+}
+
+/* Quake II's anorms.h: the MD2 vertex normal for each normalIndex */
+static const float g_md2Normals[MD2_NUM_NORMALS][3] = {
+    { -0.525731f, 0.000000f, 0.850651f }, { -0.442863f, 0.238856f, 0.864188f }, { -0.295242f, 0.000000f, 0.955423f },
+    { -0.309017f, 0.500000f, 0.809017f }, { -0.162460f, 0.262866f, 0.951056f }, { 0.000000f, 0.000000f, 1.000000f },
+    { 0.000000f, 0.850651f, 0.525731f }, { -0.147621f, 0.716567f, 0.681718f }, { 0.147621f, 0.716567f, 0.681718f },
+    { 0.000000f, 0.525731f, 0.850651f }, { 0.309017f, 0.500000f, 0.809017f }, { 0.525731f, 0.000000f, 0.850651f },
+    { 0.295242f, 0.000000f, 0.955423f }, { 0.442863f, 0.238856f, 0.864188f }, { 0.162460f, 0.262866f, 0.951056f },
+    { -0.681718f, 0.147621f, 0.716567f }, { -0.809017f, 0.309017f, 0.500000f }, { -0.587785f, 0.425325f, 0.688191f },
+    { -0.850651f, 0.525731f, 0.000000f }, { -0.864188f, 0.442863f, 0.238856f }, { -0.716567f, 0.681718f, 0.147621f },
+    { -0.688191f, 0.587785f, 0.425325f }, { -0.500000f, 0.809017f, 0.309017f }, { -0.238856f, 0.864188f, 0.442863f },
+    { -0.425325f, 0.688191f, 0.587785f }, { -0.716567f, 0.681718f, -0.147621f }, { -0.500000f, 0.809017f, -0.309017f },
+    { -0.525731f, 0.850651f, 0.000000f }, { 0.000000f, 0.850651f, -0.525731f }, { -0.238856f, 0.864188f, -0.442863f },
+    { 0.000000f, 0.955423f, -0.295242f }, { -0.262866f, 0.951056f, -0.162460f }, { 0.000000f, 1.000000f, 0.000000f },
+    { 0.000000f, 0.955423f, 0.295242f }, { -0.262866f, 0.951056f, 0.162460f }, { 0.238856f, 0.864188f, 0.442863f },
+    { 0.262866f, 0.951056f, 0.162460f }, { 0.500000f, 0.809017f, 0.309017f }, { 0.238856f, 0.864188f, -0.442863f },
+    { 0.262866f, 0.951056f, -0.162460f }, { 0.500000f, 0.809017f, -0.309017f }, { 0.850651f, 0.525731f, 0.000000f },
+    { 0.716567f, 0.681718f, 0.147621f }, { 0.716567f, 0.681718f, -0.147621f }, { 0.525731f, 0.850651f, 0.000000f },
+    { 0.425325f, 0.688191f, 0.587785f }, { 0.864188f, 0.442863f, 0.238856f }, { 0.688191f, 0.587785f, 0.425325f },
+    { 0.809017f, 0.309017f, 0.500000f }, { 0.681718f, 0.147621f, 0.716567f }, { 0.587785f, 0.425325f, 0.688191f },
+    { 0.955423f, 0.295242f, 0.000000f }, { 1.000000f, 0.000000f, 0.000000f }, { 0.951056f, 0.162460f, 0.262866f },
+    { 0.850651f, -0.525731f, 0.000000f }, { 0.955423f, -0.295242f, 0.000000f }, { 0.864188f, -0.442863f, 0.238856f },
+    { 0.951056f, -0.162460f, 0.262866f }, { 0.809017f, -0.309017f, 0.500000f }, { 0.681718f, -0.147621f, 0.716567f },
+    { 0.850651f, 0.000000f, 0.525731f }, { 0.864188f, 0.442863f, -0.238856f }, { 0.809017f, 0.309017f, -0.500000f },
+    { 0.951056f, 0.162460f, -0.262866f }, { 0.525731f, 0.000000f, -0.850651f }, { 0.681718f, 0.147621f, -0.716567f },
+    { 0.681718f, -0.147621f, -0.716567f }, { 0.850651f, 0.000000f, -0.525731f }, { 0.809017f, -0.309017f, -0.500000f },
+    { 0.864188f, -0.442863f, -0.238856f }, { 0.951056f, -0.162460f, -0.262866f }, { 0.147621f, 0.716567f, -0.681718f },
+    { 0.309017f, 0.500000f, -0.809017f }, { 0.425325f, 0.688191f, -0.587785f }, { 0.442863f, 0.238856f, -0.864188f },
+    { 0.587785f, 0.425325f, -0.688191f }, { 0.688191f, 0.587785f, -0.425325f }, { -0.147621f, 0.716567f, -0.681718f },
+    { -0.309017f, 0.500000f, -0.809017f }, { 0.000000f, 0.525731f, -0.850651f }, { -0.525731f, 0.000000f, -0.850651f },
+    { -0.442863f, 0.238856f, -0.864188f }, { -0.295242f, 0.000000f, -0.955423f }, { -0.162460f, 0.262866f, -0.951056f },
+    { 0.000000f, 0.000000f, -1.000000f }, { 0.295242f, 0.000000f, -0.955423f }, { 0.162460f, 0.262866f, -0.951056f },
+    { -0.442863f, -0.238856f, -0.864188f }, { -0.309017f, -0.500000f, -0.809017f }, { -0.162460f, -0.262866f, -0.951056f },
+    { 0.000000f, -0.850651f, -0.525731f }, { -0.147621f, -0.716567f, -0.681718f }, { 0.147621f, -0.716567f, -0.681718f },
+    { 0.000000f, -0.525731f, -0.850651f }, { 0.309017f, -0.500000f, -0.809017f }, { 0.442863f, -0.238856f, -0.864188f },
+    { 0.162460f, -0.262866f, -0.951056f }, { 0.238856f, -0.864188f, -0.442863f }, { 0.500000f, -0.809017f, -0.309017f },
+    { 0.425325f, -0.688191f, -0.587785f }, { 0.716567f, -0.681718f, -0.147621f }, { 0.688191f, -0.587785f, -0.425325f },
+    { 0.587785f, -0.425325f, -0.688191f }, { 0.000000f, -0.955423f, -0.295242f }, { 0.000000f, -1.000000f, 0.000000f },
+    { 0.262866f, -0.951056f, -0.162460f }, { 0.000000f, -0.850651f, 0.525731f }, { 0.000000f, -0.955423f, 0.295242f },
+    { 0.238856f, -0.864188f, 0.442863f }, { 0.262866f, -0.951056f, 0.162460f }, { 0.500000f, -0.809017f, 0.309017f },
+    { 0.716567f, -0.681718f, 0.147621f }, { 0.525731f, -0.850651f, 0.000000f }, { -0.238856f, -0.864188f, -0.442863f },
+    { -0.500000f, -0.809017f, -0.309017f }, { -0.262866f, -0.951056f, -0.162460f }, { -0.850651f, -0.525731f, 0.000000f },
+    { -0.716567f, -0.681718f, -0.147621f }, { -0.716567f, -0.681718f, 0.147621f }, { -0.525731f, -0.850651f, 0.000000f },
+    { -0.500000f, -0.809017f, 0.309017f }, { -0.238856f, -0.864188f, 0.442863f }, { -0.262866f, -0.951056f, 0.162460f },
+    { -0.864188f, -0.442863f, 0.238856f }, { -0.809017f, -0.309017f, 0.500000f }, { -0.688191f, -0.587785f, 0.425325f },
+    { -0.681718f, -0.147621f, 0.716567f }, { -0.442863f, -0.238856f, 0.864188f }, { -0.587785f, -0.425325f, 0.688191f },
+    { -0.309017f, -0.500000f, 0.809017f }, { -0.147621f, -0.716567f, 0.681718f }, { -0.425325f, -0.688191f, 0.587785f },
+    { -0.162460f, -0.262866f, 0.951056f }, { 0.442863f, -0.238856f, 0.864188f }, { 0.162460f, -0.262866f, 0.951056f },
+    { 0.309017f, -0.500000f, 0.809017f }, { 0.147621f, -0.716567f, 0.681718f }, { 0.000000f, -0.525731f, 0.850651f },
+    { 0.425325f, -0.688191f, 0.587785f }, { 0.587785f, -0.425325f, 0.688191f }, { 0.688191f, -0.587785f, 0.425325f },
+    { -0.955423f, 0.295242f, 0.000000f }, { -0.951056f, 0.162460f, 0.262866f }, { -1.000000f, 0.000000f, 0.000000f },
+    { -0.850651f, 0.000000f, 0.525731f }, { -0.955423f, -0.295242f, 0.000000f }, { -0.951056f, -0.162460f, 0.262866f },
+    { -0.864188f, 0.442863f, -0.238856f }, { -0.951056f, 0.162460f, -0.262866f }, { -0.809017f, 0.309017f, -0.500000f },
+    { -0.864188f, -0.442863f, -0.238856f }, { -0.951056f, -0.162460f, -0.262866f }, { -0.809017f, -0.309017f, -0.500000f },
+    { -0.681718f, 0.147621f, -0.716567f }, { -0.681718f, -0.147621f, -0.716567f }, { -0.850651f, 0.000000f, -0.525731f },
+    { -0.688191f, 0.587785f, -0.425325f }, { -0.587785f, 0.425325f, -0.688191f }, { -0.425325f, 0.688191f, -0.587785f },
+    { -0.425325f, -0.688191f, -0.587785f }, { -0.587785f, -0.425325f, -0.688191f }, { -0.688191f, -0.587785f, -0.425325f }
+};
+
+/* Recomputes one frame's normals from its positions as area-weighted face
+   normals (MD3 winding is clockwise). Vertices split along texture seams
+   are smoothed separately. */
+int recompute_frame_normals(md3SurfaceData *surface, int frame) {
+    int numVerts = surface->header.numVerts;
+    float *normals = (float*) calloc((size_t)(numVerts > 0 ? numVerts : 1) * 3, sizeof(float));
+    if (!normals) {
+        fprintf(stderr, "Memory allocation failed for normals of surface %s.\n", surface->header.name);
+        return 0;
+    }
+    md3Vertex_t *verts = surface->vertices + (size_t) frame * numVerts;
+    for (int t = 0; t < surface->header.numTriangles; t++) {
+        const int *idx = surface->triangles[t].indexes;
+        const short *a = verts[idx[0]].xyz, *b = verts[idx[1]].xyz, *c = verts[idx[2]].xyz;
+        float e1[3] = { (float)(c[0] - a[0]), (float)(c[1] - a[1]), (float)(c[2] - a[2]) };
+        float e2[3] = { (float)(b[0] - a[0]), (float)(b[1] - a[1]), (float)(b[2] - a[2]) };
+        float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+        for (int k = 0; k < 3; k++) {
+            for (int i = 0; i < 3; i++) normals[idx[k] * 3 + i] += n[i];
+        }
+    }
+    for (int v = 0; v < numVerts; v++) {
+        const float *n = normals + v * 3;
+        verts[v].normal = n[0] * n[0] + n[1] * n[1] + n[2] * n[2] > 0.0f ? encodeNormal(n[0], n[1], n[2]) : 0;
+    }
+    free(normals);
+    return 1;
+}
+
+/* Grows a frame's bounds and squared radius (around the origin) by p */
+void frame_add_point(md3Frame_t *frame, const float *p, int first) {
+    float r2 = 0.0f;
+    for (int k = 0; k < 3; k++) {
+        if (first || p[k] < frame->mins[k]) frame->mins[k] = p[k];
+        if (first || p[k] > frame->maxs[k]) frame->maxs[k] = p[k];
+        r2 += p[k] * p[k];
+    }
+    if (r2 > frame->radius) frame->radius = r2;
+}
+
+int load_md2(const unsigned char *data, long fileSize, const char *filename, md3FileData *out) {
+    md2Header_t h;
+    memcpy(&h, data, sizeof(h));
+    if (h.version != MD2_VERSION || h.numFrames < 1 || h.numXyz < 1 || h.numTris < 1 || h.numSt < 1 ||
+        h.numSkins < 0 || h.frameSize < (long) sizeof(md2Frame_t) + (long) h.numXyz * (long) sizeof(md2Vertex_t) ||
+        h.skinWidth <= 0 || h.skinHeight <= 0 ||
+        !model_block(data, fileSize, h.ofsSkins, h.numSkins, 64) ||
+        !model_block(data, fileSize, h.ofsSt, h.numSt, sizeof(md2TexCoord_t)) ||
+        !model_block(data, fileSize, h.ofsTris, h.numTris, sizeof(md2Triangle_t)) ||
+        !model_block(data, fileSize, h.ofsFrames, h.numFrames, h.frameSize)) {
+        fprintf(stderr, "Invalid MD2 header in %s\n", filename);
+        return 0;
+    }
+    md2Triangle_t *tris = (md2Triangle_t*) malloc((size_t) h.numTris * sizeof(md2Triangle_t));
+    int *corners = (int*) malloc((size_t) h.numTris * 3 * 2 * sizeof(int));  // xyz, st per MD3 vertex
+    int *slots = (int*) malloc((size_t) h.numTris * 3 * 2 * sizeof(int));
+    float *pos = (float*) malloc((size_t) h.numXyz * 3 * sizeof(float));
+    int ok = tris && corners && slots && pos;
+    if (!ok) fprintf(stderr, "Memory allocation failed for %s\n", filename);
+    if (ok) memcpy(tris, data + h.ofsTris, (size_t) h.numTris * sizeof(md2Triangle_t));
+    /* MD3 vertices are distinct (xyz, st) pairs, numbered in first use */
+    size_t mask = 63;
+    while (mask + 1 < (size_t) h.numTris * 6) mask = mask * 2 + 1;
+    int *table = ok ? (int*) malloc((mask + 1) * sizeof(int)) : NULL;
+    int numVerts = 0;
+    if (ok && !table) {
+        fprintf(stderr, "Memory allocation failed for %s\n", filename);
+        ok = 0;
+    }
+    for (size_t i = 0; ok && i <= mask; i++) table[i] = -1;
+    for (int t = 0; ok && t < h.numTris; t++) {
+        for (int k = 0; k < 3; k++) {
+            int xyz = tris[t].indexXyz[k], st = tris[t].indexSt[k];
+            if (xyz < 0 || xyz >= h.numXyz || st < 0 || st >= h.numSt) {
+                fprintf(stderr, "Invalid MD2 triangle %d in %s\n", t, filename);
+                ok = 0;
+                break;
+            }
+            size_t i = ((unsigned int) xyz * 2654435761u ^ (unsigned int) st * 40503u) & mask;
+            while (table[i] != -1 && (corners[table[i] * 2] != xyz || corners[table[i] * 2 + 1] != st)) i = (i + 1) & mask;
+            if (table[i] == -1) {
+                table[i] = numVerts;
+                corners[numVerts * 2] = xyz;
+                corners[numVerts * 2 + 1] = st;
+                numVerts++;
+            }
+            slots[t * 3 + k] = table[i];
+        }
+    }
+    free(table);
+    char name[64];
+    getBasename(filename, name, sizeof(name));
+    ok = ok && alloc_model(out, name, h.numFrames, 0, 1) &&
+         alloc_surface(&out->surfaces[0], name, h.numFrames, numVerts, h.numTris, h.numSkins);
+    if (ok) {
+        md3SurfaceData *surface = &out->surfaces[0];
+        for (int s = 0; s < h.numSkins; s++) {
+            memcpy(surface->shaders[s].name, data + h.ofsSkins + (long) s * 64, 63);
+            surface->shaders[s].shaderIndex = s;
+        }
+        for (int t = 0; t < h.numTris; t++) {
+            for (int k = 0; k < 3; k++) surface->triangles[t].indexes[k] = slots[t * 3 + k];
+        }
+        for (int v = 0; v < numVerts; v++) {
+            md2TexCoord_t st;
+            memcpy(&st, data + h.ofsSt + (long) corners[v * 2 + 1] * sizeof(md2TexCoord_t), sizeof(st));
+            surface->texCoords[v].st[0] = (float) st.s / h.skinWidth;
+            surface->texCoords[v].st[1] = (float) st.t / h.skinHeight;
+        }
+        for (int f = 0; f < h.numFrames; f++) {
+            const unsigned char *block = data + h.ofsFrames + (long) f * h.frameSize;
+            md2Frame_t frame;
+            memcpy(&frame, block, sizeof(frame));
+            const md2Vertex_t *src = (const md2Vertex_t*)(block + sizeof(md2Frame_t));
+            for (int x = 0; x < h.numXyz; x++) {
+                for (int k = 0; k < 3; k++) pos[x * 3 + k] = src[x].v[k] * frame.scale[k] + frame.translate[k];
+            }
+            md3Frame_t *md3Frame = &out->frames[f];
+            memcpy(md3Frame->name, frame.name, sizeof(frame.name) - 1);
+            md3Vertex_t *dst = surface->vertices + (size_t) f * numVerts;
+            int badNormals = 0;
+            for (int v = 0; v < numVerts; v++) {
+                const float *p = pos + corners[v * 2] * 3;
+                float q[3];
+                for (int k = 0; k < 3; k++) {
+                    dst[v].xyz[k] = quantizePosition(p[k]);
+                    q[k] = dst[v].xyz[k] * MD3_XYZ_SCALE;
+                }
+                frame_add_point(md3Frame, q, v == 0);
+                badNormals |= src[corners[v * 2]].normalIndex >= MD2_NUM_NORMALS;
+            }
+            md3Frame->radius = sqrtf(md3Frame->radius);
+            /* Out-of-range indices keep the geometric normal */
+            if (badNormals && !recompute_frame_normals(surface, f)) {
+                ok = 0;
+                break;
+            }
+            for (int v = 0; v < numVerts; v++) {
+                int n = src[corners[v * 2]].normalIndex;
+                if (n < MD2_NUM_NORMALS) dst[v].normal = encodeNormal(g_md2Normals[n][0], g_md2Normals[n][1], g_md2Normals[n][2]);
+            }
+        }
+    }
+    free(tris);
+    free(corners);
+    free(slots);
+    free(pos);
+    return ok;
+}
+
+/* Quake 3's AnglesToAxis(): pitch, yaw, roll in degrees */
+void angles_to_axis(const float *angles, float axis[3][3]) {
+    float sp = sinf(angles[0] * (float) M_PI / 180.0f), cp = cosf(angles[0] * (float) M_PI / 180.0f);
+    float sy = sinf(angles[1] * (float) M_PI / 180.0f), cy = cosf(angles[1] * (float) M_PI / 180.0f);
+    float sr = sinf(angles[2] * (float) M_PI / 180.0f), cr = cosf(angles[2] * (float) M_PI / 180.0f);
+    axis[0][0] = cp * cy;
+    axis[0][1] = cp * sy;
+    axis[0][2] = -sp;
+    /* axis[1] is left, the negated right vector */
+    axis[1][0] = sr * sp * cy - cr * sy;
+    axis[1][1] = sr * sp * sy + cr * cy;
+    axis[1][2] = sr * cp;
+    axis[2][0] = cr * sp * cy + sr * sy;
+    axis[2][1] = cr * sp * sy - sr * cy;
+    axis[2][2] = cr * cp;
+}
+
+int load_mdc(const unsigned char *data, long fileSize, const char *filename, md3FileData *out) {
+    mdcHeader_t h;
+    memcpy(&h, data, sizeof(h));
+    if (h.version != MDC_VERSION || h.numFrames < 1 || h.numTags < 0 || h.numSurfaces < 0 ||
+        !model_block(data, fileSize, h.ofsFrames, h.numFrames, sizeof(md3Frame_t)) ||
+        !model_block(data, fileSize, h.ofsTagNames, h.numTags, 64) ||
+        !model_block(data, fileSize, h.ofsTags, (long) h.numTags * h.numFrames, sizeof(mdcTag_t)) ||
+        /* Each surface needs at least its header, which bounds the allocation */
+        !model_block(data, fileSize, 0, h.numSurfaces, sizeof(mdcSurface_t))) {
+        fprintf(stderr, "Invalid MDC header in %s\n", filename);
+        return 0;
+    }
+    if (!alloc_model(out, h.name, h.numFrames, h.numTags, h.numSurfaces)) return 0;
+    memcpy(out->frames, data + h.ofsFrames, (size_t) h.numFrames * sizeof(md3Frame_t));
+    for (int f = 0; f < h.numFrames; f++) {
+        for (int t = 0; t < h.numTags; t++) {
+            mdcTag_t src;
+            md3Tag_t *dst = &out->tags[(size_t) f * h.numTags + t];
+            memcpy(&src, data + h.ofsTags + ((long) f * h.numTags + t) * sizeof(mdcTag_t), sizeof(src));
+            memcpy(dst->name, data + h.ofsTagNames + (long) t * 64, 63);
+            float angles[3];
+            for (int k = 0; k < 3; k++) {
+                dst->origin[k] = src.xyz[k] * MD3_XYZ_SCALE;
+                angles[k] = src.angles[k] * MDC_TAG_ANGLE_SCALE;
+            }
+            angles_to_axis(angles, dst->axis);
+        }
+    }
+    long offset = h.ofsSurfaces;
+    for (int s = 0; s < h.numSurfaces; s++) {
+        mdcSurface_t sh;
+        const unsigned char *base = model_block(data, fileSize, offset, 1, sizeof(sh));
+        if (!base) {
+            fprintf(stderr, "Invalid MDC surface %d in %s\n", s, filename);
+            return 0;
+        }
+        memcpy(&sh, base, sizeof(sh));
+        if (sh.numVerts < 0 || sh.numTriangles < 0 || sh.numShaders < 0 || sh.numBaseFrames < 1 || sh.numCompFrames < 0 ||
+            sh.ofsEnd <= 0 ||
+            !model_block(data, fileSize, offset + sh.ofsTriangles, sh.numTriangles, sizeof(md3Triangle_t)) ||
+            !model_block(data, fileSize, offset + sh.ofsShaders, sh.numShaders, sizeof(md3Shader_t)) ||
+            !model_block(data, fileSize, offset + sh.ofsSt, sh.numVerts, sizeof(md3TexCoord_t)) ||
+            !model_block(data, fileSize, offset + sh.ofsXyzNormals, (long) sh.numVerts * sh.numBaseFrames, sizeof(md3Vertex_t)) ||
+            !model_block(data, fileSize, offset + sh.ofsXyzCompressed, (long) sh.numVerts * sh.numCompFrames, sizeof(unsigned int)) ||
+            !model_block(data, fileSize, offset + sh.ofsFrameBaseFrames, h.numFrames, sizeof(short)) ||
+            !model_block(data, fileSize, offset + sh.ofsFrameCompFrames, h.numFrames, sizeof(short))) {
+            fprintf(stderr, "Invalid MDC surface %d in %s\n", s, filename);
+            return 0;
+        }
+        md3SurfaceData *surface = &out->surfaces[s];
+        if (!alloc_surface(surface, sh.name, h.numFrames, sh.numVerts, sh.numTriangles, sh.numShaders)) return 0;
+        memcpy(surface->triangles, base + sh.ofsTriangles, (size_t) sh.numTriangles * sizeof(md3Triangle_t));
+        if (!surface_indexes_valid(surface)) {
+            fprintf(stderr, "Invalid MDC triangle index in surface %s of %s\n", sh.name, filename);
+            return 0;
+        }
+        if (sh.numShaders > 0) memcpy(surface->shaders, base + sh.ofsShaders, (size_t) sh.numShaders * sizeof(md3Shader_t));
+        memcpy(surface->texCoords, base + sh.ofsSt, (size_t) sh.numVerts * sizeof(md3TexCoord_t));
+        for (int f = 0; f < h.numFrames; f++) {
+            short baseFrame, compFrame;
+            memcpy(&baseFrame, base + sh.ofsFrameBaseFrames + f * sizeof(short), sizeof(short));
+            memcpy(&compFrame, base + sh.ofsFrameCompFrames + f * sizeof(short), sizeof(short));
+            if (baseFrame < 0 || baseFrame >= sh.numBaseFrames || compFrame >= sh.numCompFrames) {
+                fprintf(stderr, "Invalid MDC frame %d of surface %s in %s\n", f, sh.name, filename);
+                return 0;
+            }
+            md3Vertex_t *dst = surface->vertices + (size_t) f * sh.numVerts;
+            memcpy(dst, base + sh.ofsXyzNormals + (long) baseFrame * sh.numVerts * sizeof(md3Vertex_t), (size_t) sh.numVerts * sizeof(md3Vertex_t));
+            if (compFrame < 0) continue;
+            const unsigned char *packed = base + sh.ofsXyzCompressed + (long) compFrame * sh.numVerts * sizeof(unsigned int);
+            for (int v = 0; v < sh.numVerts; v++) {
+                unsigned int ofsVec;
+                memcpy(&ofsVec, packed + (size_t) v * sizeof(unsigned int), sizeof(ofsVec));
+                for (int k = 0; k < 3; k++) {
+                    float delta = ((float)((ofsVec >> (8 * k)) & 255) - MDC_MAX_OFS) * MDC_DIST_SCALE;
+                    dst[v].xyz[k] = quantizePosition(dst[v].xyz[k] * MD3_XYZ_SCALE + delta);
+                }
+            }
+            /* The compressed normal byte needs RtCW's table; rebuild instead */
+            if (!recompute_frame_normals(surface, f)) return 0;
+        }
+        offset += sh.ofsEnd;
+    }
+    return 1;
+}
+
+int load_mdr(const unsigned char *data, long fileSize, const char *filename, md3FileData *out) {
+    mdrHeader_t h;
+    memcpy(&h, data, sizeof(h));
+    if (h.ofsFrames < 0) {
+        fprintf(stderr, "%s uses compressed MDR frames, which are not supported\n", filename);
+        return 0;
+    }
+    size_t frameSize = sizeof(mdrFrame_t) + (size_t) h.numBones * sizeof(mdrBone_t);
+    mdrLOD_t lod;
+    const unsigned char *lodBase = model_block(data, fileSize, h.ofsLODs, 1, sizeof(lod));
+    if (h.version != MDR_VERSION || h.numFrames < 1 || h.numBones < 1 || h.numLODs < 1 || h.numTags < 0 || !lodBase ||
+        !model_block(data, fileSize, h.ofsFrames, h.numFrames, frameSize) ||
+        !model_block(data, fileSize, h.ofsTags, h.numTags, sizeof(mdrTag_t))) {
+        fprintf(stderr, "Invalid MDR header in %s\n", filename);
+        return 0;
+    }
+    memcpy(&lod, lodBase, sizeof(lod));
+    if (!model_block(data, fileSize, 0, lod.numSurfaces, sizeof(mdrSurface_t))) {
+        fprintf(stderr, "Invalid MDR surface count in %s\n", filename);
+        return 0;
+    }
+    if (!alloc_model(out, h.name, h.numFrames, h.numTags, lod.numSurfaces)) return 0;
+    mdrBone_t *bones = (mdrBone_t*) malloc((size_t) h.numBones * sizeof(mdrBone_t));
+    if (!bones) {
+        fprintf(stderr, "Memory allocation failed for %s\n", filename);
+        return 0;
+    }
+    int ok = 1;
+    /* Frame blocks and tags; each tag is its bone's matrix */
+    for (int f = 0; f < h.numFrames; f++) {
+        const unsigned char *block = data + h.ofsFrames + (long) f * frameSize;
+        mdrFrame_t frame;
+        memcpy(&frame, block, sizeof(frame));
+        md3Frame_t *dst = &out->frames[f];
+        memcpy(dst->mins, frame.mins, sizeof(dst->mins));
+        memcpy(dst->maxs, frame.maxs, sizeof(dst->maxs));
+        memcpy(dst->localOrigin, frame.localOrigin, sizeof(dst->localOrigin));
+        dst->radius = frame.radius;
+        memcpy(dst->name, frame.name, sizeof(dst->name) - 1);
+        memcpy(bones, block + sizeof(mdrFrame_t), (size_t) h.numBones * sizeof(mdrBone_t));
+        for (int t = 0; ok && t < h.numTags; t++) {
+            mdrTag_t tag;
+            memcpy(&tag, data + h.ofsTags + (long) t * sizeof(mdrTag_t), sizeof(tag));
+            if (tag.boneIndex < 0 || tag.boneIndex >= h.numBones) {
+                fprintf(stderr, "Invalid MDR tag %d in %s\n", t, filename);
+                ok = 0;
+                break;
+            }
+            md3Tag_t *md3Tag = &out->tags[(size_t) f * h.numTags + t];
+            memcpy(md3Tag->name, tag.name, sizeof(tag.name) - 1);
+            for (int k = 0; k < 3; k++) {
+                md3Tag->origin[k] = bones[tag.boneIndex].matrix[k][3];
+                for (int i = 0; i < 3; i++) md3Tag->axis[i][k] = bones[tag.boneIndex].matrix[k][i];
+            }
+        }
+    }
+    /* Skin every vertex of the first LOD in every frame */
+    long offset = (long) h.ofsLODs + lod.ofsSurfaces;
+    for (int s = 0; ok && s < lod.numSurfaces; s++) {
+        mdrSurface_t sh;
+        const unsigned char *base = model_block(data, fileSize, offset, 1, sizeof(sh));
+        if (base) memcpy(&sh, base, sizeof(sh));
+        if (!base || sh.numVerts < 0 || sh.numTriangles < 0 || sh.ofsEnd <= 0 ||
+            !model_block(data, fileSize, offset + sh.ofsTriangles, sh.numTriangles, sizeof(md3Triangle_t)) ||
+            !model_block(data, fileSize, offset + sh.ofsVerts, sh.numVerts, sizeof(mdrVertex_t))) {
+            fprintf(stderr, "Invalid MDR surface %d in %s\n", s, filename);
+            ok = 0;
+            break;
+        }
+        md3SurfaceData *surface = &out->surfaces[s];
+        if (!alloc_surface(surface, sh.name, h.numFrames, sh.numVerts, sh.numTriangles, 1)) {
+            ok = 0;
+            break;
+        }
+        memcpy(surface->shaders[0].name, sh.shader, sizeof(sh.shader) - 1);
+        memcpy(surface->triangles, base + sh.ofsTriangles, (size_t) sh.numTriangles * sizeof(md3Triangle_t));
+        if (!surface_indexes_valid(surface)) {
+            fprintf(stderr, "Invalid MDR triangle index in surface %s of %s\n", sh.name, filename);
+            ok = 0;
+            break;
+        }
+        for (int f = 0; ok && f < h.numFrames; f++) {
+            memcpy(bones, data + h.ofsFrames + (long) f * frameSize + sizeof(mdrFrame_t), (size_t) h.numBones * sizeof(mdrBone_t));
+            long vertOffset = offset + sh.ofsVerts;
+            md3Vertex_t *dst = surface->vertices + (size_t) f * sh.numVerts;
+            for (int v = 0; v < sh.numVerts; v++) {
+                mdrVertex_t vert;
+                const unsigned char *vp = model_block(data, fileSize, vertOffset, 1, sizeof(vert));
+                if (vp) memcpy(&vert, vp, sizeof(vert));
+                const unsigned char *wp = vp ? model_block(data, fileSize, vertOffset + sizeof(vert), vert.numWeights, sizeof(mdrWeight_t)) : NULL;
+                if (!wp) {
+                    fprintf(stderr, "Invalid MDR vertex %d of surface %s in %s\n", v, sh.name, filename);
+                    ok = 0;
+                    break;
+                }
+                float p[3] = { 0.0f, 0.0f, 0.0f }, n[3] = { 0.0f, 0.0f, 0.0f };
+                for (int w = 0; w < vert.numWeights; w++) {
+                    mdrWeight_t weight;
+                    memcpy(&weight, wp + (size_t) w * sizeof(weight), sizeof(weight));
+                    if (weight.boneIndex < 0 || weight.boneIndex >= h.numBones) {
+                        fprintf(stderr, "Invalid MDR bone index in surface %s of %s\n", sh.name, filename);
+                        ok = 0;
+                        break;
+                    }
+                    const mdrBone_t *bone = &bones[weight.boneIndex];
+                    for (int k = 0; k < 3; k++) {
+                        const float *m = bone->matrix[k];
+                        p[k] += weight.boneWeight * (m[0] * weight.offset[0] + m[1] * weight.offset[1] + m[2] * weight.offset[2] + m[3]);
+                        n[k] += weight.boneWeight * (m[0] * vert.normal[0] + m[1] * vert.normal[1] + m[2] * vert.normal[2]);
+                    }
+                }
+                if (!ok) break;
+                for (int k = 0; k < 3; k++) dst[v].xyz[k] = quantizePosition(p[k]);
+                dst[v].normal = n[0] * n[0] + n[1] * n[1] + n[2] * n[2] > 0.0f ? encodeNormal(n[0], n[1], n[2]) : 0;
+                if (f == 0) {
+                    surface->texCoords[v].st[0] = vert.texCoords[0];
+                    surface->texCoords[v].st[1] = vert.texCoords[1];
+                }
+                vertOffset += sizeof(vert) + (long) vert.numWeights * sizeof(mdrWeight_t);
+            }
+        }
+        offset += sh.ofsEnd;
+    }
+    free(bones);
+    return ok;
+}
+
+/* Dispatches a non-MD3 model held in memory on its magic */
+int load_other_model(const unsigned char *data, long fileSize, const char *filename, md3FileData *fileData) {
+    if (fileSize >= (long) sizeof(md2Header_t) && memcmp(data, "IDP2", 4) == 0) {
+        return load_md2(data, fileSize, filename, fileData);
+    } else if (fileSize >= (long) sizeof(mdcHeader_t) && memcmp(data, "IDPC", 4) == 0) {
+        return load_mdc(data, fileSize, filename, fileData);
+    } else if (fileSize >= (long) sizeof(mdrHeader_t) && memcmp(data, "RDM5", 4) == 0) {
+        return load_mdr(data, fileSize, filename, fileData);
+    }
+    fprintf(stderr, "Invalid MD3 file format or version.\n");
+    return 0;
+}
+
+/* --- End Other Model Formats --- */
+
+/* --- MD3 Validation --- */
+
+/* An MD3 is read into memory in one go and checked by validate_md3() in a
+   single pass: header counts, every block offset and size against the file
+   (in long arithmetic, so count * size cannot overflow), the surface chain,
+   and every triangle index against its surface's vertex count. Everything
+   after it, from read_md3_surfaces() to the emit loops, then indexes the
+   data without further checks. */
+
+/* Which optional blocks validate_md3() found usable */
+typedef struct {
+    int framesOk;
+    int tagsOk;
+} md3Validation;
+
+/* Validates the MD3 image in data. Damaged frame and tag blocks are reported
+   in result and a damaged shader block is dropped by zeroing the surface's
+   numShaders in data, as conversion works without them; anything else
+   rejects the file. */
+int validate_md3(unsigned char *data, long fileSize, const char *filename, md3Validation *result) {
+    md3Header_t header;
+    result->framesOk = result->tagsOk = 0;
+    if (fileSize < (long) sizeof(md3Header_t)) {
+        fprintf(stderr, "%s: file too small for an MD3 header.\n", filename);
+        return 0;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (strncmp(header.id, "IDP3", 4) != 0 || header.version != MD3_VERSION) {
+        fprintf(stderr, "Invalid MD3 file format or version.\n");
+        return 0;
+    }
+    if ((long) header.ofsEnd > fileSize) {
+        fprintf(stderr, "File appears truncated (ofsEnd exceeds file size).\n");
+        return 0;
+    }
+    if (header.numFrames < 1 || header.numTags < 0 || header.numSurfaces < 0) {
+        fprintf(stderr, "%s: invalid counts (%d frames, %d tags, %d surfaces).\n",
+                filename, header.numFrames, header.numTags, header.numSurfaces);
+        return 0;
+    }
+    result->framesOk = model_block(data, fileSize, header.ofsFrames, header.numFrames, sizeof(md3Frame_t)) != NULL;
+    if (!result->framesOk) {
+        fprintf(stderr, "%s: frame block out of range, ignoring it.\n", filename);
+    }
+    result->tagsOk = header.numTags > 0 &&
+                     model_block(data, fileSize, header.ofsTags, (long) header.numTags * header.numFrames, sizeof(md3Tag_t)) != NULL;
+    if (header.numTags > 0 && !result->tagsOk) {
+        fprintf(stderr, "Error reading tags for %s\n", filename);
+    }
+    long offset = header.ofsSurfaces;
+    for (int s = 0; s < header.numSurfaces; s++) {
+        md3Surface_t h;
+        if (!model_block(data, fileSize, offset, 1, sizeof(md3Surface_t))) {
+            fprintf(stderr, "%s: surface %d header out of range.\n", filename, s);
+            return 0;
+        }
+        memcpy(&h, data + offset, sizeof(h));
+        if (strncmp(h.id, "IDP3", 4) != 0) {
+            fprintf(stderr, "Invalid surface id at surface %d.\n", s);
+            return 0;
+        }
+        if (h.numFrames != header.numFrames || h.numVerts < 0 || h.numTriangles < 0 || h.numShaders < 0) {
+            fprintf(stderr, "%s: surface %.64s has invalid counts (%d frames, %d vertices, %d triangles, %d shaders).\n",
+                    filename, h.name, h.numFrames, h.numVerts, h.numTriangles, h.numShaders);
+            return 0;
+        }
+        const unsigned char *tris = model_block(data, fileSize, offset + h.ofsTriangles, h.numTriangles, sizeof(md3Triangle_t));
+        if (!tris ||
+            !model_block(data, fileSize, offset + h.ofsST, h.numVerts, sizeof(md3TexCoord_t)) ||
+            !model_block(data, fileSize, offset + h.ofsVerts, (long) h.numVerts * h.numFrames, sizeof(md3Vertex_t))) {
+            fprintf(stderr, "%s: surface %.64s has a block outside the file.\n", filename, h.name);
+            return 0;
+        }
+        for (long i = 0; i < (long) h.numTriangles * 3; i++) {
+            int index;
+            memcpy(&index, tris + i * sizeof(int), sizeof(index));
+            if ((unsigned int) index >= (unsigned int) h.numVerts) {
+                fprintf(stderr, "%s: surface %.64s triangle %ld has vertex index %d of %d.\n",
+                        filename, h.name, i / 3, index, h.numVerts);
+                return 0;
+            }
+        }
+        if (h.numShaders > 0 && !model_block(data, fileSize, offset + h.ofsShaders, h.numShaders, sizeof(md3Shader_t))) {
+            fprintf(stderr, "Error reading shaders for surface %.64s, ignoring them.\n", h.name);
+            h.numShaders = 0;
+            memcpy(data + offset, &h, sizeof(h));
+        }
+        if (h.ofsEnd <= 0 || !model_block(data, fileSize, offset, h.ofsEnd, 1)) {
+            fprintf(stderr, "%s: surface %.64s has an invalid end offset %d.\n", filename, h.name, h.ofsEnd);
+            return 0;
+        }
+        offset += h.ofsEnd;
+    }
+    return 1;
+}
+
+/* Copies all surfaces out of an MD3 image that passed validate_md3() */
+md3SurfaceData *read_md3_surfaces(const unsigned char *data, const md3Header_t *header, int *numSurfacesOut) {
+    int numSurfaces = header->numSurfaces;
+    md3SurfaceData *surfaces = (md3SurfaceData*) calloc(numSurfaces > 0 ? numSurfaces : 1, sizeof(md3SurfaceData));
+    if (!surfaces) {
+        fprintf(stderr, "Memory allocation failed for surfaces.\n");
+        return NULL;
+    }
+    const unsigned char *surfaceStart = data + header->ofsSurfaces;
+    for (int s = 0; s < numSurfaces; s++) {
+        md3SurfaceData *surface = &surfaces[s];
+        md3Surface_t *h = &surface->header;
+        memcpy(h, surfaceStart, sizeof(md3Surface_t));
+        size_t triSize = (size_t) h->numTriangles * sizeof(md3Triangle_t);
+        size_t tcSize = (size_t) h->numVerts * sizeof(md3TexCoord_t);
+        size_t vertSize = (size_t) h->numVerts * h->numFrames * sizeof(md3Vertex_t);
+        size_t shaderSize = (size_t) h->numShaders * sizeof(md3Shader_t);
+        surface->triangles = (md3Triangle_t*) malloc(triSize > 0 ? triSize : 1);
+        surface->texCoords = (md3TexCoord_t*) malloc(tcSize > 0 ? tcSize : 1);
+        surface->vertices = (md3Vertex_t*) malloc(vertSize > 0 ? vertSize : 1);
+        /* Shader references feed -mtl, -rewrite and -iqm */
+        if (shaderSize > 0) surface->shaders = (md3Shader_t*) malloc(shaderSize);
+        if (!surface->triangles || !surface->texCoords || !surface->vertices || (shaderSize > 0 && !surface->shaders)) {
+            fprintf(stderr, "Memory allocation failed for surface %s.\n", h->name);
+            free_surfaces(surfaces, s + 1);
+            return NULL;
+        }
+        memcpy(surface->triangles, surfaceStart + h->ofsTriangles, triSize);
+        memcpy(surface->texCoords, surfaceStart + h->ofsST, tcSize);
+        memcpy(surface->vertices, surfaceStart + h->ofsVerts, vertSize);
+        if (shaderSize > 0) memcpy(surface->shaders, surfaceStart + h->ofsShaders, shaderSize);
+        surfaceStart += h->ofsEnd;
+    }
+    *numSurfacesOut = numSurfaces;
+    return surfaces;
+}
+
+/* --- End MD3 Validation --- */
+
+/* --- New Merge Mode Functions --- */
+
+/* Frees everything load_md3_file() allocated */
+void free_md3_file(md3FileData *fileData) {
+    if (fileData->surfaces) {
+        free_surfaces(fileData->surfaces, fileData->numSurfaces);
+    }
+    free(fileData->tags);
+    free(fileData->frames);
+    fileData->surfaces = NULL;
+    fileData->tags = NULL;
+    fileData->frames = NULL;
+}
+
+/* Parses a model held in memory: an MD3 is validated, then its header,
+   tags, frames and surfaces are copied out; other formats are converted.
+   data may be modified (see validate_md3). This is the whole parser behind
+   load_md3_file(), so tests/fuzz_loader.c drives it directly. */
+int load_model_buffer(unsigned char *data, long fileSize, const char *filename, md3FileData *fileData) {
+    md3Clock clock;
+    if (fileSize < 4 || memcmp(data, "IDP3", 4) != 0) {
+        stats_begin(&clock);
+        int loaded = fileSize >= 4 && load_other_model(data, fileSize, filename, fileData);
+        if (fileSize < 4) fprintf(stderr, "Error reading %s\n", filename);
+        stats_end(STAT_SURFACES, &clock);
+        return loaded;
+    }
+    md3Validation valid;
+    stats_begin(&clock);
+    int headerOk = validate_md3(data, fileSize, filename, &valid);
+    stats_end(STAT_HEADER, &clock);
+    if (!headerOk) return 0;
+    memcpy(&fileData->header, data, sizeof(md3Header_t));
+    stats_begin(&clock);
+    /* Tags for every frame, frame 0's first; frame block (bounds, local
+       origin, radius); both optional for conversion */
+    fileData->tags = NULL;
+    fileData->frames = NULL;
+    if (valid.tagsOk) {
+        size_t tagsSize = (size_t) fileData->header.numTags * fileData->header.numFrames * sizeof(md3Tag_t);
+        fileData->tags = (md3Tag_t*) malloc(tagsSize);
+        if (fileData->tags) {
+            memcpy(fileData->tags, data + fileData->header.ofsTags, tagsSize);
+        } else {
+            fprintf(stderr, "Memory allocation failed for tags in %s\n", filename);
+        }
+    }
+    if (valid.framesOk) {
+        size_t framesSize = (size_t) fileData->header.numFrames * sizeof(md3Frame_t);
+        fileData->frames = (md3Frame_t*) malloc(framesSize);
+        if (fileData->frames) {
+            memcpy(fileData->frames, data + fileData->header.ofsFrames, framesSize);
+        } else {
+            fprintf(stderr, "Memory allocation failed for frames in %s\n", filename);
+        }
+    }
+    fileData->surfaces = read_md3_surfaces(data, &fileData->header, &fileData->numSurfaces);
+    stats_end(STAT_SURFACES, &clock);
+    return fileData->surfaces != NULL;
+}
+
+/* Reads a model file in one read and parses it with load_model_buffer() */
+int load_md3_file(const char *filename, md3FileData *fileData) {
+    FILE *fp = fopen(filename, "rb");
+    if (!fp) {
+        fprintf(stderr, "Error opening file %s: %s\n", filename, strerror(errno));
+        return 0;
+    }
+    long fileSize = getFileSize(fp);
+    if (fileSize < 0) {
+        fclose(fp);
+        return 0;
+    }
+    stats_file_begin(filename);
+    md3Clock clock;
+    stats_begin(&clock);
+    unsigned char *data = (unsigned char*) malloc(fileSize > 0 ? (size_t) fileSize : 1);
+    if (!data) {
+        fprintf(stderr, "Memory allocation failed for %s\n", filename);
+    }
+    int readOk = data && read_from_offset(fp, 0, data, (size_t) fileSize, fileSize);
+    fclose(fp);
+    stats_end(STAT_HEADER, &clock);
+    int loaded = readOk && load_model_buffer(data, fileSize, filename, fileData);
+    free(data);
+    stats_file_end(&fileData->header, loaded ? fileData->surfaces : NULL, loaded ? fileData->numSurfaces : 0);
+    return loaded;
+}
+
+/* Writes a merged OBJ file from multiple MD3 files (only first frame used).
+   For each file, the vertex positions and normals are transformed using the
+   first tag's transformation (if available). */
+int write_merged_obj(md3FileData *files, int numFiles, const char *outputName) {
+    md3Clock clock;
+    stats_frame_begin(0, outputName);
+    stats_begin(&clock);
+    FILE *outFile = fopen(outputName, "w");
+    stats_end(STAT_WRITE, &clock);
+    if (!outFile) {
+        fprintf(stderr, "Error opening output file %s: %s\n", outputName, strerror(errno));
+        stats_frame_end();
+        return 0;
+    }
+    if (g_mtlLib) fprintf(outFile, "mtllib %s\n", g_mtlLib);
+    fprintf(outFile, "o MergedMD3\n");
+    
+    /* Scratch x/y/z buffers sized for the largest surface */
+    int maxVerts = 1;
+    for (int f = 0; f < numFiles; f++) {
+        for (int s = 0; s < files[f].numSurfaces; s++) {
+            if (files[f].surfaces[s].header.numVerts > maxVerts) maxVerts = files[f].surfaces[s].header.numVerts;
+        }
+    }
+    float *xyz = (float*) malloc((size_t)maxVerts * 3 * sizeof(float));
+    if (!xyz) {
+        fprintf(stderr, "Memory allocation failed for vertex buffer.\n");
+        fclose(outFile);
+        return 0;
+    }
+    float *x = xyz, *y = xyz + maxVerts, *z = xyz + 2 * maxVerts;
+
+    /* First pass: write vertex positions and compute global base indices */
+    int globalIndex = 1;
+    for (int f = 0; f < numFiles; f++) {
+        md3FileData *mfile = &files[f];
+        for (int s = 0; s < mfile->numSurfaces; s++) {
+            mfile->surfaces[s].baseIndex = globalIndex;
+            int numVerts = mfile->surfaces[s].header.numVerts;
+            stats_begin(&clock);
+            decode_positions(mfile->surfaces[s].vertices, numVerts, 0, x, y, z);  // first frame only
+            if (mfile->tags) {
+                // Apply full transformation: rotated then translated
+                transform_points(x, y, z, numVerts, &mfile->tags[0], 1);
+            }
+            stats_end(STAT_DECODE, &clock);
+            stats_begin(&clock);
+            const float *py = g_swapYZ ? z : y, *pz = g_swapYZ ? y : z;
+            for (int v = 0; v < numVerts; v++) {
+                if (fprintf(outFile, "v %f %f %f\n", x[v], py[v], pz[v]) < 0) {
+                    fprintf(stderr, "Error writing vertex to %s\n", outputName);
+                    free(xyz);
+                    fclose(outFile);
+                    return 0;
+                }
+            }
+            stats_end(STAT_FORMAT, &clock);
+            globalIndex += numVerts;
+        }
+    }
+    
+    /* Second pass: write texture coordinates */  
+    const objEmitters_t *emit = select_obj_emitters(g_flipUVs, g_swapYZ);
+    for (int f = 0; f < numFiles; f++) {
+        if (!emit->texcoords(outFile, files[f].surfaces, files[f].numSurfaces, outputName)) {
+            free(xyz);
+            fclose(outFile);
+            return 0;
+        }
+    }
+    
+    /* Third pass: write vertex normals */  
+    for (int f = 0; f < numFiles; f++) {
+        md3FileData *mfile = &files[f];
+        for (int s = 0; s < mfile->numSurfaces; s++) {
             int numVerts = mfile->surfaces[s].header.numVerts;
+            stats_begin(&clock);
+            decode_normals(mfile->surfaces[s].vertices, numVerts, x, y, z);
+            if (mfile->tags) {
+                transform_points(x, y, z, numVerts, &mfile->tags[0], 0);
+            }
+            stats_end(STAT_DECODE, &clock);
+            stats_begin(&clock);
+            const float *py = g_swapYZ ? z : y, *pz = g_swapYZ ? y : z;
+            for (int v = 0; v < numVerts; v++) {
+                if (fprintf(outFile, "vn %f %f %f\n", x[v], py[v], pz[v]) < 0) {
+                    fprintf(stderr, "Error writing normal to %s\n", outputName);
+                    free(xyz);
+                    fclose(outFile);
+                    return 0;
+                }
+            }
+            stats_end(STAT_FORMAT, &clock);
+        }
+    }
+    free(xyz);
+    
+    /* Fourth pass: write face definitions for each surface */  
+    for (int f = 0; f < numFiles; f++) {
+        if (!emit->faces(outFile, files[f].surfaces, files[f].numSurfaces, 0, outputName)) {
+            fclose(outFile);
+            return 0;
+        }
+        stats_add_geometry(files[f].surfaces, files[f].numSurfaces);
+    }
+    stats_begin(&clock);
+    long bytes = ftell(outFile);
+    int closed = fclose(outFile) == 0;
+    stats_end(STAT_WRITE, &clock);
+    stats_add_bytes_written(bytes);
+    stats_frame_end();
+    return closed;
+}
+
+/* --- End Merge Mode Functions --- */
+
+/* --- Frame Bounds (-bounds) --- */
+
+/* Tight bounds are recomputed from the decoded vertices, frames split across
+   threads, and compared with the md3Frame_t block. Everything is in MD3
+   model space (before -swapYZ). Stored positions are quantized to 1/64, so
+   differences up to one quantization step are tolerated. The header AABB is
+   flagged if it is off in either direction; the header radius (around
+   localOrigin) only if it is too small, since tools commonly store the
+   looser radius of the AABB corner. */
+
+#define BOUNDS_TOLERANCE MD3_XYZ_SCALE
+
+typedef struct {
+    float mins[3];
+    float maxs[3];
+    float center[3];      // AABB center
+    float radius;         // sphere around center
+    float originRadius;   // sphere around the header's localOrigin
+    int hasVerts;
+    int mismatch;
+} md3FrameBounds;
+
+typedef struct {
+    const md3FileData *model;
+    md3FrameBounds *bounds;
+    int maxVerts;
+} boundsJob;
+
+void compute_frame_bounds_range(void *ctx, int begin, int end) {
+    boundsJob *job = (boundsJob*) ctx;
+    const md3FileData *model = job->model;
+    float *xyz = (float*) malloc((size_t) job->maxVerts * 3 * sizeof(float));
+    if (!xyz) {
+        /* Leave the range marked empty; the caller reports it */
+        for (int f = begin; f < end; f++) job->bounds[f].hasVerts = -1;
+        return;
+    }
+    float *x = xyz, *y = xyz + job->maxVerts, *z = xyz + 2 * job->maxVerts;
+    for (int f = begin; f < end; f++) {
+        md3FrameBounds *b = &job->bounds[f];
+        const float *origin = model->frames ? model->frames[f].localOrigin : NULL;
+        float originRadius2 = 0.0f;
+        memset(b, 0, sizeof(*b));
+        for (int s = 0; s < model->numSurfaces; s++) {
+            const md3SurfaceData *surface = &model->surfaces[s];
+            int numVerts = surface->header.numVerts;
+            decode_positions(surface->vertices + (size_t) f * numVerts, numVerts, 0, x, y, z);
+            for (int v = 0; v < numVerts; v++) {
+                float p[3] = { x[v], y[v], z[v] };
+                for (int k = 0; k < 3; k++) {
+                    if (!b->hasVerts || p[k] < b->mins[k]) b->mins[k] = p[k];
+                    if (!b->hasVerts || p[k] > b->maxs[k]) b->maxs[k] = p[k];
+                }
+                b->hasVerts = 1;
+                if (origin) {
+                    float dx = p[0] - origin[0], dy = p[1] - origin[1], dz = p[2] - origin[2];
+                    float d2 = dx * dx + dy * dy + dz * dz;
+                    if (d2 > originRadius2) originRadius2 = d2;
+                }
+            }
+        }
+        for (int k = 0; k < 3; k++) b->center[k] = (b->mins[k] + b->maxs[k]) * 0.5f;
+        /* Second pass for the sphere around the AABB center */
+        float radius2 = 0.0f;
+        for (int s = 0; s < model->numSurfaces; s++) {
+            const md3SurfaceData *surface = &model->surfaces[s];
+            int numVerts = surface->header.numVerts;
+            decode_positions(surface->vertices + (size_t) f * numVerts, numVerts, 0, x, y, z);
+            for (int v = 0; v < numVerts; v++) {
+                float dx = x[v] - b->center[0], dy = y[v] - b->center[1], dz = z[v] - b->center[2];
+                float d2 = dx * dx + dy * dy + dz * dz;
+                if (d2 > radius2) radius2 = d2;
+            }
+        }
+        b->radius = sqrtf(radius2);
+        b->originRadius = sqrtf(originRadius2);
+        if (model->frames && b->hasVerts) {
+            const md3Frame_t *h = &model->frames[f];
+            for (int k = 0; k < 3; k++) {
+                if (fabsf(h->mins[k] - b->mins[k]) > BOUNDS_TOLERANCE ||
+                    fabsf(h->maxs[k] - b->maxs[k]) > BOUNDS_TOLERANCE) {
+                    b->mismatch = 1;
+                }
+            }
+            if (h->radius < b->originRadius - BOUNDS_TOLERANCE) b->mismatch = 1;
+        }
+    }
+    free(xyz);
+}
+
+void write_json_vec3(FILE *fp, const float *v) {
+    fprintf(fp, "[%f, %f, %f]", v[0], v[1], v[2]);
+}
+
+/* Writes header and recomputed bounds for every frame as JSON */
+int write_bounds_json(const char *path, const md3FileData *model) {
+    int numFrames = model->header.numFrames;
+    md3FrameBounds *bounds = (md3FrameBounds*) calloc(numFrames > 0 ? numFrames : 1, sizeof(md3FrameBounds));
+    if (!bounds) {
+        fprintf(stderr, "Memory allocation failed for frame bounds.\n");
+        return 0;
+    }
+    boundsJob job;
+    job.model = model;
+    job.bounds = bounds;
+    job.maxVerts = 1;
+    for (int s = 0; s < model->numSurfaces; s++) {
+        if (model->surfaces[s].header.numVerts > job.maxVerts) job.maxVerts = model->surfaces[s].header.numVerts;
+    }
+    md3Clock clock;
+    stats_begin(&clock);
+    run_parallel(numFrames, compute_frame_bounds_range, &job);
+    stats_end(STAT_DECODE, &clock);
+    for (int f = 0; f < numFrames; f++) {
+        if (bounds[f].hasVerts < 0) {
+            fprintf(stderr, "Memory allocation failed for vertex buffer.\n");
+            free(bounds);
+            return 0;
+        }
+    }
+
+    stats_begin(&clock);
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        fprintf(stderr, "Error opening output file %s: %s\n", path, strerror(errno));
+        free(bounds);
+        return 0;
+    }
+    int mismatched = 0;
+    fprintf(fp, "{\n  \"model\": ");
+    stats_json_stringn(fp, model->header.name, sizeof(model->header.name));
+    fprintf(fp, ",\n  \"tolerance\": %f,\n  \"frames\": [\n", BOUNDS_TOLERANCE);
+    for (int f = 0; f < numFrames; f++) {
+        const md3FrameBounds *b = &bounds[f];
+        fprintf(fp, "    {\n      \"index\": %d,\n", f);
+        if (model->frames) {
+            const md3Frame_t *h = &model->frames[f];
+            fprintf(fp, "      \"name\": ");
+            stats_json_stringn(fp, h->name, sizeof(h->name));
+            fprintf(fp, ",\n      \"header\": {\"mins\": ");
+            write_json_vec3(fp, h->mins);
+            fprintf(fp, ", \"maxs\": ");
+            write_json_vec3(fp, h->maxs);
+            fprintf(fp, ", \"localOrigin\": ");
+            write_json_vec3(fp, h->localOrigin);
+            fprintf(fp, ", \"radius\": %f},\n", h->radius);
+        } else {
+            fprintf(fp, "      \"header\": null,\n");
+        }
+        fprintf(fp, "      \"computed\": {\"mins\": ");
+        write_json_vec3(fp, b->mins);
+        fprintf(fp, ", \"maxs\": ");
+        write_json_vec3(fp, b->maxs);
+        fprintf(fp, ", \"center\": ");
+        write_json_vec3(fp, b->center);
+        fprintf(fp, ", \"radius\": %f, \"originRadius\": %f},\n", b->radius, b->originRadius);
+        fprintf(fp, "      \"mismatch\": %s\n    }%s\n", b->mismatch ? "true" : "false", f + 1 < numFrames ? "," : "");
+        if (b->mismatch) {
+            printf("Frame %d: header bounds do not match the vertices\n", f);
+            mismatched++;
+        }
+    }
+    fprintf(fp, "  ],\n  \"mismatchedFrames\": %d\n}\n", mismatched);
+    long written = ftell(fp);
+    free(bounds);
+    if (fclose(fp) != 0) {
+        fprintf(stderr, "Failed writing %s\n", path);
+        return 0;
+    }
+    stats_add_bytes_written(written);
+    stats_end(STAT_WRITE, &clock);
+    return 1;
+}
+
+/* --- End Frame Bounds --- */
+
+/* --- Tag Tracks (-tags) --- */
+
+/* Writes every tag's origin and axis for every frame as one track per tag.
+   A path ending in .csv gets one row per frame and tag; anything else gets
+   JSON. The tags come from the single read of the ofsTags block in
+   load_md3_file, after -frames, -resample, -keyframes and -stripTags. */
+
+/* Writes at most maxLen chars of str as a CSV field, quoted per RFC 4180
+   when it holds a comma, quote or line break */
+void write_csv_field(FILE *fp, const char *str, size_t maxLen) {
+    size_t len = 0;
+    while (len < maxLen && str[len]) len++;
+    int quote = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (str[i] == ',' || str[i] == '"' || str[i] == '\r' || str[i] == '\n') quote = 1;
+    }
+    if (!quote) {
+        fwrite(str, 1, len, fp);
+        return;
+    }
+    fputc('"', fp);
+    for (size_t i = 0; i < len; i++) {
+        if (str[i] == '"') fputc('"', fp);
+        fputc(str[i], fp);
+    }
+    fputc('"', fp);
+}
+
+int write_tag_tracks(const char *path, const md3FileData *model, double fps) {
+    int numFrames = model->header.numFrames;
+    int numTags = model->tags ? model->header.numTags : 0;
+    size_t len = strlen(path);
+    int csv = len >= 4 && strcmp(path + len - 4, ".csv") == 0;
+    md3Clock clock;
+    stats_begin(&clock);
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        fprintf(stderr, "Error opening output file %s: %s\n", path, strerror(errno));
+        return 0;
+    }
+    if (csv) {
+        fprintf(fp, "frame,tag,origin_x,origin_y,origin_z,"
+                    "axis0_x,axis0_y,axis0_z,axis1_x,axis1_y,axis1_z,axis2_x,axis2_y,axis2_z\n");
+        for (int f = 0; f < numFrames; f++) {
+            for (int t = 0; t < numTags; t++) {
+                const md3Tag_t *tag = &model->tags[(size_t) f * numTags + t];
+                const float *a = &tag->axis[0][0];
+                fprintf(fp, "%d,", f);
+                write_csv_field(fp, tag->name, sizeof(tag->name));
+                fprintf(fp, ",%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f\n",
+                        tag->origin[0], tag->origin[1], tag->origin[2],
+                        a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7], a[8]);
+            }
+        }
+    } else {
+        fprintf(fp, "{\n  \"model\": ");
+        stats_json_stringn(fp, model->header.name, sizeof(model->header.name));
+        fprintf(fp, ",\n  \"fps\": %f,\n  \"numFrames\": %d,\n  \"tags\": [\n", fps, numFrames);
+        for (int t = 0; t < numTags; t++) {
+            fprintf(fp, "    {\n      \"name\": ");
+            stats_json_stringn(fp, model->tags[t].name, sizeof(model->tags[t].name));
+            fprintf(fp, ",\n      \"frames\": [\n");
+            for (int f = 0; f < numFrames; f++) {
+                const md3Tag_t *tag = &model->tags[(size_t) f * numTags + t];
+                fprintf(fp, "        {\"origin\": ");
+                write_json_vec3(fp, tag->origin);
+                fprintf(fp, ", \"axis\": [");
+                for (int k = 0; k < 3; k++) {
+                    write_json_vec3(fp, tag->axis[k]);
+                    fprintf(fp, k < 2 ? ", " : "]}");
+                }
+                fprintf(fp, "%s\n", f + 1 < numFrames ? "," : "");
+            }
+            fprintf(fp, "      ]\n    }%s\n", t + 1 < numTags ? "," : "");
+        }
+        fprintf(fp, "  ]\n}\n");
+    }
+    long written = ftell(fp);
+    if (fclose(fp) != 0) {
+        fprintf(stderr, "Failed writing %s\n", path);
+        return 0;
+    }
+    stats_add_bytes_written(written);
+    stats_end(STAT_WRITE, &clock);
+    printf("Wrote %d tag track(s) of %d frames to %s\n", numTags, numFrames, path);
+    return 1;
+}
+
+/* --- End Tag Tracks --- */
+
+/* --- Animation Resampling (-resample) --- */
+
+/* Resamples the animation to a new frame count. Output frame i samples the
+   source at time i * numFrames / newCount (in source frames), so the clip
+   keeps its duration; samples past the last frame hold it. Positions are
+   interpolated linearly and re-quantized, normals are interpolated as
+   vectors, re-normalized and re-packed with encodeNormal(), and tags with
+   resample_tag(). Output frames are independent and computed in parallel. */
+
+typedef struct {
+    const md3FileData *model;
+    md3Vertex_t **outVertices;  // per surface, newCount * numVerts
+    md3Frame_t *outFrames;      // NULL if the model has no frame block
+    md3Tag_t *outTags;          // NULL if the model has no tags
+    int newCount;
+} resampleJob;
+
+/* Interpolates a tag: origin linearly, axes as vectors re-orthonormalized
+   (Gram-Schmidt in axis order) */
+void resample_tag(const md3Tag_t *ta, const md3Tag_t *tb, float alpha, md3Tag_t *out) {
+    *out = *ta;
+    for (int k = 0; k < 3; k++) {
+        out->origin[k] = ta->origin[k] + (tb->origin[k] - ta->origin[k]) * alpha;
+    }
+    if (alpha == 0.0f) return;
+    float axis[3][3];
+    for (int i = 0; i < 3; i++) {
+        for (int k = 0; k < 3; k++) axis[i][k] = ta->axis[i][k] + (tb->axis[i][k] - ta->axis[i][k]) * alpha;
+        for (int j = 0; j < i; j++) {
+            float d = axis[i][0] * axis[j][0] + axis[i][1] * axis[j][1] + axis[i][2] * axis[j][2];
+            for (int k = 0; k < 3; k++) axis[i][k] -= d * axis[j][k];
+        }
+        float len = sqrtf(axis[i][0] * axis[i][0] + axis[i][1] * axis[i][1] + axis[i][2] * axis[i][2]);
+        /* Degenerate blends (opposite axes) keep the earlier frame's tag */
+        if (len < 1e-6f) return;
+        for (int k = 0; k < 3; k++) axis[i][k] /= len;
+    }
+    memcpy(out->axis, axis, sizeof(axis));
+}
+
+void resample_frames_range(void *ctx, int begin, int end) {
+    resampleJob *job = (resampleJob*) ctx;
+    const md3FileData *model = job->model;
+    int numFrames = model->header.numFrames;
+    for (int i = begin; i < end; i++) {
+        double t = (double) i * numFrames / job->newCount;
+        int a = (int) t;
+        if (a > numFrames - 1) a = numFrames - 1;
+        int b = a + 1 < numFrames ? a + 1 : a;
+        float alpha = b > a ? (float)(t - a) : 0.0f;
+        float mins[3] = { 0.0f, 0.0f, 0.0f }, maxs[3] = { 0.0f, 0.0f, 0.0f };
+        int haveBounds = 0;
+        for (int s = 0; s < model->numSurfaces; s++) {
+            const md3SurfaceData *surface = &model->surfaces[s];
+            int numVerts = surface->header.numVerts;
+            const md3Vertex_t *va = surface->vertices + (size_t) a * numVerts;
+            const md3Vertex_t *vb = surface->vertices + (size_t) b * numVerts;
+            md3Vertex_t *out = job->outVertices[s] + (size_t) i * numVerts;
             for (int v = 0; v < numVerts; v++) {
-                int idx = 0 * numVerts + v;  // first frame only
-                md3Vertex_t vert = mfile->surfaces[s].vertices[idx];
-                float vx = vert.xyz[0] * MD3_XYZ_SCALE;
-                float vy = vert.xyz[1] * MD3_XYZ_SCALE;
-                float vz = vert.xyz[2] * MD3_XYZ_SCALE;
-                float tx, ty, tz;
-                if (mfile->tags) {
-                    // Apply full transformation: rotated then translated
-                    tx = mfile->tags[0].origin[0] +
-                         mfile->tags[0].axis[0][0]*vx + mfile->tags[0].axis[0][1]*vy + mfile->tags[0].axis[0][2]*vz;
-                    ty = mfile->tags[0].origin[1] +
-                         mfile->tags[0].axis[1][0]*vx + mfile->tags[0].axis[1][1]*vy + mfile->tags[0].axis[1][2]*vz;
-                    tz = mfile->tags[0].origin[2] +
-                         mfile->tags[0].axis[2][0]*vx + mfile->tags[0].axis[2][1]*vy + mfile->tags[0].axis[2][2]*vz;
+                for (int k = 0; k < 3; k++) {
+                    float pa = va[v].xyz[k] * MD3_XYZ_SCALE, pb = vb[v].xyz[k] * MD3_XYZ_SCALE;
+                    out[v].xyz[k] = quantizePosition(pa + (pb - pa) * alpha);
+                    float p = out[v].xyz[k] * MD3_XYZ_SCALE;
+                    if (!haveBounds || p < mins[k]) mins[k] = p;
+                    if (!haveBounds || p > maxs[k]) maxs[k] = p;
+                }
+                haveBounds = 1;
+                if (va[v].normal == vb[v].normal || alpha == 0.0f) {
+                    out[v].normal = va[v].normal;
+                    continue;
+                }
+                float na[3], nb[3];
+                decodeNormal(va[v].normal, &na[0], &na[1], &na[2]);
+                decodeNormal(vb[v].normal, &nb[0], &nb[1], &nb[2]);
+                float n[3];
+                for (int k = 0; k < 3; k++) n[k] = na[k] + (nb[k] - na[k]) * alpha;
+                /* Opposite normals cancel out; keep the earlier one then */
+                if (n[0] * n[0] + n[1] * n[1] + n[2] * n[2] < 1e-12f) {
+                    out[v].normal = va[v].normal;
                 } else {
-                    tx = vx; ty = vy; tz = vz;
+                    out[v].normal = encodeNormal(n[0], n[1], n[2]);
                 }
-                if (g_swapYZ) { float temp = ty; ty = tz; tz = temp; }
-                if (fprintf(outFile, "v %f %f %f\n", tx, ty, tz) < 0) {
-                    fprintf(stderr, "Error writing vertex to %s\n", outputName);
-                    fclose(outFile);
-                    return 0;
+            }
+        }
+        if (job->outFrames) {
+            const md3Frame_t *fa = &model->frames[a], *fb = &model->frames[b];
+            md3Frame_t *f = &job->outFrames[i];
+            *f = *fa;
+            float radius2 = 0.0f;
+            for (int k = 0; k < 3; k++) {
+                f->localOrigin[k] = fa->localOrigin[k] + (fb->localOrigin[k] - fa->localOrigin[k]) * alpha;
+                f->mins[k] = mins[k];
+                f->maxs[k] = maxs[k];
+                /* The farthest AABB corner bounds every vertex */
+                float d = fabsf(mins[k] - f->localOrigin[k]) > fabsf(maxs[k] - f->localOrigin[k]) ?
+                          mins[k] - f->localOrigin[k] : maxs[k] - f->localOrigin[k];
+                radius2 += d * d;
+            }
+            f->radius = sqrtf(radius2);
+        }
+        if (job->outTags) {
+            int numTags = model->header.numTags;
+            for (int t = 0; t < numTags; t++) {
+                resample_tag(&model->tags[(size_t) a * numTags + t], &model->tags[(size_t) b * numTags + t],
+                             alpha, &job->outTags[(size_t) i * numTags + t]);
+            }
+        }
+    }
+}
+
+/* Replaces the model's frames with newCount resampled ones */
+int resample_frames(md3FileData *model, int newCount) {
+    int numSurfaces = model->numSurfaces;
+    resampleJob job;
+    job.model = model;
+    job.newCount = newCount;
+    job.outFrames = NULL;
+    job.outTags = NULL;
+    job.outVertices = (md3Vertex_t**) calloc(numSurfaces > 0 ? numSurfaces : 1, sizeof(md3Vertex_t*));
+    int ok = job.outVertices != NULL;
+    for (int s = 0; ok && s < numSurfaces; s++) {
+        size_t count = (size_t) model->surfaces[s].header.numVerts * newCount;
+        job.outVertices[s] = (md3Vertex_t*) malloc((count > 0 ? count : 1) * sizeof(md3Vertex_t));
+        ok = job.outVertices[s] != NULL;
+    }
+    if (ok && model->frames) {
+        job.outFrames = (md3Frame_t*) malloc(newCount * sizeof(md3Frame_t));
+        ok = job.outFrames != NULL;
+    }
+    if (ok && model->tags) {
+        job.outTags = (md3Tag_t*) malloc((size_t) model->header.numTags * newCount * sizeof(md3Tag_t));
+        ok = job.outTags != NULL;
+    }
+    if (!ok) {
+        fprintf(stderr, "Memory allocation failed for resampling.\n");
+        for (int s = 0; job.outVertices && s < numSurfaces; s++) free(job.outVertices[s]);
+        free(job.outVertices);
+        free(job.outFrames);
+        free(job.outTags);
+        return 0;
+    }
+    md3Clock clock;
+    stats_begin(&clock);
+    run_parallel(newCount, resample_frames_range, &job);
+    stats_end(STAT_DECODE, &clock);
+    printf("Resampled %d frames to %d\n", model->header.numFrames, newCount);
+    for (int s = 0; s < numSurfaces; s++) {
+        free(model->surfaces[s].vertices);
+        model->surfaces[s].vertices = job.outVertices[s];
+        model->surfaces[s].header.numFrames = newCount;
+    }
+    if (model->frames) {
+        free(model->frames);
+        model->frames = job.outFrames;
+    }
+    if (model->tags) {
+        free(model->tags);
+        model->tags = job.outTags;
+    }
+    model->header.numFrames = newCount;
+    free(job.outVertices);
+    return 1;
+}
+
+/* --- End Animation Resampling --- */
+
+/* --- Keyframe Reduction (-keyframes) --- */
+
+/* Frames that linear interpolation between their neighbours reproduces
+   within a tolerance are dropped. A frame can only go if every frame in the
+   span between the remaining keys stays within tolerance, so the error
+   never accumulates over removals. The cheapest removable frame goes first
+   (greedy, like Douglas-Peucker run bottom-up). The error is the largest
+   vertex distance in model units; normals are not considered, since the
+   renderer interpolates them along with the positions. */
+
+typedef struct {
+    const float *pos;       // numFrames * totalVerts * 3 decoded positions
+    int totalVerts;
+    const int *prevKey, *nextKey;
+    double *cost;
+} keyframeJob;
+
+/* Largest deviation of frames strictly between keys a and b from the
+   linear interpolation of a and b */
+double keyframe_span_error(const float *pos, int totalVerts, int a, int b) {
+    size_t stride = (size_t) totalVerts * 3;
+    const float *pa = pos + (size_t) a * stride, *pb = pos + (size_t) b * stride;
+    double worst = 0.0;
+    for (int f = a + 1; f < b; f++) {
+        double t = (double)(f - a) / (b - a);
+        const float *pf = pos + (size_t) f * stride;
+        for (size_t i = 0; i < stride; i += 3) {
+            double d2 = 0.0;
+            for (int k = 0; k < 3; k++) {
+                double d = pf[i + k] - (pa[i + k] + (pb[i + k] - pa[i + k]) * t);
+                d2 += d * d;
+            }
+            if (d2 > worst) worst = d2;
+        }
+    }
+    return sqrt(worst);
+}
+
+void keyframe_costs_range(void *ctx, int begin, int end) {
+    keyframeJob *job = (keyframeJob*) ctx;
+    for (int f = begin; f < end; f++) {
+        if (job->prevKey[f] >= 0 && job->nextKey[f] >= 0) {
+            job->cost[f] = keyframe_span_error(job->pos, job->totalVerts, job->prevKey[f], job->nextKey[f]);
+        }
+    }
+}
+
+/* Keeps only the listed frames (ascending source indices), compacting
+   vertices, the frame block and tags in place */
+void compact_frames(md3FileData *model, const int *sourceFrames, int kept) {
+    for (int s = 0; s < model->numSurfaces; s++) {
+        md3SurfaceData *surface = &model->surfaces[s];
+        int numVerts = surface->header.numVerts;
+        for (int k = 0; k < kept; k++) {
+            memmove(surface->vertices + (size_t) k * numVerts,
+                    surface->vertices + (size_t) sourceFrames[k] * numVerts,
+                    (size_t) numVerts * sizeof(md3Vertex_t));
+        }
+        surface->header.numFrames = kept;
+    }
+    if (model->frames) {
+        for (int k = 0; k < kept; k++) model->frames[k] = model->frames[sourceFrames[k]];
+    }
+    if (model->tags) {
+        int numTags = model->header.numTags;
+        for (int k = 0; k < kept; k++) {
+            memmove(model->tags + (size_t) k * numTags, model->tags + (size_t) sourceFrames[k] * numTags,
+                    (size_t) numTags * sizeof(md3Tag_t));
+        }
+    }
+    model->header.numFrames = kept;
+}
+
+/* Drops redundant frames from the model in place. sourceFrames receives
+   the original index of each kept frame; returns the kept count, 0 on error. */
+int reduce_keyframes(md3FileData *model, double tolerance, int *sourceFrames) {
+    int numFrames = model->header.numFrames;
+    int totalVerts = 0;
+    for (int s = 0; s < model->numSurfaces; s++) totalVerts += model->surfaces[s].header.numVerts;
+    size_t stride = (size_t) totalVerts * 3;
+    float *pos = (float*) malloc((stride > 0 ? stride : 1) * numFrames * sizeof(float));
+    int *prevKey = (int*) malloc(numFrames * sizeof(int));
+    int *nextKey = (int*) malloc(numFrames * sizeof(int));
+    double *cost = (double*) malloc(numFrames * sizeof(double));
+    if (!pos || !prevKey || !nextKey || !cost) {
+        fprintf(stderr, "Memory allocation failed for keyframe reduction.\n");
+        free(pos);
+        free(prevKey);
+        free(nextKey);
+        free(cost);
+        return 0;
+    }
+    md3Clock clock;
+    stats_begin(&clock);
+    for (int f = 0; f < numFrames; f++) {
+        float *dst = pos + (size_t) f * stride;
+        for (int s = 0; s < model->numSurfaces; s++) {
+            const md3SurfaceData *surface = &model->surfaces[s];
+            int numVerts = surface->header.numVerts;
+            const md3Vertex_t *src = surface->vertices + (size_t) f * numVerts;
+            for (int v = 0; v < numVerts; v++, dst += 3) {
+                dst[0] = src[v].xyz[0] * MD3_XYZ_SCALE;
+                dst[1] = src[v].xyz[1] * MD3_XYZ_SCALE;
+                dst[2] = src[v].xyz[2] * MD3_XYZ_SCALE;
+            }
+        }
+    }
+    stats_end(STAT_DECODE, &clock);
+    /* First and last frames are always kept */
+    for (int f = 0; f < numFrames; f++) {
+        prevKey[f] = f > 0 && f + 1 < numFrames ? f - 1 : -1;
+        nextKey[f] = f > 0 && f + 1 < numFrames ? f + 1 : -1;
+        cost[f] = HUGE_VAL;
+    }
+    keyframeJob job = { pos, totalVerts, prevKey, nextKey, cost };
+    run_parallel(numFrames, keyframe_costs_range, &job);
+    int kept = numFrames;
+    for (;;) {
+        int best = -1;
+        for (int f = 1; f + 1 < numFrames; f++) {
+            if (prevKey[f] >= 0 && cost[f] <= tolerance && (best < 0 || cost[f] < cost[best])) best = f;
+        }
+        if (best < 0) break;
+        int a = prevKey[best], b = nextKey[best];
+        prevKey[best] = nextKey[best] = -1;
+        kept--;
+        if (a > 0) {
+            nextKey[a] = b;
+            cost[a] = keyframe_span_error(pos, totalVerts, prevKey[a], b);
+        }
+        if (b + 1 < numFrames) {
+            prevKey[b] = a;
+            cost[b] = keyframe_span_error(pos, totalVerts, a, nextKey[b]);
+        }
+    }
+    int out = 0;
+    for (int f = 0; f < numFrames; f++) {
+        if (f == 0 || f + 1 == numFrames || prevKey[f] >= 0) sourceFrames[out++] = f;
+    }
+    free(pos);
+    free(prevKey);
+    free(nextKey);
+    free(cost);
+
+    compact_frames(model, sourceFrames, kept);
+    printf("Keyframes: kept %d of %d frames (tolerance %g)\n", kept, numFrames, tolerance);
+    return kept;
+}
+
+/* Writes keyframe timing: each kept frame's source index, start time and
+   how long it is held before interpolating to the next one */
+int write_keyframe_json(const char *path, const int *sourceFrames, int kept, int numSourceFrames, double fps, double tolerance) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        fprintf(stderr, "Error opening output file %s: %s\n", path, strerror(errno));
+        return 0;
+    }
+    fprintf(fp, "{\n  \"fps\": %g,\n  \"tolerance\": %g,\n  \"sourceFrames\": %d,\n  \"duration\": %f,\n  \"keyframes\": [\n",
+            fps, tolerance, numSourceFrames, numSourceFrames / fps);
+    for (int k = 0; k < kept; k++) {
+        int next = k + 1 < kept ? sourceFrames[k + 1] : numSourceFrames;
+        fprintf(fp, "    {\"frame\": %d, \"sourceFrame\": %d, \"time\": %f, \"duration\": %f}%s\n",
+                k, sourceFrames[k], sourceFrames[k] / fps, (next - sourceFrames[k]) / fps, k + 1 < kept ? "," : "");
+    }
+    fprintf(fp, "  ]\n}\n");
+    long written = ftell(fp);
+    if (fclose(fp) != 0) {
+        fprintf(stderr, "Failed writing %s\n", path);
+        return 0;
+    }
+    stats_add_bytes_written(written);
+    return 1;
+}
+
+/* --- End Keyframe Reduction --- */
+
+/* --- Animation Delta Compression (-anim) --- */
+
+/* Encoder for the MD3A format described in md3anim.h; md3anim.c holds the
+   matching decoder for runtimes. */
+
+typedef struct {
+    unsigned char *data;
+    size_t size, cap;
+} animBuffer;
+
+int anim_buffer_reserve(animBuffer *buf, size_t extra) {
+    if (buf->size + extra <= buf->cap) return 1;
+    size_t cap = buf->cap ? buf->cap : 4096;
+    while (cap < buf->size + extra) cap *= 2;
+    unsigned char *data = (unsigned char*) realloc(buf->data, cap);
+    if (!data) return 0;
+    buf->data = data;
+    buf->cap = cap;
+    return 1;
+}
+
+void anim_put_u16(animBuffer *buf, unsigned int value) {
+    buf->data[buf->size++] = (unsigned char)(value & 0xff);
+    buf->data[buf->size++] = (unsigned char)((value >> 8) & 0xff);
+}
+
+void anim_put_u32(unsigned char *p, unsigned int value) {
+    p[0] = (unsigned char)(value & 0xff);
+    p[1] = (unsigned char)((value >> 8) & 0xff);
+    p[2] = (unsigned char)((value >> 16) & 0xff);
+    p[3] = (unsigned char)((value >> 24) & 0xff);
+}
+
+/* Appends an unsigned LEB128 varint (at most 5 bytes) */
+void anim_put_uvarint(animBuffer *buf, unsigned int value) {
+    while (value >= 0x80) {
+        buf->data[buf->size++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    buf->data[buf->size++] = (unsigned char) value;
+}
+
+/* Frame values go through a zero-run coder: non-zero values are written as
+   zigzag varints, a run of zeros as token 0 followed by the run length */
+void anim_flush_zeros(animBuffer *buf, unsigned int *zeroRun) {
+    if (*zeroRun > 0) {
+        anim_put_uvarint(buf, 0);
+        anim_put_uvarint(buf, *zeroRun);
+        *zeroRun = 0;
+    }
+}
+
+void anim_put_value(animBuffer *buf, unsigned int *zeroRun, int value) {
+    if (value == 0) {
+        (*zeroRun)++;
+        return;
+    }
+    anim_flush_zeros(buf, zeroRun);
+    anim_put_uvarint(buf, ((unsigned int) value << 1) ^ (unsigned int)(value >> 31));
+}
+
+/* Delta to move a reconstructed coordinate toward the source in multiples
+   of step, kept within the int16 range the decoder accumulates in */
+int anim_quantize_delta(int source, int decoded, int step) {
+    int diff = source - decoded;
+    int delta = diff >= 0 ? (diff + step / 2) / step : -((-diff + step / 2) / step);
+    while (decoded + delta * step > 32767) delta--;
+    while (decoded + delta * step < -32768) delta++;
+    return delta;
+}
+
+/* Appends one surface (frame table + frame data) to the file image in out */
+int encode_anim_surface(const md3SurfaceData *surface, int numFrames, int step, animBuffer *out) {
+    int numVerts = surface->header.numVerts;
+    size_t tableBytes = ((size_t) numFrames + 1) * 4;
+    short *decoded = (short*) malloc((size_t)(numVerts > 0 ? numVerts : 1) * 3 * sizeof(short));
+    if (!decoded || !anim_buffer_reserve(out, tableBytes + (size_t) numVerts * 8)) {
+        free(decoded);
+        return 0;
+    }
+    size_t table = out->size;
+    out->size += tableBytes;
+    anim_put_u32(out->data + table, (unsigned int) out->size);
+    for (int v = 0; v < numVerts; v++) {
+        const md3Vertex_t *src = &surface->vertices[v];
+        for (int k = 0; k < 3; k++) {
+            decoded[v * 3 + k] = src->xyz[k];
+            anim_put_u16(out, (unsigned short) src->xyz[k]);
+        }
+        anim_put_u16(out, (unsigned short) src->normal);
+    }
+    for (int f = 1; f < numFrames; f++) {
+        anim_put_u32(out->data + table + (size_t) f * 4, (unsigned int) out->size);
+        /* Worst case per value: a 10-byte zero-run flush plus a 5-byte varint */
+        if (!anim_buffer_reserve(out, (size_t) numVerts * 5 * 15)) {
+            free(decoded);
+            return 0;
+        }
+        const md3Vertex_t *prev = surface->vertices + (size_t)(f - 1) * numVerts;
+        const md3Vertex_t *cur = surface->vertices + (size_t) f * numVerts;
+        unsigned int zeroRun = 0;
+        for (int v = 0; v < numVerts; v++) {
+            for (int k = 0; k < 3; k++) {
+                int delta = anim_quantize_delta(cur[v].xyz[k], decoded[v * 3 + k], step);
+                decoded[v * 3 + k] = (short)(decoded[v * 3 + k] + delta * step);
+                anim_put_value(out, &zeroRun, delta);
+            }
+            /* Normals are lossless: wrapped byte differences of lat and lng */
+            unsigned int a = (unsigned short) prev[v].normal, b = (unsigned short) cur[v].normal;
+            anim_put_value(out, &zeroRun, (signed char)(unsigned char)((b >> 8) - (a >> 8)));
+            anim_put_value(out, &zeroRun, (signed char)(unsigned char)((b & 0xff) - (a & 0xff)));
+        }
+        anim_flush_zeros(out, &zeroRun);
+    }
+    anim_put_u32(out->data + table + (size_t) numFrames * 4, (unsigned int) out->size);
+    free(decoded);
+    return 1;
+}
+
+/* Writes a model's animation as MD3A with the given position step */
+int write_anim(const char *path, const md3FileData *model, int step) {
+    int numSurfaces = model->numSurfaces;
+    int numFrames = model->header.numFrames;
+    md3Clock clock;
+    stats_begin(&clock);
+    animBuffer buf = { NULL, 0, 0 };
+    size_t prefix = sizeof(md3AnimHeader_t) + (size_t) numSurfaces * sizeof(md3AnimSurface_t);
+    if (!anim_buffer_reserve(&buf, prefix)) {
+        fprintf(stderr, "Memory allocation failed for animation data.\n");
+        return 0;
+    }
+    md3AnimHeader_t h;
+    memcpy(h.id, MD3ANIM_ID, 4);
+    h.version = MD3ANIM_VERSION;
+    h.numSurfaces = numSurfaces;
+    h.numFrames = numFrames;
+    h.quantStep = step;
+    memcpy(buf.data, &h, sizeof(h));
+    buf.size = prefix;
+    size_t rawBytes = 0;
+    for (int s = 0; s < numSurfaces; s++) {
+        md3AnimSurface_t entry;
+        memset(&entry, 0, sizeof(entry));
+        memcpy(entry.name, model->surfaces[s].header.name, sizeof(entry.name));
+        entry.numVerts = model->surfaces[s].header.numVerts;
+        entry.ofsFrameTable = (unsigned int) buf.size;
+        memcpy(buf.data + sizeof(h) + (size_t) s * sizeof(entry), &entry, sizeof(entry));
+        if (!encode_anim_surface(&model->surfaces[s], numFrames, step, &buf)) {
+            fprintf(stderr, "Memory allocation failed for animation data.\n");
+            free(buf.data);
+            return 0;
+        }
+        rawBytes += (size_t) entry.numVerts * numFrames * sizeof(md3Vertex_t);
+    }
+    stats_end(STAT_FORMAT, &clock);
+    stats_begin(&clock);
+    FILE *fp = fopen(path, "wb");
+    if (!fp) {
+        fprintf(stderr, "Error opening output file %s: %s\n", path, strerror(errno));
+        free(buf.data);
+        return 0;
+    }
+    int ok = fwrite(buf.data, 1, buf.size, fp) == buf.size;
+    if (fclose(fp) != 0) ok = 0;
+    if (!ok) {
+        fprintf(stderr, "Failed writing %s\n", path);
+        free(buf.data);
+        return 0;
+    }
+    stats_add_bytes_written((long) buf.size);
+    stats_end(STAT_WRITE, &clock);
+    printf("Animation: %lu bytes of vertex frames stored in %lu bytes (%.1f%%)\n",
+           (unsigned long) rawBytes, (unsigned long) buf.size,
+           rawBytes ? 100.0 * buf.size / rawBytes : 0.0);
+    free(buf.data);
+    return 1;
+}
+
+/* --- End Animation Delta Compression --- */
+
+/* --- MD3 Re-writer (-rewrite) --- */
+
+/* Writes the loaded model back as MD3, after any -frames, -resample or
+   -keyframes. Named surfaces and tags can be stripped; surfaces without
+   triangles always are. Vertices no triangle uses are dropped and vertices
+   identical in texture coordinate and in every frame are welded, which is
+   lossless. With -optimizeCache the triangles and vertices are then
+   reordered. Frame bounds and radius are recomputed from the quantized
+   vertices. Blocks are written back to back in the usual order (header,
+   frames, tags, surfaces), every one a multiple of 4 bytes, so all offsets
+   stay aligned. */
+
+/* Matches name against a comma-separated list */
+int name_in_list(const char *name, const char *list) {
+    size_t len = strlen(name);
+    for (const char *p = list; p && *p; ) {
+        const char *comma = strchr(p, ',');
+        size_t itemLen = comma ? (size_t)(comma - p) : strlen(p);
+        if (itemLen == len && strncmp(p, name, len) == 0) return 1;
+        p = comma ? comma + 1 : NULL;
+    }
+    return 0;
+}
+
+/* Keeps frames first..last (inclusive) */
+int select_frame_range(md3FileData *model, int first, int last) {
+    int numFrames = model->header.numFrames;
+    if (first < 0 || last < first || last >= numFrames) {
+        fprintf(stderr, "Frame range %d-%d is outside the model's %d frames.\n", first, last, numFrames);
+        return 0;
+    }
+    int *sourceFrames = (int*) malloc((size_t)(last - first + 1) * sizeof(int));
+    if (!sourceFrames) {
+        fprintf(stderr, "Memory allocation failed for frame selection.\n");
+        return 0;
+    }
+    for (int f = first; f <= last; f++) sourceFrames[f - first] = f;
+    compact_frames(model, sourceFrames, last - first + 1);
+    free(sourceFrames);
+    printf("Kept frames %d-%d of %d\n", first, last, numFrames);
+    return 1;
+}
+
+/* Drops the listed surfaces and any without triangles */
+void strip_surfaces(md3FileData *model, const char *names) {
+    int kept = 0;
+    for (int s = 0; s < model->numSurfaces; s++) {
+        md3SurfaceData *surface = &model->surfaces[s];
+        if (name_in_list(surface->header.name, names) || surface->header.numTriangles <= 0 || surface->header.numVerts <= 0) {
+            printf("Stripping surface %s\n", surface->header.name);
+            free(surface->triangles);
+            free(surface->texCoords);
+            free(surface->vertices);
+            free(surface->shaders);
+            continue;
+        }
+        model->surfaces[kept++] = *surface;
+    }
+    model->numSurfaces = kept;
+    model->header.numSurfaces = kept;
+}
+
+/* Drops the listed tags from every frame */
+void strip_tags(md3FileData *model, const char *names) {
+    int numTags = model->header.numTags;
+    if (!model->tags || !names) return;
+    int *keep = (int*) malloc((size_t) numTags * sizeof(int));
+    if (!keep) return;
+    int kept = 0;
+    for (int t = 0; t < numTags; t++) {
+        if (name_in_list(model->tags[t].name, names)) {
+            printf("Stripping tag %s\n", model->tags[t].name);
+        } else {
+            keep[kept++] = t;
+        }
+    }
+    /* Compact in place; the output index never passes the source index */
+    for (int f = 0; f < model->header.numFrames; f++) {
+        for (int k = 0; k < kept; k++) {
+            model->tags[(size_t) f * kept + k] = model->tags[(size_t) f * numTags + keep[k]];
+        }
+    }
+    model->header.numTags = kept;
+    free(keep);
+}
+
+/* Hashes a vertex's texture coordinate and its data in every frame */
+unsigned int weld_hash(const md3SurfaceData *surface, int v) {
+    int numVerts = surface->header.numVerts;
+    unsigned int h = 2166136261u;
+    const unsigned char *st = (const unsigned char*) &surface->texCoords[v];
+    for (size_t k = 0; k < sizeof(md3TexCoord_t); k++) h = (h ^ st[k]) * 16777619u;
+    for (int f = 0; f < surface->header.numFrames; f++) {
+        const unsigned char *p = (const unsigned char*) &surface->vertices[(size_t) f * numVerts + v];
+        for (size_t k = 0; k < sizeof(md3Vertex_t); k++) h = (h ^ p[k]) * 16777619u;
+    }
+    return h;
+}
+
+int weld_equal(const md3SurfaceData *surface, int a, int b) {
+    int numVerts = surface->header.numVerts;
+    if (memcmp(&surface->texCoords[a], &surface->texCoords[b], sizeof(md3TexCoord_t)) != 0) return 0;
+    for (int f = 0; f < surface->header.numFrames; f++) {
+        if (memcmp(&surface->vertices[(size_t) f * numVerts + a], &surface->vertices[(size_t) f * numVerts + b], sizeof(md3Vertex_t)) != 0) return 0;
+    }
+    return 1;
+}
+
+/* Removes unused and duplicate vertices and the degenerate triangles
+   welding leaves behind. Vertices keep their relative order. */
+int weld_surface(md3SurfaceData *surface) {
+    int numVerts = surface->header.numVerts;
+    int numTris = surface->header.numTriangles;
+    int numFrames = surface->header.numFrames;
+    for (int t = 0; t < numTris; t++) {
+        for (int k = 0; k < 3; k++) {
+            int idx = surface->triangles[t].indexes[k];
+            if (idx < 0 || idx >= numVerts) {
+                fprintf(stderr, "Surface %s: triangle %d uses vertex %d of %d.\n", surface->header.name, t, idx, numVerts);
+                return 0;
+            }
+        }
+    }
+    size_t slots = 64;
+    while (slots < (size_t) numVerts * 2) slots *= 2;
+    int *table = (int*) malloc(slots * sizeof(int));
+    int *remap = (int*) malloc((size_t) numVerts * sizeof(int));
+    unsigned char *used = (unsigned char*) calloc(numVerts, 1);
+    md3TexCoord_t *texCoords = (md3TexCoord_t*) malloc((size_t) numVerts * sizeof(md3TexCoord_t));
+    md3Vertex_t *vertices = (md3Vertex_t*) malloc((size_t) numVerts * numFrames * sizeof(md3Vertex_t));
+    if (!table || !remap || !used || !texCoords || !vertices) {
+        fprintf(stderr, "Memory allocation failed for vertex welding.\n");
+        free(table);
+        free(remap);
+        free(used);
+        free(texCoords);
+        free(vertices);
+        return 0;
+    }
+    for (size_t i = 0; i < slots; i++) table[i] = -1;
+    for (int t = 0; t < numTris; t++) {
+        for (int k = 0; k < 3; k++) used[surface->triangles[t].indexes[k]] = 1;
+    }
+    /* table holds source indices of kept vertices; remap[v] their new index */
+    int kept = 0;
+    for (int v = 0; v < numVerts; v++) {
+        if (!used[v]) continue;
+        size_t i = weld_hash(surface, v) & (slots - 1);
+        while (table[i] != -1 && !weld_equal(surface, table[i], v)) i = (i + 1) & (slots - 1);
+        if (table[i] != -1) {
+            remap[v] = remap[table[i]];
+            continue;
+        }
+        table[i] = v;
+        remap[v] = kept;
+        texCoords[kept] = surface->texCoords[v];
+        kept++;
+    }
+    for (int f = 0; f < numFrames; f++) {
+        /* Welded vertices hold the same data, so any of them may write */
+        for (int v = 0; v < numVerts; v++) {
+            if (used[v]) vertices[(size_t) f * kept + remap[v]] = surface->vertices[(size_t) f * numVerts + v];
+        }
+    }
+    int liveTris = 0;
+    for (int t = 0; t < numTris; t++) {
+        int a = remap[surface->triangles[t].indexes[0]];
+        int b = remap[surface->triangles[t].indexes[1]];
+        int c = remap[surface->triangles[t].indexes[2]];
+        if (a == b || b == c || a == c) continue;
+        surface->triangles[liveTris].indexes[0] = a;
+        surface->triangles[liveTris].indexes[1] = b;
+        surface->triangles[liveTris].indexes[2] = c;
+        liveTris++;
+    }
+    if (kept < numVerts || liveTris < numTris) {
+        printf("Surface %s: %d -> %d vertices, %d -> %d triangles\n", surface->header.name, numVerts, kept, numTris, liveTris);
+    }
+    free(surface->texCoords);
+    free(surface->vertices);
+    surface->texCoords = texCoords;
+    surface->vertices = vertices;
+    surface->header.numVerts = kept;
+    surface->header.numTriangles = liveTris;
+    free(table);
+    free(remap);
+    free(used);
+    return 1;
+}
+
+/* Recomputes every frame's AABB and its radius around localOrigin; a model
+   without a frame block gets one with origins at zero */
+int refresh_frame_bounds(md3FileData *model) {
+    int numFrames = model->header.numFrames;
+    if (!model->frames) {
+        model->frames = (md3Frame_t*) calloc(numFrames > 0 ? numFrames : 1, sizeof(md3Frame_t));
+        if (!model->frames) {
+            fprintf(stderr, "Memory allocation failed for frames.\n");
+            return 0;
+        }
+        for (int f = 0; f < numFrames; f++) {
+            char frameName[32] = { 0 };
+            snprintf(frameName, sizeof(frameName), "frame%d", f);
+            memcpy(model->frames[f].name, frameName, sizeof(model->frames[f].name) - 1);
+        }
+    }
+    boundsJob job;
+    job.model = model;
+    job.maxVerts = 1;
+    job.bounds = (md3FrameBounds*) calloc(numFrames > 0 ? numFrames : 1, sizeof(md3FrameBounds));
+    if (!job.bounds) {
+        fprintf(stderr, "Memory allocation failed for frame bounds.\n");
+        return 0;
+    }
+    for (int s = 0; s < model->numSurfaces; s++) {
+        if (model->surfaces[s].header.numVerts > job.maxVerts) job.maxVerts = model->surfaces[s].header.numVerts;
+    }
+    run_parallel(numFrames, compute_frame_bounds_range, &job);
+    int ok = 1;
+    for (int f = 0; f < numFrames; f++) {
+        const md3FrameBounds *b = &job.bounds[f];
+        if (b->hasVerts < 0) {
+            fprintf(stderr, "Memory allocation failed for frame bounds.\n");
+            ok = 0;
+            break;
+        }
+        md3Frame_t *frame = &model->frames[f];
+        memcpy(frame->mins, b->mins, sizeof(frame->mins));
+        memcpy(frame->maxs, b->maxs, sizeof(frame->maxs));
+        frame->radius = b->originRadius;
+    }
+    free(job.bounds);
+    return ok;
+}
+
+/* Writes the model as a packed MD3 */
+int write_md3_file(const char *path, md3FileData *model) {
+    md3Header_t header = model->header;
+    int numFrames = header.numFrames, numTags = model->tags ? header.numTags : 0;
+    header.numTags = numTags;
+    header.numSurfaces = model->numSurfaces;
+    header.ofsFrames = sizeof(md3Header_t);
+    header.ofsTags = header.ofsFrames + numFrames * (int) sizeof(md3Frame_t);
+    header.ofsSurfaces = header.ofsTags + numTags * numFrames * (int) sizeof(md3Tag_t);
+    long offset = header.ofsSurfaces;
+    for (int s = 0; s < model->numSurfaces; s++) {
+        md3Surface_t *h = &model->surfaces[s].header;
+        if (!model->surfaces[s].shaders) h->numShaders = 0;
+        h->numFrames = numFrames;
+        h->ofsShaders = sizeof(md3Surface_t);
+        h->ofsTriangles = h->ofsShaders + h->numShaders * (int) sizeof(md3Shader_t);
+        h->ofsST = h->ofsTriangles + h->numTriangles * (int) sizeof(md3Triangle_t);
+        h->ofsVerts = h->ofsST + h->numVerts * (int) sizeof(md3TexCoord_t);
+        h->ofsEnd = h->ofsVerts + h->numVerts * numFrames * (int) sizeof(md3Vertex_t);
+        offset += h->ofsEnd;
+    }
+    header.ofsEnd = (int) offset;
+
+    md3Clock clock;
+    stats_begin(&clock);
+    FILE *fp = fopen(path, "wb");
+    if (!fp) {
+        fprintf(stderr, "Error opening output file %s: %s\n", path, strerror(errno));
+        return 0;
+    }
+    int ok = fwrite(&header, sizeof(header), 1, fp) == 1 &&
+             fwrite(model->frames, sizeof(md3Frame_t), numFrames, fp) == (size_t) numFrames &&
+             (numTags == 0 || fwrite(model->tags, sizeof(md3Tag_t), (size_t) numTags * numFrames, fp) == (size_t) numTags * numFrames);
+    for (int s = 0; ok && s < model->numSurfaces; s++) {
+        const md3SurfaceData *surface = &model->surfaces[s];
+        const md3Surface_t *h = &surface->header;
+        size_t vertexCount = (size_t) h->numVerts * numFrames;
+        ok = fwrite(h, sizeof(md3Surface_t), 1, fp) == 1 &&
+             (h->numShaders == 0 || fwrite(surface->shaders, sizeof(md3Shader_t), h->numShaders, fp) == (size_t) h->numShaders) &&
+             fwrite(surface->triangles, sizeof(md3Triangle_t), h->numTriangles, fp) == (size_t) h->numTriangles &&
+             fwrite(surface->texCoords, sizeof(md3TexCoord_t), h->numVerts, fp) == (size_t) h->numVerts &&
+             fwrite(surface->vertices, sizeof(md3Vertex_t), vertexCount, fp) == vertexCount;
+    }
+    if (fclose(fp) != 0) ok = 0;
+    stats_end(STAT_WRITE, &clock);
+    if (!ok) {
+        fprintf(stderr, "Failed writing %s\n", path);
+        return 0;
+    }
+    stats_add_bytes_written(header.ofsEnd);
+    model->header = header;
+    printf("Wrote %s: %d frames, %d surfaces, %d tags, %d bytes\n", path, numFrames, header.numSurfaces, numTags, header.ofsEnd);
+    return 1;
+}
+
+/* Strips, welds, optionally cache-optimizes and writes the model */
+int rewrite_md3(const char *path, md3FileData *model, const char *stripSurfaceNames, const char *stripTagNames, int optimizeCache) {
+    strip_tags(model, stripTagNames);
+    md3Clock clock;
+    stats_begin(&clock);
+    int ok = 1;
+    for (int s = 0; ok && s < model->numSurfaces; s++) {
+        if (!name_in_list(model->surfaces[s].header.name, stripSurfaceNames)) ok = weld_surface(&model->surfaces[s]);
+    }
+    /* After welding, which can leave a surface without triangles */
+    strip_surfaces(model, stripSurfaceNames);
+    ok = ok && (!optimizeCache || optimize_surfaces_cache(model->surfaces, model->numSurfaces));
+    ok = ok && refresh_frame_bounds(model);
+    stats_end(STAT_DECODE, &clock);
+    return ok && write_md3_file(path, model);
+}
+
+/* --- End MD3 Re-writer --- */
+
+/* --- IQM Export (-iqm) --- */
+
+/* Writes the model as Inter-Quake Model v2. IQM has no morph targets, so
+   frame 0 goes into the standard position/texcoord/normal arrays and all
+   frames are kept losslessly in two custom vertex arrays: "md3_xyz" (int16
+   in MD3_XYZ_SCALE units, 3 per frame) and "md3_normal" (the MD3 lat/lng
+   encoding, 1 per frame). Each tag becomes a root joint whose per-frame
+   pose is the tag transform, so attachments can follow the animation at
+   runtime. Coordinates, UVs and winding are written as MD3 stores them
+   (Z up, clockwise triangles); -swapYZ and -flipUVs do not apply. */
+
+#define IQM_MAGIC "INTERQUAKEMODEL"
+#define IQM_VERSION 2
+#define IQM_POSITION 0
+#define IQM_TEXCOORD 1
+#define IQM_NORMAL 2
+#define IQM_CUSTOM 0x10   /* custom array name is the text offset type - IQM_CUSTOM */
+#define IQM_SHORT 2
+#define IQM_FLOAT 7
+#define IQM_NUM_ARRAYS 5
+#define IQM_NUM_CHANNELS 10   /* translate xyz, rotate xyzw, scale xyz */
+
+#pragma pack(push, 1)
+typedef struct {
+    char magic[16];
+    unsigned int version;
+    unsigned int filesize;
+    unsigned int flags;
+    unsigned int numText, ofsText;
+    unsigned int numMeshes, ofsMeshes;
+    unsigned int numVertexArrays, numVertexes, ofsVertexArrays;
+    unsigned int numTriangles, ofsTriangles, ofsAdjacency;
+    unsigned int numJoints, ofsJoints;
+    unsigned int numPoses, ofsPoses;
+    unsigned int numAnims, ofsAnims;
+    unsigned int numFrames, numFrameChannels, ofsFrames, ofsBounds;
+    unsigned int numComment, ofsComment;
+    unsigned int numExtensions, ofsExtensions;
+} iqmHeader_t;
+
+typedef struct {
+    unsigned int name, material;
+    unsigned int firstVertex, numVertexes;
+    unsigned int firstTriangle, numTriangles;
+} iqmMesh_t;
+
+typedef struct {
+    unsigned int type, flags, format, size, offset;
+} iqmVertexArray_t;
+
+typedef struct {
+    unsigned int name;
+    int parent;
+    float translate[3], rotate[4], scale[3];
+} iqmJoint_t;
+
+typedef struct {
+    int parent;
+    unsigned int mask;
+    float channelOffset[IQM_NUM_CHANNELS];
+    float channelScale[IQM_NUM_CHANNELS];
+} iqmPose_t;
+
+typedef struct {
+    unsigned int name, firstFrame, numFrames;
+    float framerate;
+    unsigned int flags;
+} iqmAnim_t;
+
+typedef struct {
+    float bbmin[3], bbmax[3];
+    float xyradius, radius;
+} iqmBounds_t;
+#pragma pack(pop)
+
+/* Appends a NUL-terminated copy of at most max bytes of s to the text block
+   and returns its offset, or 0 (the empty string) if allocation failed */
+unsigned int iqm_add_text(animBuffer *text, const char *s, size_t max) {
+    size_t len = 0;
+    while (len < max && s[len]) len++;
+    if (!anim_buffer_reserve(text, len + 1)) return 0;
+    unsigned int offset = (unsigned int) text->size;
+    memcpy(text->data + text->size, s, len);
+    text->data[text->size + len] = '\0';
+    text->size += len + 1;
+    return offset;
+}
+
+/* Tag transform as translate, unit quaternion (x, y, z, w) and scale. axis[i]
+   is the tag's i-th basis vector in model space, i.e. column i of the
+   rotation, as in Quake 3's tag attachment. */
+void iqm_tag_channels(const md3Tag_t *tag, float *ch) {
+    const float (*a)[3] = tag->axis;
+    double m00 = a[0][0], m11 = a[1][1], m22 = a[2][2];
+    double trace = m00 + m11 + m22, q[4];
+    if (trace > 0.0) {
+        double s = sqrt(trace + 1.0) * 2.0;
+        q[3] = 0.25 * s;
+        q[0] = (a[1][2] - a[2][1]) / s;
+        q[1] = (a[2][0] - a[0][2]) / s;
+        q[2] = (a[0][1] - a[1][0]) / s;
+    } else if (m00 > m11 && m00 > m22) {
+        double s = sqrt(1.0 + m00 - m11 - m22) * 2.0;
+        q[3] = (a[1][2] - a[2][1]) / s;
+        q[0] = 0.25 * s;
+        q[1] = (a[1][0] + a[0][1]) / s;
+        q[2] = (a[2][0] + a[0][2]) / s;
+    } else if (m11 > m22) {
+        double s = sqrt(1.0 + m11 - m00 - m22) * 2.0;
+        q[3] = (a[2][0] - a[0][2]) / s;
+        q[0] = (a[1][0] + a[0][1]) / s;
+        q[1] = 0.25 * s;
+        q[2] = (a[2][1] + a[1][2]) / s;
+    } else {
+        double s = sqrt(1.0 + m22 - m00 - m11) * 2.0;
+        q[3] = (a[0][1] - a[1][0]) / s;
+        q[0] = (a[2][0] + a[0][2]) / s;
+        q[1] = (a[2][1] + a[1][2]) / s;
+        q[2] = 0.25 * s;
+    }
+    double len = sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+    if (!(len > 1e-12)) {
+        q[0] = q[1] = q[2] = 0.0;
+        q[3] = len = 1.0;
+    }
+    for (int k = 0; k < 3; k++) ch[k] = tag->origin[k];
+    for (int k = 0; k < 4; k++) ch[3 + k] = (float)(q[k] / len);
+    ch[7] = ch[8] = ch[9] = 1.0f;
+}
+
+/* Fills one iqmBounds_t per frame; radii are measured from the model origin */
+void iqm_frame_bounds(const md3FileData *model, iqmBounds_t *bounds) {
+    int numFrames = model->header.numFrames;
+    for (int f = 0; f < numFrames; f++) {
+        iqmBounds_t *b = &bounds[f];
+        double xy2 = 0.0, r2 = 0.0;
+        int any = 0;
+        memset(b, 0, sizeof(*b));
+        for (int s = 0; s < model->numSurfaces; s++) {
+            const md3SurfaceData *surface = &model->surfaces[s];
+            const md3Vertex_t *verts = surface->vertices + (size_t) f * surface->header.numVerts;
+            for (int v = 0; v < surface->header.numVerts; v++) {
+                float p[3];
+                for (int k = 0; k < 3; k++) {
+                    p[k] = verts[v].xyz[k] * MD3_XYZ_SCALE;
+                    if (!any || p[k] < b->bbmin[k]) b->bbmin[k] = p[k];
+                    if (!any || p[k] > b->bbmax[k]) b->bbmax[k] = p[k];
                 }
+                any = 1;
+                double d = (double) p[0] * p[0] + (double) p[1] * p[1];
+                if (d > xy2) xy2 = d;
+                d += (double) p[2] * p[2];
+                if (d > r2) r2 = d;
             }
-            globalIndex += numVerts;
         }
+        b->xyradius = (float) sqrt(xy2);
+        b->radius = (float) sqrt(r2);
     }
-    
-    /* Second pass: write texture coordinates */  
-    for (int f = 0; f < numFiles; f++) {
-        md3FileData *mfile = &files[f];
-        for (int s = 0; s < mfile->numSurfaces; s++) {
-            int numVerts = mfile->surfaces[s].header.numVerts;
-            for (int v = 0; v < numVerts; v++) {
-                float u = mfile->surfaces[s].texCoords[v].st[0];
-                float t = mfile->surfaces[s].texCoords[v].st[1];
-                if (g_flipUVs) { t = 1.0f - t; }
-                if (fprintf(outFile, "vt %f %f\n", u, t) < 0) {
-                    fprintf(stderr, "Error writing texcoord to %s\n", outputName);
-                    fclose(outFile);
-                    return 0;
-                }
+}
+
+/* Builds the whole IQM image in memory and writes it in one call */
+int write_iqm(const char *path, const md3FileData *model, double fps) {
+    int numFrames = model->header.numFrames;
+    int numTags = model->tags ? model->header.numTags : 0;
+    if (numFrames < 1) {
+        fprintf(stderr, "IQM export needs at least one frame.\n");
+        return 0;
+    }
+    md3Clock clock;
+    stats_begin(&clock);
+    size_t numVerts = 0, numTris = 0;
+    for (int s = 0; s < model->numSurfaces; s++) {
+        numVerts += (size_t) model->surfaces[s].header.numVerts;
+        numTris += (size_t) model->surfaces[s].header.numTriangles;
+    }
+
+    /* Text block: names of meshes, materials, joints, the animation and the custom arrays */
+    animBuffer text = { NULL, 0, 0 };
+    if (!anim_buffer_reserve(&text, 1)) {
+        fprintf(stderr, "Memory allocation failed for IQM data.\n");
+        return 0;
+    }
+    text.data[text.size++] = '\0';
+    unsigned int *names = (unsigned int*) malloc(((size_t) model->numSurfaces * 2 + numTags + 3) * sizeof(unsigned int));
+    if (!names) {
+        fprintf(stderr, "Memory allocation failed for IQM data.\n");
+        free(text.data);
+        return 0;
+    }
+    unsigned int *jointNames = names + (size_t) model->numSurfaces * 2;
+    for (int s = 0; s < model->numSurfaces; s++) {
+        const md3SurfaceData *surface = &model->surfaces[s];
+        const char *material = surface->header.name;
+        if (surface->material[0]) {
+            material = surface->material;
+        } else if (surface->shaders && surface->header.numShaders > 0 && surface->shaders[0].name[0]) {
+            material = surface->shaders[0].name;
+        }
+        names[s * 2] = iqm_add_text(&text, surface->header.name, sizeof(surface->header.name));
+        names[s * 2 + 1] = iqm_add_text(&text, material, sizeof(surface->shaders[0].name));
+    }
+    for (int t = 0; t < numTags; t++) {
+        jointNames[t] = iqm_add_text(&text, model->tags[t].name, sizeof(model->tags[t].name));
+    }
+    unsigned int animName = iqm_add_text(&text, "frames", 7);
+    unsigned int xyzName = iqm_add_text(&text, "md3_xyz", 8);
+    unsigned int normalName = iqm_add_text(&text, "md3_normal", 11);
+    if (normalName == 0) {
+        fprintf(stderr, "Memory allocation failed for IQM data.\n");
+        free(names);
+        free(text.data);
+        return 0;
+    }
+
+    /* Poses: a channel is animated (and stored per frame) only if it changes */
+    float *channels = (float*) malloc((size_t)(numTags > 0 ? numTags : 1) * numFrames * IQM_NUM_CHANNELS * sizeof(float));
+    iqmPose_t *poses = (iqmPose_t*) calloc(numTags > 0 ? numTags : 1, sizeof(iqmPose_t));
+    if (!channels || !poses) {
+        fprintf(stderr, "Memory allocation failed for IQM data.\n");
+        free(channels);
+        free(poses);
+        free(names);
+        free(text.data);
+        return 0;
+    }
+    unsigned int numFrameChannels = 0;
+    for (int t = 0; t < numTags; t++) {
+        float *prev = NULL;
+        for (int f = 0; f < numFrames; f++) {
+            float *ch = channels + ((size_t) t * numFrames + f) * IQM_NUM_CHANNELS;
+            iqm_tag_channels(&model->tags[(size_t) f * model->header.numTags + t], ch);
+            /* q and -q are the same rotation; keep neighbours in one hemisphere
+               so interpolated poses take the short way */
+            float dot = prev ? prev[3] * ch[3] + prev[4] * ch[4] + prev[5] * ch[5] + prev[6] * ch[6]
+                             : ch[6];
+            if (dot < 0.0f) {
+                for (int k = 3; k < 7; k++) ch[k] = -ch[k];
+            }
+            prev = ch;
+        }
+        iqmPose_t *pose = &poses[t];
+        pose->parent = -1;
+        for (int c = 0; c < IQM_NUM_CHANNELS; c++) {
+            float lo = channels[(size_t) t * numFrames * IQM_NUM_CHANNELS + c], hi = lo;
+            for (int f = 1; f < numFrames; f++) {
+                float v = channels[((size_t) t * numFrames + f) * IQM_NUM_CHANNELS + c];
+                if (v < lo) lo = v;
+                if (v > hi) hi = v;
+            }
+            pose->channelOffset[c] = lo;
+            if (hi > lo) {
+                pose->mask |= 1u << c;
+                pose->channelScale[c] = (hi - lo) / 65535.0f;
+                numFrameChannels++;
             }
         }
     }
-    
-    /* Third pass: write vertex normals */  
-    for (int f = 0; f < numFiles; f++) {
-        md3FileData *mfile = &files[f];
-        for (int s = 0; s < mfile->numSurfaces; s++) {
-            int numVerts = mfile->surfaces[s].header.numVerts;
-            for (int v = 0; v < numVerts; v++) {
-                int idx = 0 * numVerts + v;
-                md3Vertex_t vert = mfile->surfaces[s].vertices[idx];
-                float nx, ny, nz;
-                decodeNormal(vert.normal, &nx, &ny, &nz);
-                if (mfile->tags) {
-                    float nnx = mfile->tags[0].axis[0][0]*nx + mfile->tags[0].axis[0][1]*ny + mfile->tags[0].axis[0][2]*nz;
-                    float nny = mfile->tags[0].axis[1][0]*nx + mfile->tags[0].axis[1][1]*ny + mfile->tags[0].axis[1][2]*nz;
-                    float nnz = mfile->tags[0].axis[2][0]*nx + mfile->tags[0].axis[2][1]*ny + mfile->tags[0].axis[2][2]*nz;
-                    nx = nnx; ny = nny; nz = nnz;
-                }
-                if (g_swapYZ) { float temp = ny; ny = nz; nz = temp; }
-                if (fprintf(outFile, "vn %f %f %f\n", nx, ny, nz) < 0) {
-                    fprintf(stderr, "Error writing normal to %s\n", outputName);
-                    fclose(outFile);
-                    return 0;
-                }
+
+    /* Layout; every block starts 4-byte aligned */
+    size_t arrayBytes[IQM_NUM_ARRAYS] = {
+        numVerts * 3 * sizeof(float),
+        numVerts * 2 * sizeof(float),
+        numVerts * 3 * sizeof(float),
+        numVerts * 3 * numFrames * sizeof(short),
+        numVerts * numFrames * sizeof(short)
+    };
+    size_t arrayOffsets[IQM_NUM_ARRAYS];
+    iqmHeader_t h;
+    memset(&h, 0, sizeof(h));
+    size_t offset = sizeof(iqmHeader_t);
+    h.ofsText = (unsigned int) offset;
+    offset += (text.size + 3) & ~(size_t) 3;
+    h.ofsMeshes = (unsigned int) offset;
+    offset += (size_t) model->numSurfaces * sizeof(iqmMesh_t);
+    h.ofsVertexArrays = (unsigned int) offset;
+    offset += IQM_NUM_ARRAYS * sizeof(iqmVertexArray_t);
+    for (int i = 0; i < IQM_NUM_ARRAYS; i++) {
+        arrayOffsets[i] = offset;
+        offset += (arrayBytes[i] + 3) & ~(size_t) 3;
+    }
+    h.ofsTriangles = (unsigned int) offset;
+    offset += numTris * 3 * sizeof(unsigned int);
+    h.ofsJoints = (unsigned int) offset;
+    offset += (size_t) numTags * sizeof(iqmJoint_t);
+    h.ofsPoses = (unsigned int) offset;
+    offset += (size_t) numTags * sizeof(iqmPose_t);
+    h.ofsAnims = (unsigned int) offset;
+    offset += sizeof(iqmAnim_t);
+    h.ofsFrames = (unsigned int) offset;
+    offset += ((size_t) numFrames * numFrameChannels * sizeof(unsigned short) + 3) & ~(size_t) 3;
+    h.ofsBounds = (unsigned int) offset;
+    offset += (size_t) numFrames * sizeof(iqmBounds_t);
+    unsigned char *image = offset <= 0x7fffffff ? (unsigned char*) calloc(offset, 1) : NULL;
+    if (!image) {
+        if (offset > 0x7fffffff) {
+            fprintf(stderr, "Model is too large for IQM (%lu bytes).\n", (unsigned long) offset);
+        } else {
+            fprintf(stderr, "Memory allocation failed for IQM data.\n");
+        }
+        free(channels);
+        free(poses);
+        free(names);
+        free(text.data);
+        return 0;
+    }
+    memcpy(h.magic, IQM_MAGIC, sizeof(IQM_MAGIC));
+    h.version = IQM_VERSION;
+    h.filesize = (unsigned int) offset;
+    h.numText = (unsigned int) text.size;
+    h.numMeshes = (unsigned int) model->numSurfaces;
+    h.numVertexArrays = IQM_NUM_ARRAYS;
+    h.numVertexes = (unsigned int) numVerts;
+    h.numTriangles = (unsigned int) numTris;
+    h.numJoints = (unsigned int) numTags;
+    h.numPoses = (unsigned int) numTags;
+    h.numAnims = 1;
+    h.numFrames = (unsigned int) numFrames;
+    h.numFrameChannels = numFrameChannels;
+    memcpy(image, &h, sizeof(h));
+    memcpy(image + h.ofsText, text.data, text.size);
+
+    iqmVertexArray_t arrays[IQM_NUM_ARRAYS] = {
+        { IQM_POSITION, 0, IQM_FLOAT, 3, 0 },
+        { IQM_TEXCOORD, 0, IQM_FLOAT, 2, 0 },
+        { IQM_NORMAL, 0, IQM_FLOAT, 3, 0 },
+        { IQM_CUSTOM + xyzName, 0, IQM_SHORT, 3 * (unsigned int) numFrames, 0 },
+        { IQM_CUSTOM + normalName, 0, IQM_SHORT, (unsigned int) numFrames, 0 }
+    };
+    for (int i = 0; i < IQM_NUM_ARRAYS; i++) arrays[i].offset = (unsigned int) arrayOffsets[i];
+    memcpy(image + h.ofsVertexArrays, arrays, sizeof(arrays));
+
+    /* Meshes, vertex arrays and triangles, surface by surface */
+    float *position = (float*)(image + arrayOffsets[0]);
+    float *texcoord = (float*)(image + arrayOffsets[1]);
+    float *normal = (float*)(image + arrayOffsets[2]);
+    short *xyz = (short*)(image + arrayOffsets[3]);
+    short *packedNormal = (short*)(image + arrayOffsets[4]);
+    unsigned int *tris = (unsigned int*)(image + h.ofsTriangles);
+    size_t firstVertex = 0, firstTriangle = 0;
+    for (int s = 0; s < model->numSurfaces; s++) {
+        const md3SurfaceData *surface = &model->surfaces[s];
+        int nv = surface->header.numVerts, nt = surface->header.numTriangles;
+        iqmMesh_t mesh;
+        mesh.name = names[s * 2];
+        mesh.material = names[s * 2 + 1];
+        mesh.firstVertex = (unsigned int) firstVertex;
+        mesh.numVertexes = (unsigned int) nv;
+        mesh.firstTriangle = (unsigned int) firstTriangle;
+        mesh.numTriangles = (unsigned int) nt;
+        memcpy(image + h.ofsMeshes + (size_t) s * sizeof(mesh), &mesh, sizeof(mesh));
+        for (int v = 0; v < nv; v++) {
+            size_t out = firstVertex + v;
+            const md3Vertex_t *base = &surface->vertices[v];
+            for (int k = 0; k < 3; k++) position[out * 3 + k] = base->xyz[k] * MD3_XYZ_SCALE;
+            decodeNormal(base->normal, &normal[out * 3], &normal[out * 3 + 1], &normal[out * 3 + 2]);
+            texcoord[out * 2] = surface->texCoords[v].st[0];
+            texcoord[out * 2 + 1] = surface->texCoords[v].st[1];
+            for (int f = 0; f < numFrames; f++) {
+                const md3Vertex_t *src = &surface->vertices[(size_t) f * nv + v];
+                memcpy(&xyz[(out * numFrames + f) * 3], src->xyz, sizeof(src->xyz));
+                packedNormal[out * numFrames + f] = src->normal;
+            }
+        }
+        for (int t = 0; t < nt; t++) {
+            for (int k = 0; k < 3; k++) {
+                tris[(firstTriangle + t) * 3 + k] = (unsigned int)(firstVertex + surface->triangles[t].indexes[k]);
             }
         }
+        firstVertex += nv;
+        firstTriangle += nt;
     }
-    
-    /* Fourth pass: write face definitions for each surface */  
-    for (int f = 0; f < numFiles; f++) {
-        md3FileData *mfile = &files[f];
-        for (int s = 0; s < mfile->numSurfaces; s++) {
-            if (fprintf(outFile, "g %s\n", mfile->surfaces[s].header.name) < 0) {
-                fprintf(stderr, "Error writing group name to %s\n", outputName);
-                fclose(outFile);
+
+    /* Joints take frame 0 as their bind pose; frames hold the animated channels */
+    unsigned short *frameData = (unsigned short*)(image + h.ofsFrames);
+    for (int t = 0; t < numTags; t++) {
+        const float *ch = channels + (size_t) t * numFrames * IQM_NUM_CHANNELS;
+        iqmJoint_t joint;
+        joint.name = jointNames[t];
+        joint.parent = -1;
+        memcpy(joint.translate, ch, sizeof(joint.translate));
+        memcpy(joint.rotate, ch + 3, sizeof(joint.rotate));
+        memcpy(joint.scale, ch + 7, sizeof(joint.scale));
+        memcpy(image + h.ofsJoints + (size_t) t * sizeof(joint), &joint, sizeof(joint));
+        memcpy(image + h.ofsPoses + (size_t) t * sizeof(iqmPose_t), &poses[t], sizeof(iqmPose_t));
+    }
+    for (int f = 0; f < numFrames; f++) {
+        for (int t = 0; t < numTags; t++) {
+            const iqmPose_t *pose = &poses[t];
+            const float *ch = channels + ((size_t) t * numFrames + f) * IQM_NUM_CHANNELS;
+            for (int c = 0; c < IQM_NUM_CHANNELS; c++) {
+                if (!(pose->mask & (1u << c))) continue;
+                long q = lrint((ch[c] - pose->channelOffset[c]) / pose->channelScale[c]);
+                *frameData++ = (unsigned short)(q < 0 ? 0 : (q > 65535 ? 65535 : q));
+            }
+        }
+    }
+    iqmAnim_t anim;
+    anim.name = animName;
+    anim.firstFrame = 0;
+    anim.numFrames = (unsigned int) numFrames;
+    anim.framerate = (float) fps;
+    anim.flags = 0;
+    memcpy(image + h.ofsAnims, &anim, sizeof(anim));
+    iqm_frame_bounds(model, (iqmBounds_t*)(image + h.ofsBounds));
+    free(channels);
+    free(poses);
+    free(names);
+    free(text.data);
+    stats_end(STAT_FORMAT, &clock);
+
+    stats_begin(&clock);
+    FILE *fp = fopen(path, "wb");
+    if (!fp) {
+        fprintf(stderr, "Error opening output file %s: %s\n", path, strerror(errno));
+        free(image);
+        return 0;
+    }
+    int ok = fwrite(image, 1, offset, fp) == offset;
+    if (fclose(fp) != 0) ok = 0;
+    free(image);
+    stats_end(STAT_WRITE, &clock);
+    if (!ok) {
+        fprintf(stderr, "Failed writing %s\n", path);
+        return 0;
+    }
+    stats_add_bytes_written((long) offset);
+    printf("Wrote %s: %lu vertices, %lu triangles, %d frames, %d joints, %lu bytes\n", path,
+           (unsigned long) numVerts, (unsigned long) numTris, numFrames, numTags, (unsigned long) offset);
+    return 1;
+}
+
+/* --- End IQM Export --- */
+
+/* --- Materials and Skins (-mtl, -skin) --- */
+
+/* Each surface gets a material named after its texture: the .skin entry for
+   the surface if a skin is used, otherwise its first MD3 shader. Surfaces
+   sharing a texture share a material, and a surface without one gets no
+   usemtl. Naming materials after the texture keeps the round trip through
+   -toMD3, which turns usemtl back into the surface's shader. Parsed skins
+   are cached by path, so a skin shared by every model of a merge or by the
+   LOD levels is read once. */
+
+typedef struct {
+    char surface[64];
+    char texture[64];
+} md3SkinEntry;
+
+typedef struct {
+    char path[512];
+    md3SkinEntry *entries;
+    int numEntries;
+    int loaded;     /* 0 if the file could not be read; cached all the same */
+} md3Skin;
+
+typedef struct {
+    md3Skin *skins;
+    int numSkins, capSkins;
+    char (*materials)[64];   /* distinct material names, in first-use order */
+    int numMaterials, capMaterials;
+} md3MaterialState;
+
+static md3MaterialState g_materialState;
+
+int name_equal_nocase(const char *a, const char *b) {
+    while (*a && tolower((unsigned char) *a) == tolower((unsigned char) *b)) {
+        a++;
+        b++;
+    }
+    return tolower((unsigned char) *a) == tolower((unsigned char) *b);
+}
+
+/* Copies a trimmed field of at most len bytes, dropping surrounding quotes
+   and turning whitespace into '_' so the result is one OBJ token */
+void skin_copy_field(char *dst, size_t size, const char *src, size_t len) {
+    while (len > 0 && isspace((unsigned char) *src)) { src++; len--; }
+    while (len > 0 && isspace((unsigned char) src[len - 1])) len--;
+    if (len >= 2 && src[0] == '"' && src[len - 1] == '"') { src++; len -= 2; }
+    if (len >= size) len = size - 1;
+    for (size_t i = 0; i < len; i++) dst[i] = isspace((unsigned char) src[i]) ? '_' : src[i];
+    dst[len] = '\0';
+}
+
+/* Parses a Quake 3 .skin ("surface,texture" per line; tag lines have an empty
+   texture and are skipped) */
+int parse_skin(md3Skin *skin) {
+    FILE *fp = fopen(skin->path, "r");
+    if (!fp) return 0;
+    char line[512];
+    int cap = 0;
+    while (fgets(line, sizeof(line), fp)) {
+        char *comma = strchr(line, ',');
+        if (!comma) continue;
+        md3SkinEntry entry;
+        skin_copy_field(entry.surface, sizeof(entry.surface), line, (size_t)(comma - line));
+        skin_copy_field(entry.texture, sizeof(entry.texture), comma + 1, strlen(comma + 1));
+        if (!entry.surface[0] || !entry.texture[0]) continue;
+        if (skin->numEntries == cap) {
+            int newCap = cap ? cap * 2 : 16;
+            md3SkinEntry *entries = (md3SkinEntry*) realloc(skin->entries, newCap * sizeof(md3SkinEntry));
+            if (!entries) {
+                fclose(fp);
                 return 0;
             }
-            int base = mfile->surfaces[s].baseIndex;
-            int numTris = mfile->surfaces[s].header.numTriangles;
-            for (int t = 0; t < numTris; t++) {
-                md3Triangle_t tri = mfile->surfaces[s].triangles[t];
-                int i1, i2, i3;
-                if (g_swapYZ) {
-                    i1 = base + tri.indexes[0];
-                    i2 = base + tri.indexes[1];
-                    i3 = base + tri.indexes[2];
-                } else {
-                    i1 = base + tri.indexes[2];
-                    i2 = base + tri.indexes[1];
-                    i3 = base + tri.indexes[0];
-                }
-                if (fprintf(outFile, "f %d/%d/%d %d/%d/%d %d/%d/%d\n",
-                            i1, i1, i1, i2, i2, i2, i3, i3, i3) < 0) {
-                    fprintf(stderr, "Error writing face data to %s\n", outputName);
-                    fclose(outFile);
-                    return 0;
-                }
+            skin->entries = entries;
+            cap = newCap;
+        }
+        skin->entries[skin->numEntries++] = entry;
+    }
+    fclose(fp);
+    return 1;
+}
+
+/* Returns the cached skin for path, parsing it on first use; NULL if it
+   cannot be read */
+const md3Skin *load_skin_cached(const char *path) {
+    md3MaterialState *st = &g_materialState;
+    for (int i = 0; i < st->numSkins; i++) {
+        if (strcmp(st->skins[i].path, path) == 0) return st->skins[i].loaded ? &st->skins[i] : NULL;
+    }
+    if (st->numSkins == st->capSkins) {
+        int newCap = st->capSkins ? st->capSkins * 2 : 8;
+        md3Skin *skins = (md3Skin*) realloc(st->skins, newCap * sizeof(md3Skin));
+        if (!skins) return NULL;
+        st->skins = skins;
+        st->capSkins = newCap;
+    }
+    md3Skin *skin = &st->skins[st->numSkins++];
+    memset(skin, 0, sizeof(*skin));
+    snprintf(skin->path, sizeof(skin->path), "%s", path);
+    skin->loaded = parse_skin(skin);
+    if (skin->loaded) printf("Using skin %s (%d surfaces)\n", path, skin->numEntries);
+    return skin->loaded ? skin : NULL;
+}
+
+/* Quake 3 keeps a model's default skin next to it as name_default.skin */
+void default_skin_path(const char *modelPath, char *out, size_t size) {
+    snprintf(out, size, "%s", modelPath);
+    char *slash = strrchr(out, '/');
+    char *dot = strrchr(out, '.');
+    if (dot && (!slash || dot > slash)) *dot = '\0';
+    size_t len = strlen(out);
+    snprintf(out + len, size - len, "_default.skin");
+}
+
+/* Sets each surface's material from the skin (may be NULL) or its shader
+   and records new material names */
+int assign_materials(md3SurfaceData *surfaces, int numSurfaces, const md3Skin *skin) {
+    md3MaterialState *st = &g_materialState;
+    for (int s = 0; s < numSurfaces; s++) {
+        md3SurfaceData *surface = &surfaces[s];
+        surface->material[0] = '\0';
+        for (int i = 0; skin && i < skin->numEntries; i++) {
+            if (name_equal_nocase(skin->entries[i].surface, surface->header.name)) {
+                memcpy(surface->material, skin->entries[i].texture, sizeof(surface->material));
+                break;
+            }
+        }
+        if (!surface->material[0] && surface->shaders && surface->header.numShaders > 0) {
+            const char *shader = surface->shaders[0].name;
+            size_t len = 0;
+            while (len < sizeof(surface->shaders[0].name) && shader[len]) len++;
+            skin_copy_field(surface->material, sizeof(surface->material), shader, len);
+        }
+        if (!surface->material[0]) continue;
+        int known = 0;
+        for (int m = 0; m < st->numMaterials && !known; m++) {
+            known = strcmp(st->materials[m], surface->material) == 0;
+        }
+        if (known) continue;
+        if (st->numMaterials == st->capMaterials) {
+            int newCap = st->capMaterials ? st->capMaterials * 2 : 16;
+            char (*materials)[64] = (char (*)[64]) realloc(st->materials, newCap * sizeof(*materials));
+            if (!materials) {
+                fprintf(stderr, "Memory allocation failed for materials.\n");
+                return 0;
             }
+            st->materials = materials;
+            st->capMaterials = newCap;
         }
+        memcpy(st->materials[st->numMaterials++], surface->material, sizeof(surface->material));
     }
-    fclose(outFile);
     return 1;
 }
 
-/* --- End Merge Mode Functions --- */
+/* Picks the skin for a model (skinPath, or its default skin if skinPath is
+   NULL and one exists) and assigns its surfaces' materials */
+int prepare_materials(const char *modelPath, md3SurfaceData *surfaces, int numSurfaces, const char *skinPath) {
+    const md3Skin *skin;
+    if (skinPath) {
+        skin = load_skin_cached(skinPath);
+        if (!skin) {
+            fprintf(stderr, "Error reading skin %s\n", skinPath);
+            return 0;
+        }
+    } else {
+        char path[512];
+        default_skin_path(modelPath, path, sizeof(path));
+        skin = load_skin_cached(path);
+    }
+    return assign_materials(surfaces, numSurfaces, skin);
+}
+
+/* Writes the material library: one white diffuse material per texture */
+int write_mtl_to_stream(FILE *fp, const char *outputName) {
+    const md3MaterialState *st = &g_materialState;
+    if (fprintf(fp, "# %d materials\n", st->numMaterials) < 0) {
+        fprintf(stderr, "Error writing to %s\n", outputName);
+        return 0;
+    }
+    for (int m = 0; m < st->numMaterials; m++) {
+        if (fprintf(fp, "\nnewmtl %s\nKa 1.000000 1.000000 1.000000\nKd 1.000000 1.000000 1.000000\nmap_Kd %s\n",
+                    st->materials[m], st->materials[m]) < 0) {
+            fprintf(stderr, "Error writing to %s\n", outputName);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int write_mtl(const char *path) {
+    md3Clock clock;
+    stats_begin(&clock);
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        fprintf(stderr, "Error opening output file %s: %s\n", path, strerror(errno));
+        return 0;
+    }
+    int ok = write_mtl_to_stream(fp, path);
+    long bytes = ftell(fp);
+    if (fclose(fp) != 0) ok = 0;
+    stats_end(STAT_WRITE, &clock);
+    if (!ok) {
+        fprintf(stderr, "Failed writing %s\n", path);
+        return 0;
+    }
+    stats_add_bytes_written(bytes);
+    return 1;
+}
+
+void free_materials(void) {
+    md3MaterialState *st = &g_materialState;
+    for (int i = 0; i < st->numSkins; i++) free(st->skins[i].entries);
+    free(st->skins);
+    free(st->materials);
+    memset(st, 0, sizeof(*st));
+}
+
+/* --- End Materials and Skins --- */
 
+/* Writes every frame of a model: one OBJ per frame (into tarFile if given), or
+   a single multi-object OBJ in allFrames mode. Output names derive from basename. */
+int write_model_frames(const md3Header_t *header, md3SurfaceData *surfaces, int numSurfaces, const char *basename, int allFrames, FILE *tarFile, const char *tarOutput) {
+    /* Compute a global base index for each surface */
+    int globalIndex = 1;
+    for (int s = 0; s < numSurfaces; s++) {
+        surfaces[s].baseIndex = globalIndex;
+        globalIndex += surfaces[s].header.numVerts;
+    }
+    int numFrames = header->numFrames;
+    if (allFrames) {
+        char outFilename[512];
+        snprintf(outFilename, sizeof(outFilename), "%s.obj", basename);
+        printf("Writing %d frames to %s\n", numFrames, outFilename);
+        if (!write_obj_all_frames(header, surfaces, numSurfaces, outFilename)) {
+            fprintf(stderr, "Failed writing %s\n", outFilename);
+            return 0;
+        }
+        return 1;
+    }
+    /* If more than one frame, output one OBJ per frame; otherwise, a single file */
+    for (int frame = 0; frame < numFrames; frame++) {
+        char outFilename[512];
+        if (numFrames > 1) {
+            snprintf(outFilename, sizeof(outFilename), "%s+%d.obj", basename, frame);
+        } else {
+            snprintf(outFilename, sizeof(outFilename), "%s.obj", basename);
+        }
+        stats_frame_begin(frame, outFilename);
+        if (tarFile) {
+            printf("Writing frame %d to %s:%s\n", frame, tarOutput, outFilename);
+            md3Clock clock;
+            long headerPos;
+            stats_begin(&clock);
+            int entryOk = tar_begin_entry(tarFile, &headerPos);
+            stats_end(STAT_WRITE, &clock);
+            entryOk = entryOk && write_obj_frame_to_stream(tarFile, header, surfaces, numSurfaces, frame, tarOutput);
+            stats_begin(&clock);
+            entryOk = entryOk && tar_end_entry(tarFile, headerPos, outFilename);
+            stats_end(STAT_WRITE, &clock);
+            stats_frame_end();
+            if (!entryOk) {
+                if (headerPos >= 0) tar_abort_entry(tarFile, headerPos);
+                fprintf(stderr, "Failed writing frame %d\n", frame);
+                return 0;
+            }
+            stats_add_bytes_written(ftell(tarFile) - headerPos);
+            continue;
+        }
+        printf("Writing frame %d to %s\n", frame, outFilename);
+        if (!write_obj_frame(header, surfaces, numSurfaces, frame, outFilename)) {
+            fprintf(stderr, "Failed writing frame %d\n", frame);
+        } else if (g_verify && !verify_obj_frame(outFilename, surfaces, numSurfaces, frame)) {
+            stats_frame_end();
+            return 0;
+        }
+        stats_frame_end();
+    }
+    return 1;
+}
+
+#ifndef MD3TOOBJ_NO_MAIN
 /* Main: parses command-line arguments and selects mode */
 int main(int argc, char *argv[]) {
     if (argc < 2) {
         printf("Usage: %s [options] input.md3 [output.obj | output_directory]\n", argv[0]);
+        printf("  Inputs may also be MD2 (Quake II), MDC (RtCW) or MDR (skeletal) models.\n");
         printf("  Options:\n");
         printf("    -flipUVs or -noFlipUVs\n");
         printf("    -swapYZ or -noSwapYZ\n");
         printf("    -merge (merge multiple MD3 files into one OBJ)\n");
+        printf("    -toMD3 output.md3 input.obj [input2.obj ...] (encode OBJ frames, or one -allFrames OBJ, as MD3)\n");
+        printf("    -tagsFrom model.md3 (copy tags into the -toMD3 output)\n");
+        printf("    -tar archive.tar (write every frame into a single tar archive)\n");
+        printf("    -allFrames (write every frame into one OBJ as separate objects)\n");
+        printf("    -stats report.json (write per-phase timing and size statistics as JSON, \"-\" for stdout, moving progress to stderr)\n");
+        printf("    -lod N (also write N simplified levels of detail as name_lodN)\n");
+        printf("    -lodRatio r (triangle ratio kept per LOD level, default 0.5)\n");
+        printf("    -optimizeCache (reorder triangles and vertices for GPU vertex cache efficiency and less overdraw)\n");
+        printf("    -meshlets file.bin (write meshlets with per-frame bounds and normal cones to a sidecar)\n");
+        printf("    -bounds file.json (write header and recomputed per-frame bounds, flagging wrong ones)\n");
+        printf("    -tags file.json|file.csv (write every tag's origin and axis for every frame)\n");
+        printf("    -mtl (write name.mtl with a material per surface texture and usemtl in the faces)\n");
+        printf("    -skin file.skin (take surface textures from a .skin, implies -mtl; default name_default.skin)\n");
+        printf("    -threads N (worker threads for parallel passes, default one per CPU)\n");
+        printf("    -verify (read each written OBJ frame back and check it against the model)\n");
+        printf("    -rewrite output.md3 (write a packed, welded MD3 instead of OBJ frames)\n");
+        printf("    -stripSurfaces a,b / -stripTags a,b (surfaces and tags to leave out of -rewrite)\n");
+        printf("    -frames first-last (keep only this frame range)\n");
+        printf("    -anim file.md3a (write delta-compressed vertex animation, see md3anim.h)\n");
+        printf("    -animStep n (position quantization step for -anim in 1/64 units, default 1 = lossless)\n");
+        printf("    -iqm file.iqm (write an IQM with all frames as vertex animation and tags as joints)\n");
+        printf("    -keyframes tol (drop frames that interpolation reproduces within tol units; writes name_keyframes.json)\n");
+        printf("    -fps n (source frame rate for keyframe timing and -resample, default 20)\n");
+        printf("    -resample fps (interpolate the animation to a new frame rate)\n");
+        printf("    -resampleFrames N (interpolate the animation to N frames)\n");
         return 1;
     }
     
     int mergeMode = 0;
-    /* For merge mode, use separate variables */
+    int toMD3Mode = 0;
+    char *tagsFrom = NULL;
+    /* For merge and -toMD3 mode (an output followed by inputs), use separate variables */
     char *mergeOutput = NULL;
     char **mergeInput = NULL;
     int numMergeInput = 0;
@@ -552,6 +6047,28 @@ int main(int argc, char *argv[]) {
     /* For single-file mode */
     char *inputFile = NULL;
     char *outputFile = NULL;
+    char *tarOutput = NULL;
+    int allFrames = 0;
+    char *statsOutput = NULL;
+    int lodLevels = 0;
+    double lodRatio = 0.5;
+    int optimizeCache = 0;
+    char *meshletOutput = NULL;
+    char *boundsOutput = NULL;
+    char *animOutput = NULL;
+    int animStep = 1;
+    char *iqmOutput = NULL;
+    char *tagsOutput = NULL;
+    int writeMtl = 0;
+    char *skinFile = NULL;
+    double keyframeTolerance = -1.0;
+    double fps = 20.0;
+    double resampleFps = 0.0;
+    int resampleCount = 0;
+    char *rewriteOutput = NULL;
+    char *stripSurfaceNames = NULL;
+    char *stripTagNames = NULL;
+    int firstFrame = -1, lastFrame = -1;
     
     /* Parse command-line arguments */
     for (int i = 1; i < argc; i++) {
@@ -565,7 +6082,63 @@ int main(int argc, char *argv[]) {
             g_swapYZ = 0;
         } else if (strcmp(argv[i], "-merge") == 0) {
             mergeMode = 1;
-        } else if (mergeMode) {
+        } else if (strcmp(argv[i], "-toMD3") == 0) {
+            toMD3Mode = 1;
+        } else if (strcmp(argv[i], "-tagsFrom") == 0 && i + 1 < argc) {
+            tagsFrom = argv[++i];
+        } else if (strcmp(argv[i], "-tar") == 0 && i + 1 < argc) {
+            tarOutput = argv[++i];
+        } else if (strcmp(argv[i], "-allFrames") == 0) {
+            allFrames = 1;
+        } else if (strcmp(argv[i], "-stats") == 0 && i + 1 < argc) {
+            statsOutput = argv[++i];
+        } else if (strcmp(argv[i], "-lod") == 0 && i + 1 < argc) {
+            lodLevels = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-lodRatio") == 0 && i + 1 < argc) {
+            lodRatio = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-optimizeCache") == 0) {
+            optimizeCache = 1;
+        } else if (strcmp(argv[i], "-meshlets") == 0 && i + 1 < argc) {
+            meshletOutput = argv[++i];
+        } else if (strcmp(argv[i], "-bounds") == 0 && i + 1 < argc) {
+            boundsOutput = argv[++i];
+        } else if (strcmp(argv[i], "-anim") == 0 && i + 1 < argc) {
+            animOutput = argv[++i];
+        } else if (strcmp(argv[i], "-mtl") == 0) {
+            writeMtl = 1;
+        } else if (strcmp(argv[i], "-skin") == 0 && i + 1 < argc) {
+            skinFile = argv[++i];
+            writeMtl = 1;
+        } else if (strcmp(argv[i], "-tags") == 0 && i + 1 < argc) {
+            tagsOutput = argv[++i];
+        } else if (strcmp(argv[i], "-iqm") == 0 && i + 1 < argc) {
+            iqmOutput = argv[++i];
+        } else if (strcmp(argv[i], "-animStep") == 0 && i + 1 < argc) {
+            animStep = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-keyframes") == 0 && i + 1 < argc) {
+            keyframeTolerance = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-fps") == 0 && i + 1 < argc) {
+            fps = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-resample") == 0 && i + 1 < argc) {
+            resampleFps = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-resampleFrames") == 0 && i + 1 < argc) {
+            resampleCount = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-rewrite") == 0 && i + 1 < argc) {
+            rewriteOutput = argv[++i];
+        } else if (strcmp(argv[i], "-stripSurfaces") == 0 && i + 1 < argc) {
+            stripSurfaceNames = argv[++i];
+        } else if (strcmp(argv[i], "-stripTags") == 0 && i + 1 < argc) {
+            stripTagNames = argv[++i];
+        } else if (strcmp(argv[i], "-frames") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%d-%d", &firstFrame, &lastFrame) != 2) {
+                fprintf(stderr, "-frames expects first-last, e.g. 0-39.\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "-verify") == 0) {
+            g_verify = 1;
+        } else if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc) {
+            g_numThreads = atoi(argv[++i]);
+        } else if (mergeMode || toMD3Mode) {
             if (!mergeOutput && argv[i][0] != '-') {
                 mergeOutput = argv[i];
             } else if (!mergeInput && argv[i][0] != '-') {
@@ -582,7 +6155,78 @@ int main(int argc, char *argv[]) {
         }
     }
     
-    if (mergeMode) {
+    if (allFrames && tarOutput) {
+        fprintf(stderr, "-allFrames and -tar cannot be combined.\n");
+        return 1;
+    }
+    if (tarOutput && (mergeMode || toMD3Mode)) {
+        fprintf(stderr, "-tar only packs the per-frame OBJ files of single-file mode.\n");
+        return 1;
+    }
+    if (g_verify && (allFrames || tarOutput || mergeMode || toMD3Mode)) {
+        fprintf(stderr, "-verify only checks the one-OBJ-per-frame output of single-file mode.\n");
+        return 1;
+    }
+    if ((meshletOutput || boundsOutput || animOutput || iqmOutput || tagsOutput) && (mergeMode || toMD3Mode)) {
+        fprintf(stderr, "-meshlets, -bounds, -anim, -iqm and -tags are only supported in single-file mode.\n");
+        return 1;
+    }
+    if ((rewriteOutput || firstFrame >= 0) && (mergeMode || toMD3Mode)) {
+        fprintf(stderr, "-rewrite and -frames are only supported in single-file mode.\n");
+        return 1;
+    }
+    if (rewriteOutput && (allFrames || tarOutput || g_verify || lodLevels > 0)) {
+        fprintf(stderr, "-rewrite writes no OBJ frames; -allFrames, -tar, -verify and -lod do not apply.\n");
+        return 1;
+    }
+    if ((lodLevels > 0 || allFrames || optimizeCache) && toMD3Mode) {
+        fprintf(stderr, "-lod, -allFrames and -optimizeCache apply to MD3 input, not to -toMD3.\n");
+        return 1;
+    }
+    if (writeMtl && (rewriteOutput || toMD3Mode)) {
+        fprintf(stderr, "-mtl and -skin apply to OBJ output, not to -rewrite or -toMD3.\n");
+        return 1;
+    }
+    if ((stripSurfaceNames || stripTagNames) && !rewriteOutput) {
+        fprintf(stderr, "-stripSurfaces and -stripTags need -rewrite.\n");
+        return 1;
+    }
+    if (fps <= 0.0) {
+        fprintf(stderr, "-fps must be positive.\n");
+        return 1;
+    }
+    if ((keyframeTolerance >= 0.0 || resampleFps != 0.0 || resampleCount != 0) && (mergeMode || toMD3Mode)) {
+        fprintf(stderr, "-keyframes and -resample are only supported in single-file mode.\n");
+        return 1;
+    }
+    if (resampleFps < 0.0 || resampleCount < 0 || (resampleFps > 0.0 && resampleCount > 0)) {
+        fprintf(stderr, "Use either -resample with a positive fps or -resampleFrames with a positive count.\n");
+        return 1;
+    }
+    if (animStep < 1) {
+        fprintf(stderr, "-animStep must be at least 1.\n");
+        return 1;
+    }
+    if (lodLevels < 0 || lodRatio <= 0.0 || lodRatio >= 1.0) {
+        fprintf(stderr, "-lod needs a non-negative level count and -lodRatio a value between 0 and 1.\n");
+        return 1;
+    }
+    if (statsOutput) {
+        stats_enable();
+        if (strcmp(statsOutput, "-") == 0 && !stats_claim_stdout()) {
+            return 1;
+        }
+    }
+    if (toMD3Mode) {
+        if (mergeMode || !mergeOutput || numMergeInput < 1) {
+            fprintf(stderr, "-toMD3 requires an output MD3 file followed by at least one input OBJ file.\n");
+            return 1;
+        }
+        printf("Encoding %d input file(s) to %s\n", numMergeInput, mergeOutput);
+        if (!write_md3_from_obj(mergeOutput, mergeInput, numMergeInput, tagsFrom)) {
+            return 1;
+        }
+    } else if (mergeMode) {
         if (!mergeOutput || numMergeInput < 2) {
             fprintf(stderr, "Merge mode requires an output file followed by at least two input MD3 files.\n");
             return 1;
@@ -596,6 +6240,9 @@ int main(int argc, char *argv[]) {
         for (int i = 0; i < numMergeInput; i++) {
             if (load_md3_file(mergeInput[i], &files[i])) {
                 loaded++;
+                if (optimizeCache && !optimize_surfaces_cache(files[i].surfaces, files[i].numSurfaces)) {
+                    fprintf(stderr, "Cache optimization failed for %s, writing it unoptimized\n", mergeInput[i]);
+                }
             } else {
                 fprintf(stderr, "Failed to load %s\n", mergeInput[i]);
             }
@@ -603,26 +6250,34 @@ int main(int argc, char *argv[]) {
         if (loaded < 2) {
             fprintf(stderr, "At least two MD3 files must be loaded successfully for merge mode.\n");
             for (int i = 0; i < numMergeInput; i++) {
-                if (files[i].surfaces) {
-                    free_surfaces(files[i].surfaces, files[i].numSurfaces);
-                }
-                if (files[i].tags) {
-                    free(files[i].tags);
-                }
+                free_md3_file(&files[i]);
             }
             free(files);
             return 1;
         }
-        if (!write_merged_obj(files, numMergeInput, mergeOutput)) {
+        char mtlPath[512];
+        int materialsOk = 1;
+        if (writeMtl) {
+            snprintf(mtlPath, sizeof(mtlPath), "%s", mergeOutput);
+            char *slash = strrchr(mtlPath, '/');
+            char *dot = strrchr(mtlPath, '.');
+            if (dot && (!slash || dot > slash)) *dot = '\0';
+            strncat(mtlPath, ".mtl", sizeof(mtlPath) - strlen(mtlPath) - 1);
+            for (int i = 0; materialsOk && i < numMergeInput; i++) {
+                materialsOk = prepare_materials(mergeInput[i], files[i].surfaces, files[i].numSurfaces, skinFile);
+            }
+            printf("Writing materials to %s\n", mtlPath);
+            materialsOk = materialsOk && write_mtl(mtlPath);
+            slash = strrchr(mtlPath, '/');
+            g_mtlLib = slash ? slash + 1 : mtlPath;
+        }
+        if (!materialsOk) {
+            fprintf(stderr, "Failed writing the material library.\n");
+        } else if (!write_merged_obj(files, numMergeInput, mergeOutput)) {
             fprintf(stderr, "Failed writing merged OBJ file.\n");
         }
         for (int i = 0; i < numMergeInput; i++) {
-            if (files[i].surfaces) {
-                free_surfaces(files[i].surfaces, files[i].numSurfaces);
-            }
-            if (files[i].tags) {
-                free(files[i].tags);
-            }
+            free_md3_file(&files[i]);
         }
         free(files);
     } else {
@@ -631,57 +6286,166 @@ int main(int argc, char *argv[]) {
             fprintf(stderr, "No input file specified.\n");
             return 1;
         }
-        FILE *inFile = fopen(inputFile, "rb");
-        if (!inFile) {
-            perror("Error opening input file");
-            return 1;
-        }
-        long fileSize = getFileSize(inFile);
-        if (fileSize < 0) {
-            fclose(inFile);
+        md3FileData model;
+        memset(&model, 0, sizeof(model));
+        if (!load_md3_file(inputFile, &model)) {
+            free_md3_file(&model);
             return 1;
         }
-        md3Header_t header;
-        if (!read_md3_header(inFile, &header, fileSize)) {
-            fclose(inFile);
-            return 1;
-        }
-        printf("Model: %s\nFrames: %d, Surfaces: %d\n", header.name, header.numFrames, header.numSurfaces);
-        int numSurfaces = 0;
-        md3SurfaceData *surfaces = read_md3_surfaces(inFile, &header, &numSurfaces);
-        fclose(inFile);
-        if (!surfaces) {
-            return 1;
-        }
-        /* Compute a global base index for each surface */
-        int globalIndex = 1;
-        for (int s = 0; s < numSurfaces; s++) {
-            surfaces[s].baseIndex = globalIndex;
-            globalIndex += surfaces[s].header.numVerts;
-        }
+        printf("Model: %s\nFrames: %d, Surfaces: %d\n", model.header.name, model.header.numFrames, model.header.numSurfaces);
         char basename[256];
         if (outputFile) {
             getBasename(outputFile, basename, sizeof(basename));
         } else {
             getBasename(inputFile, basename, sizeof(basename));
         }
-        int numFrames = header.numFrames;
-        /* If more than one frame, output one OBJ per frame; otherwise, a single file */
-        for (int frame = 0; frame < numFrames; frame++) {
-            char outFilename[512];
-            if (numFrames > 1) {
-                snprintf(outFilename, sizeof(outFilename), "%s+%d.obj", basename, frame);
+        /* Frame selection, resampling and keyframe reduction change the
+           frame count every later stage sees, in that order */
+        if (firstFrame >= 0 && !select_frame_range(&model, firstFrame, lastFrame)) {
+            free_md3_file(&model);
+            return 1;
+        }
+        if (resampleFps > 0.0 || resampleCount > 0) {
+            int newCount = resampleCount;
+            if (resampleFps > 0.0) {
+                double count = round(model.header.numFrames * resampleFps / fps);
+                if (count > INT_MAX) {
+                    fprintf(stderr, "-resample %g would produce too many frames.\n", resampleFps);
+                    free_md3_file(&model);
+                    return 1;
+                }
+                newCount = (int) count;
+                fps = resampleFps;
             } else {
-                snprintf(outFilename, sizeof(outFilename), "%s.obj", basename);
+                fps = fps * newCount / model.header.numFrames;
             }
-            printf("Writing frame %d to %s\n", frame, outFilename);
-            if (!write_obj_frame(&header, surfaces, numSurfaces, frame, outFilename)) {
-                fprintf(stderr, "Failed writing frame %d\n", frame);
+            if (newCount < 1) newCount = 1;
+            if (model.header.numFrames < 1 || !resample_frames(&model, newCount)) {
+                free_md3_file(&model);
+                return 1;
+            }
+        }
+        if (keyframeTolerance >= 0.0) {
+            int numSourceFrames = model.header.numFrames;
+            int *sourceFrames = (int*) malloc((numSourceFrames > 0 ? numSourceFrames : 1) * sizeof(int));
+            char timingName[300];
+            snprintf(timingName, sizeof(timingName), "%s_keyframes.json", basename);
+            int kept = sourceFrames ? reduce_keyframes(&model, keyframeTolerance, sourceFrames) : 0;
+            if (!sourceFrames) {
+                fprintf(stderr, "Memory allocation failed for keyframe reduction.\n");
+            }
+            if (kept) {
+                printf("Writing keyframe timing to %s\n", timingName);
+            }
+            if (!kept || !write_keyframe_json(timingName, sourceFrames, kept, numSourceFrames, fps, keyframeTolerance)) {
+                free(sourceFrames);
+                free_md3_file(&model);
+                return 1;
+            }
+            free(sourceFrames);
+        }
+        md3Header_t header = model.header;
+        md3SurfaceData *surfaces = model.surfaces;
+        int numSurfaces = model.numSurfaces;
+        FILE *tarFile = NULL;
+        if (tarOutput) {
+            tarFile = fopen(tarOutput, "wb");
+            if (!tarFile) {
+                fprintf(stderr, "Error opening output file %s: %s\n", tarOutput, strerror(errno));
+                free_md3_file(&model);
+                return 1;
+            }
+        }
+        int ok = 1;
+        char mtlName[300];
+        if (writeMtl) {
+            snprintf(mtlName, sizeof(mtlName), "%s.mtl", basename);
+            ok = prepare_materials(inputFile, model.surfaces, model.numSurfaces, skinFile);
+            if (ok && tarFile) {
+                /* The library goes into the archive ahead of the frames */
+                long headerPos;
+                printf("Writing materials to %s:%s\n", tarOutput, mtlName);
+                ok = tar_begin_entry(tarFile, &headerPos) &&
+                     write_mtl_to_stream(tarFile, tarOutput) &&
+                     tar_end_entry(tarFile, headerPos, mtlName);
+                if (ok) {
+                    stats_add_bytes_written(ftell(tarFile) - headerPos);
+                } else if (headerPos >= 0) {
+                    tar_abort_entry(tarFile, headerPos);
+                }
+            } else if (ok) {
+                printf("Writing materials to %s\n", mtlName);
+                ok = write_mtl(mtlName);
+            }
+            g_mtlLib = mtlName;
+        }
+        if (ok && rewriteOutput) {
+            printf("Rewriting to %s\n", rewriteOutput);
+            ok = rewrite_md3(rewriteOutput, &model, stripSurfaceNames, stripTagNames, optimizeCache);
+            header = model.header;
+            surfaces = model.surfaces;
+            numSurfaces = model.numSurfaces;
+        } else if (ok) {
+            ok = !optimizeCache || optimize_surfaces_cache(surfaces, numSurfaces);
+            ok = ok && write_model_frames(&header, surfaces, numSurfaces, basename, allFrames, tarFile, tarOutput);
+        }
+        if (ok && meshletOutput) {
+            printf("Writing meshlets to %s\n", meshletOutput);
+            ok = write_meshlets(meshletOutput, surfaces, numSurfaces, header.numFrames);
+        }
+        if (ok && boundsOutput) {
+            printf("Writing frame bounds to %s\n", boundsOutput);
+            ok = write_bounds_json(boundsOutput, &model);
+        }
+        if (ok && animOutput) {
+            printf("Writing animation to %s\n", animOutput);
+            ok = write_anim(animOutput, &model, animStep);
+        }
+        if (ok && iqmOutput) {
+            printf("Writing IQM to %s\n", iqmOutput);
+            ok = write_iqm(iqmOutput, &model, fps);
+        }
+        if (ok && tagsOutput) {
+            printf("Writing tag tracks to %s\n", tagsOutput);
+            ok = write_tag_tracks(tagsOutput, &model, fps);
+        }
+        /* Simplified levels of detail, written alongside the full model */
+        for (int level = 1; ok && level <= lodLevels; level++) {
+            char lodName[300];
+            snprintf(lodName, sizeof(lodName), "%s_lod%d", basename, level);
+            md3SurfaceData *lodSurfaces = build_lod_surfaces(surfaces, numSurfaces, pow(lodRatio, level));
+            if (!lodSurfaces) {
+                ok = 0;
+                break;
+            }
+            ok = !optimizeCache || optimize_surfaces_cache(lodSurfaces, numSurfaces);
+            ok = ok && write_model_frames(&header, lodSurfaces, numSurfaces, lodName, allFrames, tarFile, tarOutput);
+            free_surfaces(lodSurfaces, numSurfaces);
+        }
+        if (tarFile) {
+            md3Clock clock;
+            stats_begin(&clock);
+            int finished = tar_finish(tarFile);
+            stats_add_bytes_written(TAR_BLOCK_SIZE * 2);
+            if (fclose(tarFile) != 0 || !finished) {
+                fprintf(stderr, "Failed writing %s\n", tarOutput);
+                ok = 0;
             }
+            stats_end(STAT_WRITE, &clock);
+        }
+        free_md3_file(&model);
+        if (!ok) {
+            return 1;
         }
-        free_surfaces(surfaces, numSurfaces);
     }
+    free_materials();
     
+    if (statsOutput) {
+        int written = write_stats_json(statsOutput, toMD3Mode ? "toMD3" : (mergeMode ? "merge" : "single"));
+        stats_free();
+        if (!written) return 1;
+    }
     printf("Conversion completed successfully.\n");
     return 0;
 }
+#endif /* MD3TOOBJ_NO_MAIN */
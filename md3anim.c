@@ -0,0 +1,148 @@
+/*
+    MD3A decoder (see md3anim.h for the format)
+    Self-contained: link md3anim.c into a runtime to stream animations
+    written by md3toobj -anim.
+*/
+
+#include <string.h>
+#include "md3anim.h"
+
+/* Reads one unsigned LEB128 varint; returns 0 on truncated/overlong input */
+int md3anim_read_varint(const unsigned char **cursor, const unsigned char *end, unsigned int *value) {
+    unsigned int result = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (*cursor >= end) return 0;
+        unsigned char byte = *(*cursor)++;
+        result |= (unsigned int)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            *value = result;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int md3anim_zigzag_decode(unsigned int value) {
+    return (int)(value >> 1) ^ -(int)(value & 1);
+}
+
+/* Frame data is a zero-run coded value stream: token 0 is followed by a
+   zero count, any other token is a zigzag-coded non-zero value */
+typedef struct {
+    const unsigned char *p, *end;
+    unsigned int zeros;
+} md3animReader;
+
+int md3anim_read_value(md3animReader *r, int *value) {
+    unsigned int token;
+    if (r->zeros > 0) {
+        r->zeros--;
+        *value = 0;
+        return 1;
+    }
+    if (!md3anim_read_varint(&r->p, r->end, &token)) return 0;
+    if (token == 0) {
+        if (!md3anim_read_varint(&r->p, r->end, &r->zeros) || r->zeros == 0) return 0;
+        r->zeros--;
+        *value = 0;
+        return 1;
+    }
+    *value = md3anim_zigzag_decode(token);
+    return 1;
+}
+
+unsigned int md3anim_read_u32(const unsigned char *p) {
+    return (unsigned int) p[0] | ((unsigned int) p[1] << 8) | ((unsigned int) p[2] << 16) | ((unsigned int) p[3] << 24);
+}
+
+int md3anim_surface(const md3Anim *anim, int s, md3AnimSurface_t *surface) {
+    if (s < 0 || s >= anim->header.numSurfaces) return 0;
+    memcpy(surface, anim->data + sizeof(md3AnimHeader_t) + (size_t) s * sizeof(md3AnimSurface_t), sizeof(*surface));
+    return 1;
+}
+
+/* Locates the byte range of one frame of one surface */
+int md3anim_frame_range(const md3Anim *anim, int s, int frame, const unsigned char **begin, const unsigned char **end, int *numVerts) {
+    md3AnimSurface_t surface;
+    if (!md3anim_surface(anim, s, &surface) || frame < 0 || frame >= anim->header.numFrames) return 0;
+    const unsigned char *table = anim->data + surface.ofsFrameTable;
+    unsigned int a = md3anim_read_u32(table + (size_t) frame * 4);
+    unsigned int b = md3anim_read_u32(table + (size_t)(frame + 1) * 4);
+    *begin = anim->data + a;
+    *end = anim->data + b;
+    *numVerts = surface.numVerts;
+    return 1;
+}
+
+int md3anim_open(md3Anim *anim, const void *data, size_t size) {
+    memset(anim, 0, sizeof(*anim));
+    if (size < sizeof(md3AnimHeader_t)) return 0;
+    memcpy(&anim->header, data, sizeof(md3AnimHeader_t));
+    const md3AnimHeader_t *h = &anim->header;
+    if (memcmp(h->id, MD3ANIM_ID, 4) != 0 || h->version != MD3ANIM_VERSION) return 0;
+    if (h->numSurfaces < 0 || h->numFrames < 1 || h->quantStep < 1) return 0;
+    if ((size - sizeof(md3AnimHeader_t)) / sizeof(md3AnimSurface_t) < (size_t) h->numSurfaces) return 0;
+    anim->data = (const unsigned char*) data;
+    anim->size = size;
+    for (int s = 0; s < h->numSurfaces; s++) {
+        md3AnimSurface_t surface;
+        md3anim_surface(anim, s, &surface);
+        if (surface.numVerts < 0) return 0;
+        size_t tableBytes = ((size_t) h->numFrames + 1) * 4;
+        if (surface.ofsFrameTable > size || size - surface.ofsFrameTable < tableBytes) return 0;
+        /* Offsets must be ordered and in range; frame 0 has a fixed size */
+        const unsigned char *table = anim->data + surface.ofsFrameTable;
+        unsigned int prev = md3anim_read_u32(table);
+        for (int f = 1; f <= h->numFrames; f++) {
+            unsigned int next = md3anim_read_u32(table + (size_t) f * 4);
+            if (next < prev || next > size) return 0;
+            if (f == 1 && (size_t)(next - prev) != (size_t) surface.numVerts * 8) return 0;
+            prev = next;
+        }
+    }
+    return 1;
+}
+
+int md3anim_decode_first(const md3Anim *anim, int s, short *xyz, unsigned short *normals) {
+    const unsigned char *p, *end;
+    int numVerts;
+    if (!md3anim_frame_range(anim, s, 0, &p, &end, &numVerts)) return 0;
+    for (int v = 0; v < numVerts; v++, p += 8) {
+        for (int k = 0; k < 3; k++) {
+            xyz[v * 3 + k] = (short)(unsigned short)(p[k * 2] | (p[k * 2 + 1] << 8));
+        }
+        normals[v] = (unsigned short)(p[6] | (p[7] << 8));
+    }
+    return 1;
+}
+
+int md3anim_decode_next(const md3Anim *anim, int s, int frame, short *xyz, unsigned short *normals) {
+    const unsigned char *p, *end;
+    int numVerts;
+    if (frame < 1 || !md3anim_frame_range(anim, s, frame, &p, &end, &numVerts)) return 0;
+    int step = anim->header.quantStep;
+    md3animReader r = { p, end, 0 };
+    for (int v = 0; v < numVerts; v++) {
+        int delta;
+        for (int k = 0; k < 3; k++) {
+            if (!md3anim_read_value(&r, &delta)) return 0;
+            /* Unsigned arithmetic keeps corrupt deltas from overflowing */
+            xyz[v * 3 + k] = (short)(unsigned short)((unsigned int) xyz[v * 3 + k] + (unsigned int) delta * (unsigned int) step);
+        }
+        unsigned int lat = normals[v] >> 8, lng = normals[v] & 0xff;
+        if (!md3anim_read_value(&r, &delta)) return 0;
+        lat = (lat + (unsigned int) delta) & 0xff;
+        if (!md3anim_read_value(&r, &delta)) return 0;
+        lng = (lng + (unsigned int) delta) & 0xff;
+        normals[v] = (unsigned short)((lat << 8) | lng);
+    }
+    return r.p == r.end && r.zeros == 0;
+}
+
+int md3anim_decode_frame(const md3Anim *anim, int s, int frame, short *xyz, unsigned short *normals) {
+    if (!md3anim_decode_first(anim, s, xyz, normals)) return 0;
+    for (int f = 1; f <= frame; f++) {
+        if (!md3anim_decode_next(anim, s, f, xyz, normals)) return 0;
+    }
+    return 1;
+}
@@ -0,0 +1,72 @@
+/*
+    MD3A: delta-compressed MD3 vertex animation
+    Written by md3toobj -anim, read with the decoder in md3anim.c.
+
+    Frame 0 of every surface is stored absolute (int16 xyz in 1/64 units
+    plus the packed lat/lng normal, exactly as in the MD3). Every later frame
+    stores, per vertex, the difference from the previous decoded frame: dx,
+    dy, dz in multiples of quantStep, then the lat and lng normal bytes as
+    signed 8-bit differences (wrapping mod 256). The frame's values form one
+    stream of LEB128 varint tokens: token 0 is followed by a count of zero
+    values, any other token is a zigzag-coded non-zero value.
+    quantStep 1 is lossless. Larger steps are encoded against the decoded
+    previous frame (closed loop), so the position error stays within
+    quantStep/2 units on every frame instead of accumulating.
+
+    Layout (little-endian):
+      md3AnimHeader_t
+      md3AnimSurface_t   [numSurfaces]
+      per surface: unsigned int frameOffsets[numFrames + 1]
+                   (file offsets; frame f spans [f], [f + 1])
+                   followed by that surface's frame data
+*/
+
+#ifndef MD3ANIM_H
+#define MD3ANIM_H
+
+#include <stddef.h>
+
+#define MD3ANIM_ID "MD3A"
+#define MD3ANIM_VERSION 1
+
+#pragma pack(push, 1)
+typedef struct {
+    char id[4];           // "MD3A"
+    int version;          // MD3ANIM_VERSION
+    int numSurfaces;
+    int numFrames;
+    int quantStep;        // position delta step in 1/64 units, 1 = lossless
+} md3AnimHeader_t;
+
+typedef struct {
+    char name[64];
+    int numVerts;
+    unsigned int ofsFrameTable;   // offset of this surface's frameOffsets
+} md3AnimSurface_t;
+#pragma pack(pop)
+
+/* A validated view of an MD3A file held in memory (not copied) */
+typedef struct {
+    const unsigned char *data;
+    size_t size;
+    md3AnimHeader_t header;
+} md3Anim;
+
+/* Validates the header, surface table and frame tables. Returns 1 on success. */
+int md3anim_open(md3Anim *anim, const void *data, size_t size);
+
+/* Copies surface s's table entry. Returns 1 on success. */
+int md3anim_surface(const md3Anim *anim, int s, md3AnimSurface_t *surface);
+
+/* Decodes frame 0 of surface s into caller-owned buffers: xyz holds
+   numVerts * 3 shorts, normals numVerts packed normals. */
+int md3anim_decode_first(const md3Anim *anim, int s, short *xyz, unsigned short *normals);
+
+/* Advances buffers holding frame - 1 of surface s to frame (frame >= 1).
+   Streaming playback calls this once per frame. */
+int md3anim_decode_next(const md3Anim *anim, int s, int frame, short *xyz, unsigned short *normals);
+
+/* Decodes an arbitrary frame by replaying the deltas from frame 0 */
+int md3anim_decode_frame(const md3Anim *anim, int s, int frame, short *xyz, unsigned short *normals);
+
+#endif
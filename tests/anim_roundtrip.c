@@ -0,0 +1,93 @@
+/*
+    Decodes an MD3A file with md3anim.c and checks every frame against the
+    source MD3: positions within quantStep/2 units, normals exact.
+    Usage: anim_roundtrip model.md3 anim.md3a
+    Exit status: 0 match, 1 mismatch, 2 error.
+*/
+
+#define MD3TOOBJ_NO_MAIN
+#include "../main.c"
+#include "../md3anim.h"
+
+int check_surface(const md3Anim *anim, int s, const md3SurfaceData *surface, int numFrames) {
+    int numVerts = surface->header.numVerts;
+    short *xyz = (short*) malloc((size_t)(numVerts > 0 ? numVerts : 1) * 3 * sizeof(short));
+    unsigned short *normals = (unsigned short*) malloc((size_t)(numVerts > 0 ? numVerts : 1) * sizeof(unsigned short));
+    if (!xyz || !normals) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        free(xyz);
+        free(normals);
+        return 0;
+    }
+    int limit = anim->header.quantStep / 2;
+    int ok = md3anim_decode_first(anim, s, xyz, normals);
+    for (int f = 0; ok && f < numFrames; f++) {
+        if (f > 0 && !md3anim_decode_next(anim, s, f, xyz, normals)) {
+            fprintf(stderr, "%s: frame %d failed to decode\n", surface->header.name, f);
+            ok = 0;
+            break;
+        }
+        const md3Vertex_t *src = surface->vertices + (size_t) f * numVerts;
+        for (int v = 0; ok && v < numVerts; v++) {
+            for (int k = 0; k < 3; k++) {
+                if (abs(xyz[v * 3 + k] - src[v].xyz[k]) > limit) {
+                    fprintf(stderr, "%s: frame %d vertex %d position off by %d\n",
+                            surface->header.name, f, v, xyz[v * 3 + k] - src[v].xyz[k]);
+                    ok = 0;
+                }
+            }
+            if (normals[v] != (unsigned short) src[v].normal) {
+                fprintf(stderr, "%s: frame %d vertex %d normal differs\n", surface->header.name, f, v);
+                ok = 0;
+            }
+        }
+    }
+    free(xyz);
+    free(normals);
+    return ok;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s model.md3 anim.md3a\n", argv[0]);
+        return 2;
+    }
+    md3FileData model;
+    memset(&model, 0, sizeof(model));
+    if (!load_md3_file(argv[1], &model)) {
+        free_md3_file(&model);
+        return 2;
+    }
+    FILE *fp = fopen(argv[2], "rb");
+    if (!fp) {
+        fprintf(stderr, "Error opening %s: %s\n", argv[2], strerror(errno));
+        free_md3_file(&model);
+        return 2;
+    }
+    long size = getFileSize(fp);
+    unsigned char *data = (unsigned char*) malloc(size > 0 ? (size_t) size : 1);
+    if (!data || size < 0 || fread(data, 1, (size_t) size, fp) != (size_t) size) {
+        fprintf(stderr, "Error reading %s\n", argv[2]);
+        fclose(fp);
+        free(data);
+        free_md3_file(&model);
+        return 2;
+    }
+    fclose(fp);
+    md3Anim anim;
+    int ok = md3anim_open(&anim, data, (size_t) size) &&
+             anim.header.numSurfaces == model.numSurfaces &&
+             anim.header.numFrames == model.header.numFrames;
+    if (!ok) {
+        fprintf(stderr, "%s is not a valid animation of %s\n", argv[2], argv[1]);
+    }
+    for (int s = 0; ok && s < model.numSurfaces; s++) {
+        ok = check_surface(&anim, s, &model.surfaces[s], model.header.numFrames);
+    }
+    if (ok) {
+        printf("%s: %d frames match (quantStep %d)\n", argv[2], anim.header.numFrames, anim.header.quantStep);
+    }
+    free(data);
+    free_md3_file(&model);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,311 @@
+/*
+    Fuzz harness for the model loader. Each input goes through
+    load_model_buffer(), the in-memory parser behind load_md3_file(): MD3
+    validation, header, tags, frames and surfaces (MD2/MDC/MDR by magic).
+    Every triangle, texture coordinate, vertex frame and tag of an accepted
+    model is then read once, as the unchecked conversion loops would.
+    Build:
+      make fuzz          standalone, ASan + trapping UBSan -> build/fuzz_loader
+      libFuzzer          clang -g -O1 -fsanitize=fuzzer,address,undefined -DMD3_LIBFUZZER
+                           -o fuzz_loader tests/fuzz_loader.c -lm -pthread
+      AFL++              afl-clang-fast -O1 -o fuzz_loader tests/fuzz_loader.c -lm -pthread
+                           afl-fuzz -i tests/fuzz_seeds -o findings -- ./fuzz_loader -replay
+    Usage: fuzz_loader [-runs N] [-seconds S] [-seed N] seed files...
+           fuzz_loader -replay [file ...]   (each file once, or stdin)
+    The standalone mode mutates the seeds itself (bit flips, random bytes,
+    interesting 32-bit values and small deltas on aligned fields, truncation,
+    chunk copies) and prints runs, execs/s and the share of inputs that load
+    about once a second. Loader messages are discarded; sanitizer reports are
+    kept, and the input that triggered one is written to crash-<run>.bin.
+*/
+
+#define MD3TOOBJ_NO_MAIN
+#include "../main.c"
+
+#include <fcntl.h>
+#include <stdint.h>
+
+/* Reads what a conversion reads; returns a checksum so it is not optimized out */
+unsigned long touch_model(const md3FileData *model) {
+    unsigned long sum = 0;
+    int numFrames = model->header.numFrames;
+    for (int s = 0; s < model->numSurfaces; s++) {
+        const md3SurfaceData *surface = &model->surfaces[s];
+        int numVerts = surface->header.numVerts;
+        for (int t = 0; t < surface->header.numTriangles; t++) {
+            for (int k = 0; k < 3; k++) {
+                int v = surface->triangles[t].indexes[k];
+                sum += (unsigned long) surface->texCoords[v].st[0];
+                for (int f = 0; f < numFrames; f += numFrames > 1 ? numFrames - 1 : 1) {
+                    const md3Vertex_t *vert = &surface->vertices[(size_t) f * numVerts + v];
+                    sum += (unsigned short) vert->xyz[0] + (unsigned short) vert->normal;
+                }
+            }
+        }
+        for (int i = 0; surface->shaders && i < surface->header.numShaders; i++) {
+            sum += (unsigned char) surface->shaders[i].name[0];
+        }
+    }
+    for (long i = 0; model->tags && i < (long) model->header.numTags * numFrames; i++) {
+        sum += (unsigned long) model->tags[i].origin[0];
+    }
+    return sum;
+}
+
+/* One fuzz input; data is copied since validation may patch it */
+int run_input(const unsigned char *input, size_t size) {
+    unsigned char *data = (unsigned char*) malloc(size > 0 ? size : 1);
+    if (!data) return 0;
+    memcpy(data, input, size);
+    md3FileData model;
+    memset(&model, 0, sizeof(model));
+    int loaded = load_model_buffer(data, (long) size, "fuzz", &model);
+    if (loaded) {
+        volatile unsigned long sink = touch_model(&model);
+        (void) sink;
+    }
+    free_md3_file(&model);
+    free(data);
+    return loaded;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+    run_input(data, size);
+    return 0;
+}
+
+#ifndef MD3_LIBFUZZER
+
+/* Provided by the sanitizer runtimes; NULL in builds without them */
+extern void __sanitizer_set_death_callback(void (*callback)(void)) __attribute__((weak));
+extern void __sanitizer_set_report_fd(void *fd) __attribute__((weak));
+
+/* make fuzz builds UBSan checks as traps (gcc's UBSan runtime has its own
+   report fd and death callback), so let ASan report the SIGILL */
+const char *__asan_default_options(void) {
+    return "handle_sigill=1";
+}
+
+typedef struct {
+    unsigned char *data;
+    size_t size;
+} fuzzInput;
+
+static FILE *g_report;
+static const unsigned char *g_current;
+static size_t g_currentSize;
+static unsigned long g_run;
+
+void save_crash_input(void) {
+    char name[64];
+    snprintf(name, sizeof(name), "crash-%lu.bin", g_run);
+    int fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0) {
+        ssize_t written = write(fd, g_current, g_currentSize);
+        close(fd);
+        fprintf(g_report, "Input of run %lu (%ld bytes) saved to %s\n", g_run, (long) written, name);
+        fflush(g_report);
+    }
+}
+
+double fuzz_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+uint64_t fuzz_random(uint64_t *state) {
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return *state = x;
+}
+
+int read_input(FILE *fp, fuzzInput *input) {
+    size_t cap = 4096;
+    input->size = 0;
+    input->data = (unsigned char*) malloc(cap);
+    while (input->data) {
+        size_t n = fread(input->data + input->size, 1, cap - input->size, fp);
+        input->size += n;
+        if (n == 0) return 1;
+        if (input->size == cap) {
+            unsigned char *grown = (unsigned char*) realloc(input->data, cap * 2);
+            if (!grown) break;
+            input->data = grown;
+            cap *= 2;
+        }
+    }
+    free(input->data);
+    input->data = NULL;
+    return 0;
+}
+
+/* Applies one random mutation to buf (capacity cap), updating *size */
+void mutate(unsigned char *buf, size_t *size, size_t cap, uint64_t *rng) {
+    static const int interesting[] = { 0, 1, -1, 2, 4, 63, 64, 255, 256, 0x7fff, 0x8000, 0xffff,
+                                       0x10000, 0x7fffffff, (int) 0x80000000u, 0x40000000 };
+    size_t n = *size;
+    if (n == 0) {
+        buf[0] = (unsigned char) fuzz_random(rng);
+        *size = 1;
+        return;
+    }
+    size_t at = fuzz_random(rng) % n;
+    size_t field = (at & ~(size_t) 3) + 4 <= n ? at & ~(size_t) 3 : 0;
+    int value;
+    switch (fuzz_random(rng) % 7) {
+    case 0:
+        buf[at] ^= (unsigned char)(1u << (fuzz_random(rng) % 8));
+        break;
+    case 1:
+        buf[at] = (unsigned char) fuzz_random(rng);
+        break;
+    case 2:
+        if (n < 4) break;
+        value = fuzz_random(rng) % 3 == 0 ? (int)(n - fuzz_random(rng) % 64)
+                                          : interesting[fuzz_random(rng) % (sizeof(interesting) / sizeof(interesting[0]))];
+        memcpy(buf + field, &value, 4);
+        break;
+    case 3:
+        if (n < 4) break;
+        memcpy(&value, buf + field, 4);
+        value = (int)((unsigned int) value + (unsigned int)(fuzz_random(rng) % 33) - 16u);
+        memcpy(buf + field, &value, 4);
+        break;
+    case 4:
+        *size = fuzz_random(rng) % n;
+        break;
+    case 5: {
+        size_t from = fuzz_random(rng) % n, len = 1 + fuzz_random(rng) % 64;
+        if (from + len > n) len = n - from;
+        if (at + len > n) len = n - at;
+        memmove(buf + at, buf + from, len);
+        break;
+    }
+    default: {
+        /* Grow by repeating the tail, so counts can point past the old end */
+        size_t len = 1 + fuzz_random(rng) % 256;
+        if (n + len > cap) len = cap - n;
+        for (size_t i = 0; i < len; i++) buf[n + i] = buf[n - 1 - i % n];
+        *size = n + len;
+        break;
+    }
+    }
+}
+
+int replay(char **files, int numFiles) {
+#ifdef __AFL_LOOP
+    if (numFiles == 0) {
+        while (__AFL_LOOP(10000)) {
+            fuzzInput input;
+            if (!read_input(stdin, &input)) return 2;
+            run_input(input.data, input.size);
+            free(input.data);
+        }
+        return 0;
+    }
+#endif
+    for (int i = 0; i < numFiles || (numFiles == 0 && i == 0); i++) {
+        FILE *fp = numFiles ? fopen(files[i], "rb") : stdin;
+        fuzzInput input;
+        if (!fp || !read_input(fp, &input)) {
+            fprintf(stderr, "Error reading %s\n", numFiles ? files[i] : "stdin");
+            return 2;
+        }
+        if (fp != stdin) fclose(fp);
+        int loaded = run_input(input.data, input.size);
+        printf("%s: %s\n", numFiles ? files[i] : "stdin", loaded ? "loaded" : "rejected");
+        free(input.data);
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    unsigned long maxRuns = 0;
+    double seconds = 0.0;
+    uint64_t rng = 0x9e3779b97f4a7c15ull;
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; i++) {
+        if (strcmp(argv[i], "-replay") == 0) {
+            return replay(argv + i + 1, argc - i - 1);
+        } else if (strcmp(argv[i], "-runs") == 0 && i + 1 < argc) {
+            maxRuns = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-seconds") == 0 && i + 1 < argc) {
+            seconds = atof(argv[++i]);
+        } else if (strcmp(argv[i], "-seed") == 0 && i + 1 < argc) {
+            rng ^= strtoull(argv[++i], NULL, 10) * 0xff51afd7ed558ccdull;
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+    int numSeeds = argc - i;
+    if (numSeeds < 1) {
+        fprintf(stderr, "Usage: %s [-runs N] [-seconds S] [-seed N] seed files...\n", argv[0]);
+        fprintf(stderr, "       %s -replay [file ...]\n", argv[0]);
+        return 2;
+    }
+    if (maxRuns == 0 && seconds <= 0.0) seconds = 10.0;
+    fuzzInput *seeds = (fuzzInput*) calloc(numSeeds, sizeof(fuzzInput));
+    size_t maxSize = 64;
+    for (int s = 0; seeds && s < numSeeds; s++) {
+        FILE *fp = fopen(argv[i + s], "rb");
+        if (!fp || !read_input(fp, &seeds[s])) {
+            fprintf(stderr, "Error reading seed %s\n", argv[i + s]);
+            return 2;
+        }
+        fclose(fp);
+        if (seeds[s].size > maxSize) maxSize = seeds[s].size;
+    }
+    size_t cap = maxSize * 2 + 256;
+    unsigned char *buf = (unsigned char*) malloc(cap);
+    if (!seeds || !buf) {
+        fprintf(stderr, "Memory allocation failed.\n");
+        return 2;
+    }
+
+    /* Progress goes to the original stdout, sanitizer reports to the
+       original stderr; the loader's own messages go nowhere */
+    g_report = fdopen(dup(1), "w");
+    int reportFd = dup(2);
+    if (!g_report || reportFd < 0 || !freopen("/dev/null", "w", stdout) || !freopen("/dev/null", "w", stderr)) {
+        return 2;
+    }
+    setvbuf(g_report, NULL, _IOLBF, 0);
+    if (__sanitizer_set_report_fd) __sanitizer_set_report_fd((void*)(intptr_t) reportFd);
+    if (__sanitizer_set_death_callback) __sanitizer_set_death_callback(save_crash_input);
+
+    double start = fuzz_now(), lastReport = start;
+    unsigned long loaded = 0;
+    g_current = buf;
+    for (g_run = 1; maxRuns == 0 || g_run <= maxRuns; g_run++) {
+        const fuzzInput *seed = &seeds[fuzz_random(&rng) % numSeeds];
+        size_t size = seed->size;
+        memcpy(buf, seed->data, size);
+        int mutations = 1 + (int)(fuzz_random(&rng) % 8);
+        for (int m = 0; m < mutations; m++) mutate(buf, &size, cap, &rng);
+        g_currentSize = size;
+        loaded += run_input(buf, size);
+        if ((g_run & 1023) == 0) {
+            double now = fuzz_now();
+            if (now - lastReport >= 1.0) {
+                fprintf(g_report, "#%lu  %.0f execs/s  %.1f%% loaded\n", g_run,
+                        g_run / (now - start), 100.0 * loaded / g_run);
+                lastReport = now;
+            }
+            if (seconds > 0.0 && now - start >= seconds) break;
+        }
+    }
+    if (maxRuns && g_run > maxRuns) g_run = maxRuns;
+    double elapsed = fuzz_now() - start;
+    fprintf(g_report, "Done: %lu runs in %.1f s (%.0f execs/s), %lu loaded, no crashes\n",
+            g_run, elapsed, elapsed > 0.0 ? g_run / elapsed : 0.0, loaded);
+    for (int s = 0; s < numSeeds; s++) free(seeds[s].data);
+    free(seeds);
+    free(buf);
+    return 0;
+}
+
+#endif /* MD3_LIBFUZZER */
@@ -0,0 +1,217 @@
+/*
+    Compares an OBJ (or any text) output against its golden file.
+    Default mode is byte-exact. With -tolerance eps, lines are split into
+    tokens on whitespace and '/', tokens that parse as numbers must agree
+    within eps (absolute), and all other tokens must match exactly. This
+    only applies to text outputs (.obj, .json, .csv, .mtl); binary ones
+    (.md3, .md3a, .iqm, .md3m, ...) are always compared byte-exact.
+    With -schema, both files are JSON whose values may differ (timings):
+    keys, nesting and array lengths must match, and every value must be of
+    the same kind (string or number).
+    Usage: objcompare [-tolerance eps | -schema] expected actual
+    Exit status: 0 equal, 1 different, 2 error.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <ctype.h>
+
+#define MAX_LINE 4096
+
+/* Returns the next token of *cursor (split on whitespace and '/') or NULL */
+char *next_token(char **cursor) {
+    char *p = *cursor;
+    while (*p && (isspace((unsigned char)*p) || *p == '/')) p++;
+    if (!*p) {
+        *cursor = p;
+        return NULL;
+    }
+    char *start = p;
+    while (*p && !isspace((unsigned char)*p) && *p != '/') p++;
+    if (*p) *p++ = '\0';
+    *cursor = p;
+    return start;
+}
+
+int parse_number(const char *token, double *value) {
+    char *end;
+    *value = strtod(token, &end);
+    return end != token && *end == '\0';
+}
+
+/* Compares one line pair token by token; returns 1 if equivalent */
+int lines_match(char *expected, char *actual, double tolerance, double *worst) {
+    char *ce = expected, *ca = actual;
+    for (;;) {
+        char *te = next_token(&ce);
+        char *ta = next_token(&ca);
+        if (!te || !ta) return te == ta;
+        double ve, va;
+        if (parse_number(te, &ve) && parse_number(ta, &va)) {
+            double diff = fabs(ve - va);
+            if (diff > *worst) *worst = diff;
+            if (diff > tolerance) return 0;
+        } else if (strcmp(te, ta) != 0) {
+            return 0;
+        }
+    }
+}
+
+int compare_exact(FILE *fe, FILE *fa, const char *expectedPath) {
+    long offset = 0;
+    for (;;) {
+        int ce = fgetc(fe), ca = fgetc(fa);
+        if (ce != ca) {
+            printf("%s: first byte difference at offset %ld\n", expectedPath, offset);
+            return 1;
+        }
+        if (ce == EOF) return 0;
+        offset++;
+    }
+}
+
+int compare_tolerance(FILE *fe, FILE *fa, const char *expectedPath, double tolerance) {
+    char le[MAX_LINE], la[MAX_LINE];
+    long line = 0;
+    double worst = 0.0;
+    for (;;) {
+        char *re = fgets(le, sizeof(le), fe);
+        char *ra = fgets(la, sizeof(la), fa);
+        line++;
+        if (!re || !ra) {
+            if (re != ra) {
+                printf("%s: line count differs at line %ld\n", expectedPath, line);
+                return 1;
+            }
+            break;
+        }
+        char copyE[MAX_LINE], copyA[MAX_LINE];
+        memcpy(copyE, le, sizeof(le));
+        memcpy(copyA, la, sizeof(la));
+        if (!lines_match(copyE, copyA, tolerance, &worst)) {
+            printf("%s:%ld: expected \"%.*s\" got \"%.*s\"\n", expectedPath, line,
+                   (int)strcspn(le, "\r\n"), le, (int)strcspn(la, "\r\n"), la);
+            return 1;
+        }
+    }
+    if (worst > 0.0) {
+        printf("%s: equal within tolerance (max abs diff %g)\n", expectedPath, worst);
+    }
+    return 0;
+}
+
+/* Reduces JSON text to its shape: whitespace dropped, string values become
+   "" and numbers 0, keys are kept. Returns a malloc'd string or NULL */
+char *json_shape(FILE *fp) {
+    size_t size = 0, cap = 4096;
+    char *text = (char*) malloc(cap + 1);
+    size_t n;
+    while (text && (n = fread(text + size, 1, cap - size, fp)) > 0) {
+        size += n;
+        if (size == cap) {
+            char *grown = (char*) realloc(text, cap * 2 + 1);
+            if (!grown) {
+                free(text);
+                return NULL;
+            }
+            text = grown;
+            cap *= 2;
+        }
+    }
+    if (!text) return NULL;
+    text[size] = '\0';
+    char *shape = (char*) malloc(size + 1);
+    size_t out = 0;
+    for (size_t i = 0; shape && i < size;) {
+        char c = text[i];
+        if (isspace((unsigned char)c)) {
+            i++;
+        } else if (c == '"') {
+            size_t start = i++;
+            while (i < size && text[i] != '"') i += text[i] == '\\' ? 2 : 1;
+            i++;
+            size_t next = i;
+            while (next < size && isspace((unsigned char)text[next])) next++;
+            if (next < size && text[next] == ':') {
+                size_t len = (i < size ? i : size) - start;
+                memcpy(shape + out, text + start, len);
+                out += len;
+            } else {
+                shape[out++] = '"';
+                shape[out++] = '"';
+            }
+        } else if (c == '-' || isdigit((unsigned char)c)) {
+            while (i < size && strchr("+-.eE0123456789", text[i])) i++;
+            shape[out++] = '0';
+        } else {
+            shape[out++] = c;
+            i++;
+        }
+    }
+    free(text);
+    if (shape) shape[out] = '\0';
+    return shape;
+}
+
+int compare_schema(FILE *fe, FILE *fa, const char *expectedPath) {
+    char *se = json_shape(fe), *sa = json_shape(fa);
+    int result = 2;
+    if (se && sa) {
+        size_t i = 0;
+        while (se[i] && se[i] == sa[i]) i++;
+        result = se[i] != sa[i];
+        if (result) {
+            printf("%s: JSON structure differs: expected \"%.40s\" got \"%.40s\"\n", expectedPath, se + i, sa + i);
+        }
+    } else {
+        fprintf(stderr, "Out of memory reading %s\n", expectedPath);
+    }
+    free(se);
+    free(sa);
+    return result;
+}
+
+/* Text outputs that may be compared within a tolerance */
+int is_text_output(const char *path) {
+    static const char *extensions[] = { ".obj", ".json", ".csv", ".mtl" };
+    size_t len = strlen(path);
+    for (size_t i = 0; i < sizeof(extensions) / sizeof(extensions[0]); i++) {
+        size_t extLen = strlen(extensions[i]);
+        if (len >= extLen && strcmp(path + len - extLen, extensions[i]) == 0) return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    double tolerance = -1.0;
+    int schema = 0;
+    int arg = 1;
+    if (arg + 1 < argc && strcmp(argv[arg], "-tolerance") == 0) {
+        tolerance = atof(argv[arg + 1]);
+        arg += 2;
+    } else if (arg < argc && strcmp(argv[arg], "-schema") == 0) {
+        schema = 1;
+        arg++;
+    }
+    if (argc - arg != 2) {
+        fprintf(stderr, "Usage: %s [-tolerance eps | -schema] expected actual\n", argv[0]);
+        return 2;
+    }
+    FILE *fe = fopen(argv[arg], "rb");
+    FILE *fa = fopen(argv[arg + 1], "rb");
+    if (!fe || !fa) {
+        fprintf(stderr, "Error opening %s\n", !fe ? argv[arg] : argv[arg + 1]);
+        if (fe) fclose(fe);
+        if (fa) fclose(fa);
+        return 2;
+    }
+    if (!is_text_output(argv[arg])) tolerance = -1.0;
+    int result = schema ? compare_schema(fe, fa, argv[arg]) :
+                 tolerance < 0.0 ? compare_exact(fe, fa, argv[arg])
+                                 : compare_tolerance(fe, fa, argv[arg], tolerance);
+    fclose(fe);
+    fclose(fa);
+    return result;
+}
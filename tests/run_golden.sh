@@ -0,0 +1,122 @@
+#!/bin/sh
+# Golden-output regression suite.
+# Runs every case in tests/cases.txt and compares the produced files with
+# tests/golden/<case>/, either byte-exact (default) or numerically within a
+# tolerance (text outputs only; objcompare keeps binary ones byte-exact).
+# Tar archives are extracted and compared entry by entry, and
+# -stats reports (*.stats.json) by structure only since they hold timings.
+# Usage: tests/run_golden.sh [-update] [-tolerance eps] md3toobj objcompare
+
+set -u
+
+UPDATE=0
+TOLERANCE=""
+while [ $# -gt 0 ]; do
+    case "$1" in
+        -update) UPDATE=1; shift ;;
+        -tolerance) TOLERANCE="$2"; shift 2 ;;
+        *) break ;;
+    esac
+done
+if [ $# -ne 2 ]; then
+    echo "Usage: $0 [-update] [-tolerance eps] md3toobj objcompare" >&2
+    exit 2
+fi
+
+abspath() {
+    echo "$(cd "$(dirname "$1")" && pwd)/$(basename "$1")"
+}
+
+BIN=$(abspath "$1")
+COMPARE=$(abspath "$2")
+ROOT=$(cd "$(dirname "$0")" && pwd)
+CORPUS=$ROOT/corpus
+GOLDEN=$ROOT/golden
+WORK=$(mktemp -d "${TMPDIR:-/tmp}/md3golden.XXXXXX")
+trap 'rm -rf "$WORK"' EXIT
+
+# Reproducible tar headers
+SOURCE_DATE_EPOCH=0
+export SOURCE_DATE_EPOCH
+
+if [ -n "$TOLERANCE" ]; then
+    MODE="-tolerance $TOLERANCE"
+else
+    MODE=""
+fi
+
+# compare_file expected actual
+compare_file() {
+    case "$1" in
+        *.tar)
+            mkdir -p "$WORK/x/expected" "$WORK/x/actual" &&
+            rm -rf "$WORK/x/expected/"* "$WORK/x/actual/"* &&
+            tar -xf "$1" -C "$WORK/x/expected" &&
+            tar -xf "$2" -C "$WORK/x/actual" || return 1
+            compare_dirs "$WORK/x/expected" "$WORK/x/actual"
+            ;;
+        *.stats.json)
+            "$COMPARE" -schema "$1" "$2"
+            ;;
+        *)
+            # shellcheck disable=SC2086
+            "$COMPARE" $MODE "$1" "$2" > "$WORK/compare.log"
+            status=$?
+            if [ $status -ne 0 ] || [ -n "$TOLERANCE" ]; then
+                sed "s|^$GOLDEN/||" "$WORK/compare.log"
+            fi
+            return $status
+            ;;
+    esac
+}
+
+# compare_dirs expected_dir actual_dir
+compare_dirs() {
+    if [ "$(cd "$1" && ls)" != "$(cd "$2" && ls)" ]; then
+        echo "file sets differ: expected [$(cd "$1" && ls | tr '\n' ' ')] got [$(cd "$2" && ls | tr '\n' ' ')]"
+        return 1
+    fi
+    result=0
+    for f in $(cd "$1" && ls); do
+        compare_file "$1/$f" "$2/$f" || result=1
+    done
+    return $result
+}
+
+pass=0
+fail=0
+while read -r name args; do
+    case "$name" in
+        ''|'#'*) continue ;;
+    esac
+    out="$WORK/$name"
+    mkdir -p "$out"
+    if ! (cd "$out" && eval "\"\$BIN\" $args" > "$WORK/$name.log" 2>&1); then
+        echo "FAIL $name: converter exited with an error"
+        sed 's/^/    /' "$WORK/$name.log"
+        fail=$((fail + 1))
+        continue
+    fi
+    if [ $UPDATE -eq 1 ]; then
+        rm -rf "${GOLDEN:?}/$name"
+        mkdir -p "$GOLDEN"
+        cp -R "$out" "$GOLDEN/$name"
+        echo "updated $name"
+        continue
+    fi
+    if [ ! -d "$GOLDEN/$name" ]; then
+        echo "FAIL $name: no golden output (run with -update)"
+        fail=$((fail + 1))
+    elif compare_dirs "$GOLDEN/$name" "$out"; then
+        echo "ok   $name"
+        pass=$((pass + 1))
+    else
+        echo "FAIL $name"
+        fail=$((fail + 1))
+    fi
+done < "$ROOT/cases.txt"
+
+if [ $UPDATE -eq 0 ]; then
+    echo "$pass passed, $fail failed"
+fi
+[ $fail -eq 0 ]